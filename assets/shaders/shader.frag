@@ -1,6 +1,9 @@
 #version 450
 
-#define MAX_LIGHT_COUNT 5
+// Material features, specialized per pipeline. Ids match the bits of PipelineShaderFeature
+layout(constant_id = 0) const bool TEXTURED = true;
+layout(constant_id = 1) const bool SPECULAR = true;
+layout(constant_id = 2) const bool ALPHA = true;
 
 struct DirectionalLight
 {
@@ -32,24 +35,27 @@ layout(location = 0) out vec4 outColor;
 void main()
 {
 	vec3 lightDir = normalize(inDirLight.direction - inPos);
-	vec4 diffuseColor = texture(diffuseTexture, inTexCoord);
+
+	vec3 baseColor = inMaterial.diffuse;
+	if (TEXTURED)
+		baseColor = vec3(texture(diffuseTexture, inTexCoord));
 
 	// AMBIENT
-	vec3 ambient = inDirLight.ambient * vec3(diffuseColor);
+	vec3 color = inDirLight.ambient * baseColor;
 
 	// DIFFUSE
 	vec3 norm = normalize(inNormal);
 	float diff = clamp(dot(lightDir, norm), 0.0, 1.0);
-	vec3 diffuse = inDirLight.diffuse * (diff * vec3(diffuseColor));
+	color += inDirLight.diffuse * (diff * baseColor);
 
 	// SPECULAR
-	float specularIntensity = 0.8;
-	vec3 reflectDir = reflect(-lightDir, norm);
-	float spec = pow(max(dot(normalize(-inPos), reflectDir), 0.0), inMaterial.shininess);
-	vec3 specular = inDirLight.specular * (spec * inMaterial.specular);
+	if (SPECULAR)
+	{
+		vec3 reflectDir = reflect(-lightDir, norm);
+		float spec = pow(max(dot(normalize(-inPos), reflectDir), 0.0), inMaterial.shininess);
+		color += inDirLight.specular * (spec * inMaterial.specular);
+	}
 
 	// OPACITY
-	vec4 opacity = vec4(1.0, 1.0, 1.0, inMaterial.opacity);
-
-	outColor = vec4((ambient + diffuse + specular), 1.0) * opacity;
+	outColor = vec4(color, ALPHA ? inMaterial.opacity : 1.0);
 }
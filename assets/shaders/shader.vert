@@ -1,7 +1,5 @@
 #version 450
 
-#define MAX_LIGHT_COUNT 5
-
 struct DirectionalLight
 {
 	vec3 direction;
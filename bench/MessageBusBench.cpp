@@ -0,0 +1,125 @@
+#include <system/System.h>
+
+#include <new>
+#include <chrono>
+#include <cstdlib>
+
+// Messages per second through the MessageBus, both straight to the subscribers and through
+// the deferred queue, and how many heap allocations the timed loops made. Built and run by
+// make bench, alongside 15 idle systems like a typical scene.
+
+#define BENCH_MESSAGE_COUNT 2000000
+#define BENCH_IDLE_SYSTEMS 15
+#define BENCH_BATCH_SIZE 256
+
+static long allocationCount = 0;
+
+void * operator new(size_t size)
+{
+    allocationCount++;
+
+    void * memory = malloc(size);
+
+    if (memory == nullptr)
+        throw std::bad_alloc();
+
+    return memory;
+}
+
+void operator delete(void * memory) noexcept
+{
+    free(memory);
+}
+
+void operator delete(void * memory, size_t /*size*/) noexcept
+{
+    free(memory);
+}
+
+class SinkSystem : public System
+{
+    public:
+    long total = 0;
+
+    void onKeyPress(int key) { total += key; }
+    void onCameraPosition(const Float3 & position) { total += (long) position.x; }
+
+    void update(double /*elapsedTime*/) {}
+};
+
+class IdleSystem : public System
+{
+    public:
+    void update(double /*elapsedTime*/) {}
+};
+
+// Drains the queue the way ProjectKoi::update does, minus coalescing
+class BenchBus : public MessageBus
+{
+    public:
+    void drain()
+    {
+        MessageHeader * msg;
+        for (uint32_t i = 0; i < msgQueue.getCapacity() && (msg = msgQueue.front()) != nullptr; i++)
+        {
+            sendMessageNow(msg);
+            msgQueue.pop();
+        }
+    }
+};
+
+static double seconds(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+int main()
+{
+    BenchBus bus;
+
+    SinkSystem * sink = new SinkSystem();
+    sink->setMessageCallback<KeyPress>(&SinkSystem::onKeyPress);
+    sink->setMessageCallback<SetCameraPosition>(&SinkSystem::onCameraPosition);
+    bus.registerSystem(sink);
+
+    for (uint32_t i = 0; i < BENCH_IDLE_SYSTEMS; i++)
+        bus.registerSystem(new IdleSystem());
+
+    // ===== sendMessageNow =====
+
+    Float3 position = {1.0f, 2.0f, 3.0f};
+
+    long allocations = allocationCount;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    for (uint32_t i = 0; i < BENCH_MESSAGE_COUNT; i++)
+        bus.sendMessageNow<SetCameraPosition>(position);
+
+    double nowTime = seconds(start);
+    long nowAllocations = allocationCount - allocations;
+
+    // ===== sendMessage and drain =====
+
+    allocations = allocationCount;
+    start = std::chrono::steady_clock::now();
+
+    for (uint32_t i = 0; i < BENCH_MESSAGE_COUNT / BENCH_BATCH_SIZE; i++)
+    {
+        for (int key = 0; key < BENCH_BATCH_SIZE; key++)
+            bus.sendMessage<KeyPress>(key);
+
+        bus.drain();
+    }
+
+    double queuedTime = seconds(start);
+    long queuedAllocations = allocationCount - allocations;
+    uint32_t queuedCount = BENCH_MESSAGE_COUNT / BENCH_BATCH_SIZE * BENCH_BATCH_SIZE;
+
+    INFO("BENCH - sendMessageNow<SetCameraPosition>: %.2f M msg/s, %ld allocations", BENCH_MESSAGE_COUNT / nowTime / 1e6, nowAllocations);
+    INFO("BENCH - sendMessage<KeyPress> + drain: %.2f M msg/s, %ld allocations", queuedCount / queuedTime / 1e6, queuedAllocations);
+    DEBUG("BENCH - Checksum %ld", sink->total);
+
+    bus.destroySystems();
+
+    return (nowAllocations == 0 && queuedAllocations == 0) ? 0 : 1;
+}
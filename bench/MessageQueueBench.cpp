@@ -0,0 +1,123 @@
+#include <system/System.h>
+
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <vector>
+
+// Many producers posting to the bus at once while the main thread drains it. Every message
+// must arrive exactly once and in the order its producer sent it, a full queue only makes
+// producers retry. Built and run by make bench, worth running with -fsanitize=thread too.
+
+#define BENCH_PRODUCERS 16
+#define BENCH_MESSAGES_PER_PRODUCER 200000
+
+class SequenceSystem : public System
+{
+    public:
+    std::vector<long> last;
+    long received = 0;
+    bool ordered = true;
+
+    SequenceSystem() : last(BENCH_PRODUCERS, -1) {}
+
+    // x is the producer, y its sequence number, both exact as floats at these counts
+    void onCameraPosition(const Float3 & data)
+    {
+        uint32_t producer = (uint32_t) data.x;
+        long sequence = (long) data.y;
+
+        if (producer >= BENCH_PRODUCERS || sequence != last[producer] + 1)
+            ordered = false;
+        else
+            last[producer] = sequence;
+
+        received++;
+    }
+
+    void update(double /*elapsedTime*/) {}
+};
+
+// Drains the queue the way ProjectKoi::update does, minus coalescing
+class BenchBus : public MessageBus
+{
+    public:
+    // Pushes the queue turned away, which it counts as dropped. The producers here retry every one
+    long refused = 0;
+
+    void drain()
+    {
+        MessageHeader * msg;
+        for (uint32_t i = 0; i < msgQueue.getCapacity() && (msg = msgQueue.front()) != nullptr; i++)
+        {
+            sendMessageNow(msg);
+            msgQueue.pop();
+        }
+
+        refused += msgQueue.takeDroppedCount();
+    }
+};
+
+int main()
+{
+    BenchBus bus;
+
+    SequenceSystem * sink = new SequenceSystem();
+    sink->setMessageCallback<SetCameraPosition>(&SequenceSystem::onCameraPosition);
+    bus.registerSystem(sink);
+
+    const long total = (long) BENCH_PRODUCERS * BENCH_MESSAGES_PER_PRODUCER;
+
+    std::atomic<uint32_t> finished(0);
+    std::atomic<long> retries(0);
+    std::vector<std::thread> producers;
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    for (uint32_t p = 0; p < BENCH_PRODUCERS; p++)
+    {
+        producers.emplace_back([&bus, &finished, &retries, p]()
+        {
+            for (uint32_t i = 0; i < BENCH_MESSAGES_PER_PRODUCER; i++)
+            {
+                Float3 data = {(float) p, (float) i, 0.0f};
+
+                while (!bus.sendMessage<SetCameraPosition>(data))
+                {
+                    retries.fetch_add(1, std::memory_order_relaxed);
+                    std::this_thread::yield();
+                }
+            }
+
+            finished.fetch_add(1, std::memory_order_release);
+        });
+    }
+
+    long drains = 0;
+
+    while (finished.load(std::memory_order_acquire) < BENCH_PRODUCERS || sink->received < total)
+    {
+        bus.drain();
+        drains++;
+
+        std::this_thread::yield();
+    }
+
+    for (auto & producer : producers)
+        producer.join();
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    // Picks up refusals counted after the last drain took the count
+    bus.drain();
+
+    INFO("BENCH - %u producers: %ld/%ld messages in %ld drains, %.2f M msg/s", BENCH_PRODUCERS, sink->received, total, drains, sink->received / seconds / 1e6);
+    INFO("BENCH - %s, %ld messages lost", sink->ordered ? "In order" : "OUT OF ORDER", total - sink->received);
+    INFO("BENCH - %ld pushes retried on a full queue, %ld refusals counted by the queue", retries.load(), bus.refused);
+
+    bool passed = sink->ordered && sink->received == total && bus.refused == retries.load();
+
+    bus.destroySystems();
+
+    return passed ? 0 : 1;
+}
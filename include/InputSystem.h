@@ -10,25 +10,33 @@
 class InputSystem : public System
 {
 	public:
-		void update(long elapsedTime);
+		void update(double elapsedTime);
+
+		// Polls the window and builds this frame's InputSnapshot. Called by ProjectKoi at the
+		// top of the frame, before messages are drained and before any update runs
+		void poll();
 
 		InputSystem();
 		~InputSystem();
 
 	private:
-		void onWindowCreate(Message * msg);
+		void onWindowCreate(GLFWwindow * window);
+
+		void toggleCursor();
 
-		void toggleCursor(GLFWwindow * window);
+		// Next event from the ring, or from the replay while one is playing
+		bool nextEvent(InputEvent & event);
 
 		static void keyCallback(GLFWwindow * window, int key, int scancode, int action, int mods);
 		static void cursorPositionCallback(GLFWwindow * window, double xpos, double ypos);
 		static void mouseButtonCallback(GLFWwindow * window, int button, int action, int mods);
 		static void windowFocusCallback(GLFWwindow* window, int focused);
 
-		std::unordered_map<int, bool> keyCodes;
-		std::unordered_map<int, bool> mouseButtonCodes;
-		float mousePosition [2];
-		float mouseDelta [2];
+		GLFWwindow * window = nullptr;
+		bool cursorDisabled = false;
+
+		// Callbacks only record events, nothing is dispatched until poll() drains them
+		InputEventRing events;
 };
 
 #endif
@@ -5,6 +5,7 @@
 
 #include <system/Message.h>
 #include <system/System.h>
+#include <system/DirtyTracker.h>
 
 #include <RenderSystem.h>
 
@@ -20,9 +21,16 @@
 
 class ProjectKoi : public System, public MessageBus
 {
-    long lastUpdateTime;
     bool needsDestroying = false;
 
+    // System updates are run as task graphs on jobs, rebuilt whenever a system is registered
+    TaskGraph updateGraph;
+    TaskGraph fixedUpdateGraph;
+    size_t updateGraphSystemCount = 0;
+    double frameElapsedTime = 0.0;
+
+    void buildUpdateGraph();
+
     public:
     ProjectKoi();
     ~ProjectKoi();
@@ -33,11 +41,15 @@ class ProjectKoi : public System, public MessageBus
     InputSystem * inputSystem;
 #endif
 
+    // Close once a --replay recording runs out
+    bool exitAfterReplay = false;
+
     void init();
-    void update(long elapsedTime);
+    void update(double elapsedTime);
 
     void run();
-    void exit(Message * msg);
+    void exit();
+    void setFrameLimit(float framesPerSecond);
 };
 
 #endif
\ No newline at end of file
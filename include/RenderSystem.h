@@ -9,6 +9,8 @@
 
 #include <render/DesktopContext.h>
 #include <render/DesktopRenderer.h>
+#include <render/HeadlessContext.h>
+#include <render/HeadlessRenderer.h>
 #include <render/GUI.h>
 
 #else
@@ -24,7 +26,7 @@ class RenderSystem : public System
 {
 	public:
 		void init();
-		void update(long elapsedTime);
+		void update(double elapsedTime);
 
 		void draw();
 
@@ -33,8 +35,24 @@ class RenderSystem : public System
 
 #ifdef ANDROID
 		RenderSystem(android_app * android_context) { this->android_context = android_context; }
+#else
+		// Offscreen with no window or GUI, see HeadlessRenderer. Set before registering
+		bool headless = false;
+		uint32_t headlessFrames = 0;
+		std::string captureFilename;
+
+		// Per pass GPU times of every frame are written here when set, see GPUProfiler
+		std::string gpuProfileFilename;
+
+		// Log how scene recording scales with threads once models are loaded, see Scene3D
+		bool benchmarkRecording = false;
 #endif
 
+		uint32_t framesInFlight = RENDERER_DEFAULT_FRAMES_IN_FLIGHT;
+
+		// Bytes of staging copies submitted per frame, see UploadBatcher
+		VkDeviceSize uploadBudget = UPLOAD_DEFAULT_FRAME_BUDGET;
+
 	private:
 		Context * context = nullptr;
 		Renderer * renderer = nullptr;
@@ -48,11 +66,8 @@ class RenderSystem : public System
 
 		bool paused = true;
 
-		void loadScene(Message * msg);
-		void onKeyPress(Message * msg);
-		void onWindowFocus(Message * msg);
-		void onCameraPositionUpdate(Message * msg);
-		void onCameraDirectionUpdate(Message * msg);
+		void onKeyPress(int keyCode);
+		void onWindowFocus(int focused);
 };
 
 #endif
@@ -7,6 +7,7 @@
 
 #include <system/System.h>
 #include <system/Log.h>
+#include <system/DirtyTracker.h>
 #include <render/Scene.h>
 #include <render/KoiVector.h>
 
@@ -29,8 +30,9 @@ struct CameraData
 
 struct Camera : public System
 {
-    uint32_t index = 0; 
+    // One per frame in flight, written by Scene3D::prepareUniforms
     std::vector<UniformBuffer> buffers;
+    DirtyTracker bufferState = DirtyTracker(UploadCamera);
 
     CameraData data;
 
@@ -38,6 +40,7 @@ struct Camera : public System
     float phi = 0.0f;
 
     Vec3 position = {0.0f, 0.0f, 1.0f};
+    Vec3 previousPosition = {0.0f, 0.0f, 1.0f};
     Vec3 direction = {0.0f, 0.0f, -1.0f};
     Vec3 upDir = {0.0f, 1.0f, 0.0f};
 
@@ -46,6 +49,9 @@ struct Camera : public System
     float far = 50.0f;
     float fov = 45.0f;
 
+    // Blend between the last two fixed steps, set each frame from the clock
+    float interpolation = 1.0f;
+
     bool running = false;
 
     std::unordered_map<long, CameraMovementDirection> keyBindings;
@@ -59,21 +65,18 @@ struct Camera : public System
     bool left = false;
     bool right = false;
 
-    float mouseDelta[2] = {0.0, 0.0};
-
     void init();
-    void update(long elapsedTime);
+    void fixedUpdate(double step);
+    void update(double elapsedTime);
 
-    void onKeyPress(Message * msg);
-    void onKeyRelease(Message * msg);
-    void setMouseDelta(Message * msg);
+    void readMovementKeys(const InputSnapshot & input);
 
     void set(Vec3 position, Vec3 lookAt);
     void setPosition(Vec3 position);
     void setPosition(float x, float y, float z);
     void setLookAt(Vec3 lookAt);
     void setLookAt(float x, float y, float z);
-    void updateBuffer();
+    void updateMatrices();
 
     static VkDescriptorSetLayoutBinding getVkDescriptorSetLayoutBinding(uint32_t binding);
 };
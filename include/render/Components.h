@@ -0,0 +1,32 @@
+#ifndef COMPONENTS_H
+#define COMPONENTS_H
+
+#include <system/Entity.h>
+
+#include <render/KoiVector.h>
+#include <render/Model.h>
+
+// Laid out exactly like InstanceData, the dense Transform array is copied into the scene's
+// instance buffer as is
+struct Transform
+{
+    Mat4 matrix = Mat4(1.0f);
+};
+
+static_assert(sizeof(Transform) == sizeof(InstanceData), "Transform must match the instance buffer layout");
+
+// The shapes and materials drawn at the entity's transform. Models are shared assets, any
+// number of entities can reference the same one
+struct MeshRef
+{
+    ModelBase * model = nullptr;
+};
+
+// World space box around the entity's mesh, refreshed from the model bounds when transforms change
+struct Bounds
+{
+    Vec3 min = Vec3(0.0f);
+    Vec3 max = Vec3(0.0f);
+};
+
+#endif
\ No newline at end of file
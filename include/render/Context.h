@@ -1,9 +1,13 @@
 #ifndef CONTEXT_H
 #define CONTEXT_H
 
+#include <mutex>
+#include <string>
 #include <vector>
 
 #include <render/KoiVulkan.h>
+#include <render/DeviceAllocator.h>
+#include <render/UploadBatcher.h>
 
 #include <system/Log.h>
 #include <system/System.h>
@@ -13,6 +17,10 @@
 #define ENGINE_NAME "Koi Engine"
 #define ENGINE_VERSION 4
 
+#define PIPELINE_CACHE_FILENAME "pipeline_cache.bin"
+#define PIPELINE_CACHE_MAGIC 0x4350494B
+#define PIPELINE_CACHE_VERSION 1
+
 // ===============================================================================================================
 //                                             Queue Container
 // ===============================================================================================================
@@ -71,6 +79,16 @@ bool supportsSurfaceFormats(VkPhysicalDevice physicalDevice, VkSurfaceKHR surfac
 
 VkDevice createVkDevice(VkPhysicalDevice physicalDevice, VkPhysicalDeviceFeatures deviceFeatures, std::vector<const char *> layers, std::vector<const char *> extensions, std::vector<Queue> & queues);
 
+// ===============================================================================================================
+//                                         VkPipelineCache Helpers
+// ===============================================================================================================
+
+// Cache files start with our own header (device, driver version and pipelineCacheUUID) so a
+// driver update or another GPU starts from an empty cache instead of handing the driver
+// data it can't use. warm is set when the file's contents were accepted
+VkPipelineCache createVkPipelineCache(VkPhysicalDevice physicalDevice, VkDevice device, const std::string & filename, bool * warm);
+bool saveVkPipelineCache(VkPhysicalDevice physicalDevice, VkDevice device, VkPipelineCache pipelineCache, const std::string & filename);
+
 // ===============================================================================================================
 //                                             Context Interface
 // ===============================================================================================================
@@ -97,6 +115,29 @@ class Context : public System
     Context() {}
     virtual ~Context() {}
 
+    // Shared by every pipeline, loaded from and saved back to pipelineCacheFilename
+    VkPipelineCache pipelineCache = VK_NULL_HANDLE;
+    std::string pipelineCacheFilename = PIPELINE_CACHE_FILENAME;
+    bool pipelineCacheWarm = false;
+
+    // Time spent in vkCreateGraphicsPipelines, logged on shutdown to compare cold and warm runs
+    double pipelineCreationTime = 0.0;
+    uint32_t pipelineCount = 0;
+    // Pipelines are also created on the registry's compile threads
+    std::mutex pipelineStatsMutex;
+
+    // Every buffer and image's memory, created with the device
+    DeviceAllocator allocator;
+
+    // Staging copies to device local memory, submitted a frame's budget at a time
+    UploadBatcher uploads;
+
+    // After the device is created, and before it is destroyed
+    void createPipelineCache();
+    void destroyPipelineCache();
+
+    VkResult createGraphicsPipeline(const VkGraphicsPipelineCreateInfo * pipelineInfo, VkPipeline * pipeline);
+
 	VkDebugUtilsMessengerEXT messanger;
 	void createValidationDebugCallback();
 	void destroyValidationDebugCallback();
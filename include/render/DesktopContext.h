@@ -24,7 +24,7 @@ class DesktopContext : public Context
     ~DesktopContext();
 
     void init();
-    void update(long elapsedTime);
+    void update(double elapsedTime);
 };
 
 #endif
\ No newline at end of file
@@ -12,7 +12,10 @@ class DesktopRenderer : public Renderer
     VkSurfaceFormatKHR surfaceFormat;
     VkSwapchainKHR swapchain;
 
-    DesktopRenderer(DesktopContext * context);
+    // Fence of the frame that last rendered to each swapchain image
+    std::vector<VkFence> imageFences;
+
+    DesktopRenderer(DesktopContext * context, uint32_t framesInFlight = RENDERER_DEFAULT_FRAMES_IN_FLIGHT);
     ~DesktopRenderer();
 
     VkCommandBuffer getNextCommandBuffer();
@@ -20,7 +23,7 @@ class DesktopRenderer : public Renderer
     void present();
 
     void init();
-    void update(long elapsedTime);
+    void update(double elapsedTime);
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,98 @@
+#ifndef DEVICE_ALLOCATOR_H
+#define DEVICE_ALLOCATOR_H
+
+#include <mutex>
+#include <vector>
+#include <cstdint>
+
+#include <render/KoiVulkan.h>
+
+// Memory is taken from the device in blocks of this size, or an eighth of a smaller heap.
+// Allocations over half a block get a VkDeviceMemory of their own
+#define DEVICE_ALLOCATOR_BLOCK_SIZE (64ull * 1024 * 1024)
+#define DEVICE_ALLOCATOR_TRANSIENT_BLOCK_SIZE (16ull * 1024 * 1024)
+// Sizes and offsets are multiples of this
+#define DEVICE_ALLOCATOR_MIN_SIZE 256
+
+// Buffers and linear images may not share a bufferImageGranularity page with optimal images.
+// When the device's granularity is coarser than DEVICE_ALLOCATOR_MIN_SIZE the two never
+// share a block
+enum DeviceResourceKind
+{
+    DeviceResourceLinear,
+    DeviceResourceOptimal
+};
+
+enum DeviceMemoryPool
+{
+    DevicePoolLinear,
+    DevicePoolOptimal,
+    // Bump allocated, rewinds once everything in the block has been freed. For staging copies
+    DevicePoolTransient,
+    DevicePoolCount
+};
+
+struct DeviceMemoryBlock;
+
+struct DeviceAllocation
+{
+    VkDeviceMemory memory = VK_NULL_HANDLE;
+    VkDeviceSize offset = 0;
+    VkDeviceSize size = 0;
+
+    // Host visible blocks stay mapped, this points at the allocation's first byte
+    void * mapped = nullptr;
+
+    DeviceMemoryBlock * block = nullptr;
+    uint32_t node = 0;
+};
+
+struct DeviceHeapStats
+{
+    VkDeviceSize heapSize = 0;
+    // Taken from the device, handed out, and free but outside the largest free range of its block
+    VkDeviceSize allocatedBytes = 0;
+    VkDeviceSize usedBytes = 0;
+    VkDeviceSize fragmentedBytes = 0;
+    uint32_t memoryObjects = 0;
+    uint32_t allocations = 0;
+};
+
+// Sub-allocates device memory so the number of VkDeviceMemory objects stays far below
+// maxMemoryAllocationCount. Each memory type has a TLSF managed list of blocks per pool,
+// allocation and free are O(1) within a block. Thread safe.
+class DeviceAllocator
+{
+    public:
+    // After the device is created, and before it is destroyed with everything freed
+    void create(VkPhysicalDevice physicalDevice, VkDevice device);
+    void destroy();
+
+    // The memory type with the requested properties and the fewest others, UINT32_MAX if none
+    uint32_t findMemoryType(uint32_t typeBits, VkMemoryPropertyFlags properties) const;
+
+    VkResult allocate(const VkMemoryRequirements & requirements, VkMemoryPropertyFlags properties, DeviceResourceKind kind, bool transient, DeviceAllocation * allocation);
+    void free(DeviceAllocation & allocation);
+
+    uint32_t getHeapCount() const { return memoryProperties.memoryHeapCount; }
+    DeviceHeapStats getHeapStats(uint32_t heap);
+
+    private:
+    std::mutex mutex;
+
+    VkDevice device = VK_NULL_HANDLE;
+    VkPhysicalDeviceMemoryProperties memoryProperties = {};
+    VkDeviceSize bufferImageGranularity = 1;
+    uint32_t maxMemoryObjects = 0;
+
+    std::vector<DeviceMemoryBlock *> blocks[VK_MAX_MEMORY_TYPES][DevicePoolCount];
+    std::vector<DeviceMemoryBlock *> dedicated;
+
+    uint32_t memoryObjects = 0;
+    uint32_t peakMemoryObjects = 0;
+
+    DeviceMemoryBlock * createBlock(uint32_t memoryType, DeviceMemoryPool pool, VkDeviceSize size, bool isDedicated);
+    void destroyBlock(DeviceMemoryBlock * block);
+};
+
+#endif
@@ -0,0 +1,119 @@
+#ifndef GPU_PROFILER_H
+#define GPU_PROFILER_H
+
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <cstdint>
+
+#include <render/Context.h>
+
+// Timestamp pairs each frame may write, the whole frame takes one
+#define GPU_PROFILER_MAX_SCOPES 32
+// Frames the rolling averages cover
+#define GPU_PROFILER_HISTORY 120
+#define GPU_PROFILER_NO_SCOPE (~0u)
+
+// Rolling GPU time of every scope with the same name
+struct GPUScopeStats
+{
+    std::string name;
+
+    double last = 0.0;
+    double average = 0.0;
+
+    float history[GPU_PROFILER_HISTORY] = {};
+    uint32_t historyCount = 0;
+    uint32_t historyPosition = 0;
+    double historyTotal = 0.0;
+
+    void add(double milliseconds);
+};
+
+// Brackets parts of a frame's command buffer with timestamp queries. Each frame in flight
+// has its own range of the query pool, read back once the renderer has waited on that
+// frame's fence, so results are always from frames the GPU has retired and reading them
+// never stalls. Scopes may nest and may be opened inside or outside of render passes.
+class GPUProfiler
+{
+    public:
+    GPUProfiler() {}
+    ~GPUProfiler() {}
+
+    // Leaves the profiler disabled if the queue family can't write timestamps
+    void create(VkPhysicalDevice physicalDevice, VkDevice device, uint32_t queueFamilyIndex, uint32_t framesInFlight);
+    void destroy();
+
+    bool isEnabled() const { return queryPool != VK_NULL_HANDLE; }
+
+    // Right after the frame's command buffer is begun, its fence must have been waited on.
+    // Collects the frame's previous results, resets its queries and opens the "Frame" scope
+    void beginFrame(VkCommandBuffer commandbuffer, uint32_t frame);
+    // Right before the command buffer is ended
+    void endFrame(VkCommandBuffer commandbuffer);
+
+    // Scopes of the same name share their stats. Returns GPU_PROFILER_NO_SCOPE when
+    // disabled or out of queries, which endScope ignores
+    uint32_t beginScope(VkCommandBuffer commandbuffer, const char * name);
+    void endScope(VkCommandBuffer commandbuffer, uint32_t scope);
+
+    // One row per scope per collected frame: frame,scope,gpu_ms
+    bool startCSV(const std::string & filename);
+    void stopCSV();
+
+    // Ordered by first use, the whole frame first
+    std::vector<GPUScopeStats> scopes;
+
+    // Frames whose timestamps have been read back
+    uint64_t collectedFrames = 0;
+
+    private:
+    struct PendingScope
+    {
+        uint32_t stats;
+        uint32_t query;
+    };
+
+    struct FrameQueries
+    {
+        std::vector<PendingScope> scopes;
+        uint32_t firstQuery = 0;
+        uint32_t queryCount = 0;
+        uint64_t frameNumber = 0;
+    };
+
+    void collect(FrameQueries & queries);
+    uint32_t findScope(const char * name);
+
+    VkDevice device = VK_NULL_HANDLE;
+    VkQueryPool queryPool = VK_NULL_HANDLE;
+    double nanosecondsPerTick = 0.0;
+    uint64_t timestampMask = 0;
+
+    std::vector<FrameQueries> frames;
+    FrameQueries * recording = nullptr;
+    uint32_t frameScope = GPU_PROFILER_NO_SCOPE;
+    uint64_t frameNumber = 0;
+
+    std::vector<uint64_t> results;
+    std::vector<double> totals;
+
+    FILE * csv = nullptr;
+};
+
+// Times the commands recorded while it's in scope
+struct GPUProfileScope
+{
+    GPUProfiler & profiler;
+    VkCommandBuffer commandbuffer;
+    uint32_t scope;
+
+    GPUProfileScope(GPUProfiler & profiler, VkCommandBuffer commandbuffer, const char * name) : profiler(profiler), commandbuffer(commandbuffer)
+    {
+        scope = profiler.beginScope(commandbuffer, name);
+    }
+
+    ~GPUProfileScope() { profiler.endScope(commandbuffer, scope); }
+};
+
+#endif
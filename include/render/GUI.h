@@ -23,15 +23,22 @@ class GUIElement
 class FPSMeter : public GUIElement, public System
 {
     uint32_t frameCount;
-    long timeBeforeFPSUpdate;
+    double timeBeforeFPSUpdate;
     uint32_t FPS;
+    float frameTime;
+    float latency;
+    float fenceWait;
+    uint64_t allocationCount;
+    float allocationsPerFrame;
+
+    Renderer * renderer;
 
     public:
-    FPSMeter();
+    FPSMeter(Renderer * renderer);
     ~FPSMeter();
 
     void init();
-    void update(long elapsedTime);
+    void update(double elapsedTime);
     void draw();
 };
 
@@ -55,25 +62,29 @@ class Console : public GUIElement, public System
     ~Console();
 
     void init();
-    void update(long elapsedTime);
+    void update(double elapsedTime);
     void draw();
 
     int onConsoleUpdate(ImGuiInputTextCallbackData * data);
 
     void exit(std::vector<std::string> args);
     void addModel(std::vector<std::string> args);
+    void setFrameLimit(std::vector<std::string> args);
+    void spawnInstance(std::vector<std::string> args);
+    void profile(std::vector<std::string> args);
 };
 
 class LightingTweaker : public GUIElement, public System
 {
     DirectionalLightData data;
+    bool changed = true;
 
     public:
     LightingTweaker();
     ~LightingTweaker();
 
     void init();
-    void update(long elapsedTime);
+    void update(double elapsedTime);
     void draw();
 };
 
@@ -86,12 +97,27 @@ class ModelViewer : public GUIElement, public System
     ~ModelViewer();
 
     void init();
-    void update(long elapsedTime);
+    void update(double elapsedTime);
     void draw();
 
-    void getModels(Message * msg);
+    void getModels();
 };
 
+#ifdef KOI_MESSAGE_STATS
+
+class MessageStatsPanel : public GUIElement, public System
+{
+    public:
+    MessageStatsPanel();
+    ~MessageStatsPanel();
+
+    void init();
+    void update(double elapsedTime);
+    void draw();
+};
+
+#endif
+
 class GUI
 {
     public:
@@ -0,0 +1,84 @@
+#ifndef GEOMETRY_ARENA_H
+#define GEOMETRY_ARENA_H
+
+#include <mutex>
+#include <vector>
+#include <cstdint>
+
+#include <render/Context.h>
+
+// Blocks are allocated at this size, larger uploads get a block of their own
+#define GEOMETRY_ARENA_BLOCK_SIZE (16 * 1024 * 1024)
+#define GEOMETRY_ARENA_INVALID (~0u)
+
+enum GeometryBufferType
+{
+    GeometryVertices,
+    GeometryIndices,
+    GeometryBufferTypeCount
+};
+
+// A run of elements in one of the arena's blocks. Counted in vertices or indices rather than
+// bytes so first is the draw's vertexOffset or firstIndex as is. The block's buffer is kept
+// alongside so draws don't look it up while loader threads may be adding blocks
+struct GeometryRange
+{
+    uint32_t block = GEOMETRY_ARENA_INVALID;
+    uint32_t first = 0;
+    uint32_t count = 0;
+    VkBuffer buffer = VK_NULL_HANDLE;
+};
+
+// Every shape's vertices and indices, sub-allocated from a few large device local buffers
+// instead of a buffer and an allocation each. Draws from the same block share their vertex
+// and index binds. Uploads and frees may come from any thread, the model loader's included.
+class GeometryArena
+{
+    public:
+    void create(Context * context);
+    // The device must be idle
+    void destroy();
+
+    // Queues a copy of count elements into a free range of a block with the context's upload
+    // batcher, the range holds them once ticket completes
+    GeometryRange upload(GeometryBufferType type, const void * data, uint32_t count, UploadTicket * ticket);
+    // Once nothing in flight draws from the range
+    void free(GeometryBufferType type, const GeometryRange & range);
+
+    private:
+    struct FreeRun
+    {
+        uint32_t first;
+        uint32_t count;
+    };
+
+    struct Block
+    {
+        VkBuffer buffer = VK_NULL_HANDLE;
+        DeviceAllocation allocation;
+        uint32_t capacity = 0;
+
+        // Sorted by first, neighbours are merged when a range is freed
+        std::vector<FreeRun> freeRuns;
+    };
+
+    struct Heap
+    {
+        const char * name;
+        uint32_t stride;
+        VkBufferUsageFlags usage;
+        std::vector<Block> blocks;
+        uint64_t usedElements = 0;
+    };
+
+    Context * context = nullptr;
+    Heap heaps[GeometryBufferTypeCount];
+
+    // Guards the heaps, held for allocation and freeing only, never for the copies
+    std::mutex mutex;
+
+    GeometryRange allocate(Heap & heap, uint32_t count);
+    void createBlock(Heap & heap, uint32_t capacity);
+};
+
+#endif
@@ -0,0 +1,28 @@
+#ifndef HEADLESS_CONTEXT_H
+#define HEADLESS_CONTEXT_H
+
+#include <render/Context.h>
+
+#define HEADLESS_DEFAULT_WIDTH 1920
+#define HEADLESS_DEFAULT_HEIGHT 1080
+
+// Vulkan without a window, surface or swapchain. Runs on any device with a graphics
+// queue, software ICDs like lavapipe included, for benchmarking on machines with no display.
+class HeadlessContext : public Context
+{
+    public:
+    VkExtent2D extent;
+
+    std::vector<const char *> layers = {"VK_LAYER_KHRONOS_validation"};
+    std::vector<const char *> instanceExtensions = {"VK_EXT_debug_utils"};
+    std::vector<const char *> deviceExtensions = {};
+    std::vector<VkQueueFlagBits> queueFlags = {VK_QUEUE_GRAPHICS_BIT, VK_QUEUE_TRANSFER_BIT};
+
+    HeadlessContext(uint32_t width = HEADLESS_DEFAULT_WIDTH, uint32_t height = HEADLESS_DEFAULT_HEIGHT);
+    ~HeadlessContext();
+
+    void init();
+    void update(double elapsedTime);
+};
+
+#endif
@@ -0,0 +1,66 @@
+#ifndef HEADLESS_RENDERER_H
+#define HEADLESS_RENDERER_H
+
+#include <string>
+
+#include <render/Renderer.h>
+#include <render/HeadlessContext.h>
+
+struct FrameTimeStats
+{
+    uint64_t count = 0;
+    double total = 0.0;
+    double min = 0.0;
+    double max = 0.0;
+
+    void add(double milliseconds);
+    double getAverage() const { return (count > 0) ? total / count : 0.0; }
+};
+
+// Renders into its own images, one per frame in flight, in place of a swapchain. Nothing is
+// presented. Runs for a fixed number of frames (0 runs until Exit), then reports CPU and GPU
+// frame times. With a capture file every frame is copied back to the host and the last one
+// saved as a PPM.
+class HeadlessRenderer : public Renderer
+{
+    public:
+    HeadlessContext * context;
+
+    uint32_t frameTarget;
+    std::string captureFilename;
+
+    FrameTimeStats cpuFrameTimes;
+    FrameTimeStats gpuFrameTimes;
+
+    HeadlessRenderer(HeadlessContext * context, uint32_t frameTarget = 0, std::string captureFilename = "", uint32_t framesInFlight = RENDERER_DEFAULT_FRAMES_IN_FLIGHT);
+    ~HeadlessRenderer();
+
+    VkCommandBuffer getNextCommandBuffer();
+    void render(VkCommandBuffer commandBuffer);
+    void present();
+
+    void init();
+    void update(double elapsedTime);
+
+    // Writes the last frame read back, false if there is none
+    bool writeFrame(const std::string & filename);
+
+    private:
+    std::vector<DeviceAllocation> imageAllocations;
+
+    bool readback;
+    std::vector<VkBuffer> readbackBuffers;
+    std::vector<DeviceAllocation> readbackAllocations;
+    std::vector<void *> readbackData;
+    int32_t lastReadback = -1;
+
+    // Two timestamps per image, written at the start and end of its command buffer
+    VkQueryPool queryPool = VK_NULL_HANDLE;
+    float timestampPeriod = 0.0f;
+    std::vector<bool> submitted;
+
+    // Gathers the results of the image's previous submission, its fence must be signaled
+    void collectFrame(uint32_t image);
+};
+
+#endif
@@ -1,12 +1,19 @@
 #ifndef MODEL_H
 #define MODEL_H
 
+#include <mutex>
 #include <vector>
 
+#include <system/Memory.h>
+
 #include <render/KoiVector.h>
 #include <render/Context.h>
 #include <render/Renderer.h>
 #include <render/Scene.h>
+#include <render/RenderQueue.h>
+
+// A material's textureID when it has no texture, only untextured models keep it
+#define MATERIAL_NO_TEXTURE (~0u)
 
 class Model;
 
@@ -43,19 +50,19 @@ class Shape
 {
     public:
 	uint32_t materialID;
-	std::vector<Vertex> vertices;
-	std::vector<uint32_t> indices;
+	tagged_vector<Vertex, MemoryTagGeometry> vertices;
+	tagged_vector<uint32_t, MemoryTagGeometry> indices;
 
-    VkDescriptorSetLayout descriptorSetLayout;
-    std::vector<VkDescriptorSet> descriptorSets;
+    // Shared through the scene's pipeline registry
+    uint32_t pipeline = PIPELINE_REGISTRY_INVALID;
+    bool blended = false;
 
-	VkDeviceSize vertexBufferSize;
-	VkBuffer vertexBuffer;
-	VkDeviceMemory vertexMemory;
+    // Sort key id, draws of the same buffers end up next to each other
+    uint32_t sortID = 0;
 
-	VkDeviceSize indexBufferSize;
-	VkBuffer indexBuffer;
-	VkDeviceMemory indexMemory;
+	// Where the vertices and indices live in the scene's geometry arena
+	GeometryRange vertexRange;
+	GeometryRange indexRange;
 };
 
 struct MaterialData
@@ -72,9 +79,28 @@ struct Material
 {
 	std::vector<UniformBuffer> buffers;
 
+    // One per swapchain image, shared by every shape using the material so consecutive
+    // draws of it bind the set once
+    std::vector<VkDescriptorSet> descriptorSets;
+
     static VkDescriptorSetLayoutBinding getVkDescriptorSetLayoutBinding(uint32_t binding);
 
     MaterialData data;
+
+    // Index into a TexturedModel's textures, MATERIAL_NO_TEXTURE if the material names none
+    uint32_t textureID = MATERIAL_NO_TEXTURE;
+
+    // Sort key id, draws with the same material end up next to each other
+    uint32_t sortID = 0;
+};
+
+// Decoded and not yet on the GPU, malloc'd by the decoder
+struct TexturePixels
+{
+	unsigned char * data = nullptr;
+	VkExtent2D extent = {0, 0};
+	VkDeviceSize size = 0;
+	VkFormat format = VK_FORMAT_R8G8B8A8_UNORM;
 };
 
 struct Texture
@@ -83,15 +109,34 @@ struct Texture
 
 	VkFormat format;
 	VkImage image = VK_NULL_HANDLE;
-	VkDeviceMemory memory = VK_NULL_HANDLE;
+	DeviceAllocation allocation;
 	VkImageView imageView = VK_NULL_HANDLE;
 
+	// Between decode and create
+	TexturePixels pixels;
+
+	// Not sampled before this completes, the image is in no layout until then
+	UploadTicket upload = UPLOAD_TICKET_NONE;
+
+    // Shared by every created texture, textures are created on the model loader's threads
     static uint32_t count;
     static VkSampler sampler;
+    static std::mutex samplerMutex;
 
 	Texture(std::string filename, Context * context, Renderer * renderer);
+	// Nothing loaded yet, see decode and create
+	Texture(Context * context);
 	~Texture();
 
+	// Reads the file into pixels, no Vulkan calls so any thread may decode
+	void decode(std::string filename);
+	// A single white texel, for materials that don't name a texture
+	void decodeWhite();
+	// Creates the image and queues the pixels' upload
+	void create();
+
+	POOL_ALLOCATED(Texture, MemoryTagTextures)
+
     static VkDescriptorSetLayoutBinding getVkDescriptorSetLayoutBinding(uint32_t binding);
 };
 
@@ -104,52 +149,72 @@ class ModelBase
 
 	std::string name;
 
+    // Given when the model is requested and kept for good, shown by the model viewer and used by spawn
+    uint32_t id = 0;
+
     std::vector<Shape> shapes;
     std::vector<Material> materials;
-    std::vector<Instance> instances;
 
-    VkDeviceSize instanceBufferSize;
-	VkBuffer instanceBuffer = VK_NULL_HANDLE;
-	VkDeviceMemory instanceMemory = VK_NULL_HANDLE;
+    // Model space bounds over every shape
+    Vec3 boundsMin = Vec3(0.0f);
+    Vec3 boundsMax = Vec3(0.0f);
 
     VkDescriptorPool descriptorPool = VK_NULL_HANDLE;
+    VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
+
+    // The last of the model's geometry and texture uploads, it isn't drawn before that completes
+    UploadTicket upload = UPLOAD_TICKET_NONE;
 
 	ModelBase(Context * context, Renderer * renderer, Scene * scene);
 	virtual ~ModelBase() = 0;
 
-	virtual void draw(VkCommandBuffer commandbuffer) = 0;
+	void computeBounds();
+
+	// Queues every shape's vertices and indices for the scene's geometry arena
+	void uploadGeometry();
+
+	// Asks the scene's registry for each shape's pipeline, opaque or blended and specialized
+	// for what the shape's material uses, and numbers shapes and materials for sorting.
+	// pipelineLayout must be set first
+	void requestPipelines(uint32_t shaderFeatures);
+
+	// Models hold no instances of their own, the scene's entities reference them and pass in
+	// the range of the scene's instance buffer holding their transforms. Pushes a packet per
+	// shape whose pipeline is ready, depth is the nearest instance's squared distance to the camera
+	virtual void enqueue(RenderQueue & queue, uint32_t firstInstance, uint32_t instanceCount, float depth);
 };
 
 class Model : public ModelBase
 {
 	public:
-    static uint32_t count;
-    static VkPipelineLayout pipelineLayout;
-    static VkPipeline pipeline;
-
-    virtual void createVkPipeline();
-
 	Model(std::string filename, std::string location, Context * context, Renderer * renderer, Scene * scene);
 	virtual ~Model();
 
-    virtual void draw(VkCommandBuffer commandbuffer);
+	POOL_ALLOCATED(Model, MemoryTagModels)
 };
 
+// Loads in three stages so the model loader can spread them over its threads, the first
+// constructor runs all of them in a row
 class TexturedModel : public ModelBase
 {
     public:
     std::vector<Texture *> textures;
-
-    static uint32_t count;
-    static VkPipelineLayout pipelineLayout;
-    static VkPipeline pipeline;
-
-    virtual void createVkPipeline();
+    // The file each of textures is decoded from, empty for the white texture of untextured materials
+    std::vector<std::string> textureFiles;
 
     TexturedModel(std::string filename, std::string location, Context * context, Renderer * renderer, Scene * scene);
+    TexturedModel(Context * context, Renderer * renderer, Scene * scene);
     virtual ~TexturedModel();
 
-    virtual void draw(VkCommandBuffer commandbuffer);
+    // Reads the OBJ and its materials, deduplicates vertices and lists the textures to decode
+    void parse(std::string filename, std::string location);
+    // Independent of each other, any thread
+    void decodeTexture(uint32_t index);
+    // Once every texture is decoded. Queues the geometry and texture uploads and creates
+    // the buffers, descriptor sets and pipelines, the model can be drawn once upload completes
+    void createResources();
+
+    POOL_ALLOCATED(TexturedModel, MemoryTagModels)
 };
 
 class RiggedModel : public ModelBase
@@ -0,0 +1,128 @@
+#ifndef MODEL_LOADER_H
+#define MODEL_LOADER_H
+
+#include <deque>
+#include <mutex>
+#include <atomic>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include <chrono>
+#include <cstdint>
+#include <condition_variable>
+
+#include <render/KoiVector.h>
+#include <render/Context.h>
+#include <render/Renderer.h>
+#include <render/Scene.h>
+#include <render/Model.h>
+
+#define MODEL_LOADER_THREADS 2
+// A job's texture index when the job parses the model instead
+#define MODEL_LOADER_PARSE (~0u)
+
+enum ModelLoadState : uint32_t
+{
+    ModelLoadParsing,
+    ModelLoadDecoding,
+    ModelLoadUploading,
+    ModelLoadResident,
+    ModelLoadFailed
+};
+
+// A model handed to the scene by collect, along with where it was asked to be spawned
+struct ModelLoadResult
+{
+    ModelBase * model;
+    std::vector<Mat4> spawns;
+};
+
+struct ModelLoadProgress
+{
+    uint32_t id;
+    std::string name;
+    ModelLoadState state;
+    // 0 to 1, parsing, decoding and uploading each texture and uploading the geometry are a step each
+    float progress;
+};
+
+// Loads textured models off the frame. Parsing, vertex deduplication and texture decoding run
+// on the loader's own threads, a model's textures are decoded in parallel and ahead of models
+// that haven't been parsed yet. Once decoded the same thread queues the model's uploads with
+// the context's upload batcher, which spreads them over as many frames as its budget needs.
+// The scene collects models once their uploads are complete, in the order they were requested.
+// Each model's id is handed out by request and never changes, whichever loads fail or finish first.
+class ModelLoader
+{
+    public:
+    ModelLoader() {}
+    ~ModelLoader() {}
+
+    void create(Context * context, Renderer * renderer, Scene * scene, uint32_t threadCount = MODEL_LOADER_THREADS);
+    // The device must be idle, models still loading are deleted
+    void destroy();
+
+    // Any thread, returns right away with the model's id
+    uint32_t request(const std::string & filename, const std::string & location);
+
+    // Spawns the model with this id once it's collected, false if no load in flight has it
+    bool spawnWhenCollected(uint32_t id, const Mat4 & transform);
+
+    // Scene thread, once a frame. Appends the models now resident and deletes failed ones
+    void collect(std::vector<ModelLoadResult> & resident);
+
+    // Loads still in flight, oldest first
+    void getProgress(std::vector<ModelLoadProgress> & progress);
+
+    private:
+    struct Load
+    {
+        uint32_t id;
+        std::string filename;
+        std::string location;
+        std::chrono::steady_clock::time_point start;
+
+        TexturedModel * model = nullptr;
+        std::atomic<uint32_t> state;
+
+        // Set once parsed, the last decode to finish creates the model's resources
+        uint32_t textureCount = 0;
+        std::atomic<uint32_t> texturesLeft;
+        std::atomic<bool> failed;
+
+        std::vector<Mat4> spawns;
+
+        Load() : state(ModelLoadParsing), texturesLeft(0), failed(false) {}
+    };
+
+    struct Job
+    {
+        Load * load;
+        uint32_t texture;
+    };
+
+    Context * context = nullptr;
+    Renderer * renderer = nullptr;
+    Scene * scene = nullptr;
+
+    // Guards loads, the queue and the spawns
+    std::mutex mutex;
+
+    // Requested order, so ids ascending, owned here until collected
+    std::deque<std::unique_ptr<Load>> loads;
+    uint32_t nextID = 0;
+
+    std::deque<Job> queue;
+    bool stopping = false;
+
+    std::condition_variable queued;
+    std::vector<std::thread> threads;
+
+    void loadLoop(uint32_t index);
+    void parse(Load & load);
+    void decode(Load & load, uint32_t texture);
+    void finish(Load & load);
+};
+
+#endif
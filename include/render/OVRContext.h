@@ -31,7 +31,7 @@ class OVRContext : public Context
     ~OVRContext();
 
     void init();
-    void update(long elapsedTime);
+    void update(double elapsedTime);
 };
 
 #endif
\ No newline at end of file
@@ -23,7 +23,7 @@ class OVRRenderer : public Renderer
     void present();
 
     void init();
-    void update(long elapsedTime);
+    void update(double elapsedTime);
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,168 @@
+#ifndef PIPELINE_REGISTRY_H
+#define PIPELINE_REGISTRY_H
+
+#include <deque>
+#include <mutex>
+#include <atomic>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include <cstdint>
+#include <unordered_map>
+#include <condition_variable>
+
+#include <render/Context.h>
+
+// Ids index a fixed array, so draws look pipelines up without locking
+#define PIPELINE_REGISTRY_MAX_PIPELINES 256
+#define PIPELINE_REGISTRY_COMPILE_THREADS 2
+#define PIPELINE_REGISTRY_INVALID (~0u)
+
+enum PipelineVertexLayout : uint32_t
+{
+    // Vertex at binding 0, Instance at binding 1
+    PipelineVertexMeshInstanced
+};
+
+enum PipelineBlendMode : uint32_t
+{
+    PipelineBlendOpaque,
+    PipelineBlendAlpha
+};
+
+// Fragment shader features, bit n is the shader's specialization constant n so features a
+// material doesn't use are compiled out of its pipeline
+enum PipelineShaderFeature : uint32_t
+{
+    PipelineFeatureTextured = 1 << 0,
+    PipelineFeatureSpecular = 1 << 1,
+    PipelineFeatureAlpha = 1 << 2,
+
+    PipelineFeatureCount = 3,
+    PipelineFeatureAll = (1 << PipelineFeatureCount) - 1
+};
+
+enum PipelineStatus : uint32_t
+{
+    PipelineCompiling,
+    PipelineReady,
+    PipelineFailed
+};
+
+// Everything a graphics pipeline is built from. Two equal states always share one pipeline,
+// whichever model asked for it. Layouts come from the registry too, so equal descriptor set
+// layouts give the same VkPipelineLayout handle
+struct PipelineState
+{
+    // Names of embedded shaders, or paths of SPIR-V files for shaders that aren't built in
+    std::string vertexShader;
+    std::string fragmentShader;
+    uint32_t shaderFeatures = PipelineFeatureAll;
+
+    PipelineVertexLayout vertexLayout = PipelineVertexMeshInstanced;
+    VkPrimitiveTopology topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+
+    VkPolygonMode polygonMode = VK_POLYGON_MODE_FILL;
+    VkCullModeFlags cullMode = VK_CULL_MODE_NONE;
+    VkFrontFace frontFace = VK_FRONT_FACE_CLOCKWISE;
+
+    VkBool32 depthTest = VK_TRUE;
+    VkBool32 depthWrite = VK_TRUE;
+    VkCompareOp depthCompare = VK_COMPARE_OP_LESS;
+
+    PipelineBlendMode blendMode = PipelineBlendOpaque;
+
+    VkSampleCountFlagBits samples = VK_SAMPLE_COUNT_1_BIT;
+    VkExtent2D extent = {0, 0};
+
+    VkRenderPass renderPass = VK_NULL_HANDLE;
+    uint32_t subpass = 0;
+    VkPipelineLayout layout = VK_NULL_HANDLE;
+
+    size_t hash() const;
+    bool operator == (const PipelineState & other) const;
+};
+
+struct PipelineStateHash
+{
+    size_t operator()(const PipelineState & state) const { return state.hash(); }
+};
+
+struct PipelineEntry
+{
+    PipelineState state;
+    VkShaderModule vertexModule = VK_NULL_HANDLE;
+    VkShaderModule fragmentModule = VK_NULL_HANDLE;
+
+    // Written by the compile thread before status is published
+    VkPipeline pipeline = VK_NULL_HANDLE;
+    std::atomic<uint32_t> status;
+
+    PipelineEntry() : status(PipelineCompiling) {}
+};
+
+// Creates each unique pipeline once and hands out ids for it. New states are compiled on the
+// registry's own threads, get() returns VK_NULL_HANDLE until they're ready so callers skip
+// the draw instead of stalling the frame. Shader modules, descriptor set layouts and pipeline
+// layouts are shared the same way and live until the registry is destroyed.
+class PipelineRegistry
+{
+    public:
+    PipelineRegistry() : count(0) {}
+    ~PipelineRegistry() {}
+
+    void create(Context * context, uint32_t threadCount = PIPELINE_REGISTRY_COMPILE_THREADS);
+    // The device must be idle, pipelines still queued are never compiled
+    void destroy();
+
+    VkDescriptorSetLayout getDescriptorSetLayout(const std::vector<VkDescriptorSetLayoutBinding> & bindings);
+    VkPipelineLayout getPipelineLayout(const std::vector<VkDescriptorSetLayout> & setLayouts);
+
+    // Returns the state's id, queueing its compile the first time it's seen. Any thread
+    uint32_t request(const PipelineState & state);
+
+    VkPipeline get(uint32_t id) const
+    {
+        if (id >= count.load(std::memory_order_acquire) || entries[id].status.load(std::memory_order_acquire) != PipelineReady)
+            return VK_NULL_HANDLE;
+
+        return entries[id].pipeline;
+    }
+
+    // Blocks until the pipeline is compiled or has failed
+    void wait(uint32_t id);
+    void waitIdle();
+
+    uint32_t size() const { return count.load(std::memory_order_acquire); }
+
+    // Requests answered with an existing pipeline
+    uint32_t hits = 0;
+
+    private:
+    VkShaderModule getShader(const std::string & filename);
+    void compile(PipelineEntry & entry);
+    void compileLoop(uint32_t index);
+
+    Context * context = nullptr;
+
+    std::unique_ptr<PipelineEntry[]> entries;
+    std::atomic<uint32_t> count;
+
+    // Guards the maps, the queue and hits
+    std::mutex mutex;
+    std::unordered_map<PipelineState, uint32_t, PipelineStateHash> ids;
+    std::unordered_map<std::string, VkShaderModule> shaders;
+    std::unordered_map<std::string, VkDescriptorSetLayout> setLayouts;
+    std::unordered_map<std::string, VkPipelineLayout> pipelineLayouts;
+
+    std::deque<uint32_t> queue;
+    uint32_t compiling = 0;
+    bool stopping = false;
+
+    std::condition_variable queued;
+    std::condition_variable compiled;
+    std::vector<std::thread> threads;
+};
+
+#endif
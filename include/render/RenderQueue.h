@@ -0,0 +1,89 @@
+#ifndef RENDER_QUEUE_H
+#define RENDER_QUEUE_H
+
+#include <vector>
+#include <cstdint>
+
+#include <render/KoiVulkan.h>
+
+// Sort key fields, most significant first
+//   opaque:  pass | pipeline | material | mesh | depth, front to back within equal state
+//   blended: pass | depth, back to front | pipeline | material | mesh
+#define RENDER_QUEUE_PASS_BITS 2
+#define RENDER_QUEUE_PIPELINE_BITS 8
+#define RENDER_QUEUE_MATERIAL_BITS 16
+#define RENDER_QUEUE_MESH_BITS 16
+#define RENDER_QUEUE_DEPTH_BITS 22
+
+enum RenderQueuePass
+{
+    RenderQueueOpaque,
+    RenderQueueBlended
+};
+
+// One indexed, instanced draw and the state it needs. Set 0 (the scene's) is the same for
+// every packet, set 1 is the material
+struct DrawPacket
+{
+    VkPipeline pipeline;
+    VkPipelineLayout layout;
+    VkDescriptorSet material;
+    VkBuffer vertexBuffer;
+    VkBuffer indexBuffer;
+    int32_t vertexOffset;
+    uint32_t firstIndex;
+    uint32_t indexCount;
+    uint32_t firstInstance;
+    uint32_t instanceCount;
+};
+
+// Commands recorded for a frame. Without the queue every draw bound all four kinds of state
+struct RenderQueueStats
+{
+    uint32_t draws = 0;
+    uint32_t pipelineBinds = 0;
+    uint32_t descriptorBinds = 0;
+    uint32_t vertexBinds = 0;
+    uint32_t indexBinds = 0;
+
+    uint32_t getBindCount() const { return pipelineBinds + descriptorBinds + vertexBinds + indexBinds; }
+    void add(const RenderQueueStats & other);
+};
+
+// Flat list of a frame's draws. Packets are pushed in any order with a sort key, radix sorted
+// so draws sharing state end up next to each other, then recorded binding only what changed
+// from the previous packet. Keeps its memory between frames.
+class RenderQueue
+{
+    public:
+    static uint64_t makeKey(RenderQueuePass pass, uint32_t pipeline, uint32_t material, uint32_t mesh, float depth);
+
+    void clear();
+    void push(uint64_t key, const DrawPacket & packet);
+    void sort();
+
+    uint32_t size() const { return (uint32_t) items.size(); }
+
+    // Records sorted packets [first, last) into a command buffer inside the scene's render pass.
+    // Each call starts from nothing bound, so chunks recorded into separate buffers work too
+    RenderQueueStats record(VkCommandBuffer commandbuffer, VkDescriptorSet sceneDescriptorSet, VkBuffer instanceBuffer, uint32_t first, uint32_t last) const;
+
+    // Set once a frame by the scene, shown in the overlay
+    static void setLastFrame(const RenderQueueStats & stats) { lastFrame = stats; }
+    static RenderQueueStats getLastFrame() { return lastFrame; }
+
+    private:
+    struct SortItem
+    {
+        uint64_t key;
+        uint32_t packet;
+    };
+
+    std::vector<DrawPacket> packets;
+    std::vector<SortItem> items;
+    std::vector<SortItem> scratch;
+
+    static RenderQueueStats lastFrame;
+};
+
+#endif
@@ -3,10 +3,26 @@
 
 #include <system/System.h>
 #include <render/Context.h>
+#include <render/GPUProfiler.h>
+
+#define RENDERER_DEFAULT_FRAMES_IN_FLIGHT 2
+#define RENDERER_MAX_FRAMES_IN_FLIGHT 4
 
 VkFormat chooseColorFormat(VkPhysicalDevice physicalDevice);
 VkFormat chooseDepthFormat(VkPhysicalDevice physicalDevice);
 
+// Everything one frame records and submits with. While the GPU executes a frame the CPU
+// records the next into another FrameContext, the fence says when this one is free again.
+// Per frame buffers elsewhere (uniforms, instances) are indexed by Renderer::currentFrame.
+struct FrameContext
+{
+    VkCommandPool commandPool;
+    VkCommandBuffer commandBuffer;
+    VkFence fence;
+    VkSemaphore imageAvailable;
+    VkSemaphore renderFinished;
+};
+
 class Renderer : public System
 {
     public:
@@ -17,37 +33,45 @@ class Renderer : public System
     uint32_t currentImageIndex = 0;
     unsigned long long frameCount = 0;
 
+    uint32_t framesInFlight = RENDERER_DEFAULT_FRAMES_IN_FLIGHT;
+    uint32_t currentFrame = 0;
+    std::vector<FrameContext> frames;
+
+    // Time the CPU spent blocked on the current frame's fence, i.e. waiting for the GPU
+    double fenceWaitTime = 0.0;
+    double averageFenceWaitTime = 0.0;
+
+    // GPU time of the frame and of any scopes opened on its command buffer
+    GPUProfiler profiler;
+
     uint32_t length;
     VkExtent2D extent;
 
     std::vector<VkImage> images;
     std::vector<VkImageView> imageviews;
-    std::vector<VkCommandBuffer> commandbuffers;
-    std::vector<VkFence> fences;
 
     VkFormat colorFormat;
     VkImage colorImage;
-    VkDeviceMemory colorImageMemory;
+    DeviceAllocation colorImageAllocation;
     VkImageView colorImageView;
 
     VkFormat depthFormat;
     VkImage depthImage;
-    VkDeviceMemory depthImageMemory;
+    DeviceAllocation depthImageAllocation;
     VkImageView depthImageView;;
 
-    VkSemaphore imageAvailable;
-    VkSemaphore renderFinished;
-
     Renderer() {}
     virtual ~Renderer() {}
 
-    virtual VkViewport getDefaultVkViewport();
-    virtual VkRect2D getDefaultScissor();
-    virtual VkPipelineRasterizationStateCreateInfo getDefaultRasterizer();
-    virtual VkPipelineMultisampleStateCreateInfo getDefaultMultisampling();
-    virtual VkPipelineDepthStencilStateCreateInfo getDefaultDepthStencil();
-    virtual void getDefaultColorBlendAttachments(std::vector<VkPipelineColorBlendAttachmentState> & colorBlendAttachments);
-    virtual VkPipelineColorBlendStateCreateInfo getDefaultColorBlend(std::vector<VkPipelineColorBlendAttachmentState> & colorBlendAttachments);
+    void createFrameContexts(VkDevice device, uint32_t queueFamilyIndex);
+    void destroyFrameContexts(VkDevice device);
+
+    // Blocks until the GPU is done with the current frame's previous submission, then
+    // resets its command pool for recording. The fence is reset right before submitting
+    FrameContext & waitForFrame(VkDevice device);
+
+    // Moves on to the next FrameContext once the current one is submitted
+    void advanceFrame();
 
     virtual VkCommandBuffer getNextCommandBuffer() = 0;
     virtual void render(VkCommandBuffer commandBuffer) = 0;
@@ -6,12 +6,14 @@
 #include <system/System.h>
 #include <render/Context.h>
 #include <render/Renderer.h>
+#include <render/PipelineRegistry.h>
+#include <render/GeometryArena.h>
 
 struct UniformBuffer
 {
-    void * data;
-    VkBuffer buffer;
-    VkDeviceMemory memory;
+    void * data = nullptr;
+    VkBuffer buffer = VK_NULL_HANDLE;
+    DeviceAllocation allocation;
 };
 
 class Scene : public System
@@ -27,6 +29,12 @@ class Scene : public System
     VkDescriptorSetLayout descriptorSetLayout;
 	std::vector<VkDescriptorSet> descriptorSets;
 
+    // Pipelines and layouts of everything drawn in the scene's render pass
+    PipelineRegistry pipelines;
+
+    // Vertices and indices of every model in the scene
+    GeometryArena geometry;
+
     Scene() {};
     ~Scene() {};
 
@@ -8,51 +8,117 @@
 #include <render/Renderer.h>
 #include <render/Scene.h>
 #include <render/Model.h>
+#include <render/ModelLoader.h>
+#include <render/RenderQueue.h>
 #include <render/Camera.h>
+#include <render/Components.h>
 
-struct ModelData
-{
-    uint32_t _id;
-    std::string name;
-    uint32_t instanceCount;
-};
+#include <system/DirtyTracker.h>
+#include <system/JobSystem.h>
+#include <system/Payloads.h>
 
-struct DirectionalLightData
-{
-    alignas(16) Vec3 direction = {1.0f, 1.0f, 1.0f};
-    alignas(16) Vec3 ambient = {0.1f, 0.1f, 0.1f};
-    alignas(16) Vec3 diffuse = {0.5f, 0.5f, 0.5f};
-    alignas(16) Vec3 specular = {1.0f, 1.0f, 1.0f};
-};
+// Shorter draw lists are recorded inline, splitting them up costs more than it saves
+#define SCENE3D_PARALLEL_RECORD_MIN_PACKETS 64
+#define SCENE3D_MAX_RECORD_CHUNKS 16
 
 struct DirectionalLight
 {
     uint32_t index = 0; 
     std::vector<UniformBuffer> buffers;
+    DirtyTracker bufferState = DirtyTracker(UploadLighting);
 
     DirectionalLightData data;
 
     static VkDescriptorSetLayoutBinding getVkDescriptorSetLayoutBinding(uint32_t binding);
 };
 
+// A run of the instance buffer drawn with one model
+struct DrawRange
+{
+    ModelBase * model;
+    uint32_t firstInstance;
+    uint32_t instanceCount;
+};
+
+// A secondary command buffer and the pool it was allocated from
+struct RecordSlot
+{
+    VkCommandPool commandPool = VK_NULL_HANDLE;
+    VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+};
+
 class Scene3D : public Scene
 {
     public:
     Camera camera;
     DirectionalLight light;
 
+    // Only models whose uploads have completed, the rest are still with the loader
     std::vector<ModelBase *> models;
+    ModelLoader loader;
+    std::vector<ModelLoadResult> loaded;
+
+    // Everything placed in the scene is an entity with a Transform and a MeshRef
+    EntityRegistry entities;
+
+    // Holds every Transform, one mapped buffer per frame in flight since the previous
+    // frames may still be reading their copies
+    std::vector<UniformBuffer> instanceBuffers;
+    std::vector<uint32_t> instanceCapacities;
+    DirtyTracker instanceState = DirtyTracker(UploadInstances);
+
+    std::vector<DrawRange> drawRanges;
+    uint64_t drawRangesVersion = ~0ull;
+    uint64_t boundsVersion = ~0ull;
+
+    // Every shape of every range as a draw packet, rebuilt and sorted each frame
+    RenderQueue renderQueue;
+
+    // Long draw lists are split into chunks recorded in parallel on app->jobs, each into its
+    // own secondary command buffer. A chunk is recorded by a single task and its pool is
+    // never touched by another, so each pool is only ever used by one thread at a time.
+    // One slot per chunk per frame in flight, reset once the frame's fence has been waited on
+    std::vector<std::vector<RecordSlot>> recordSlots;
+    uint32_t recordChunkCount = 0;
+    TaskGraph recordGraph;
+    bool parallelRecording = true;
+
+    // The sorted queue the record tasks split between them, set before running a record graph,
+    // and what each chunk recorded
+    const RenderQueue * recordQueue = nullptr;
+    RenderQueueStats recordStats[SCENE3D_MAX_RECORD_CHUNKS];
+
+    // CPU time spent recording the scene, the last frame and a running average in ms
+    double recordTime = 0.0;
+    double averageRecordTime = 0.0;
+
+    // Logs how recording scales with thread and model count on the next frame with
+    // something to draw, see --bench-recording
+    bool benchmarkRecording = false;
 
     Scene3D(Context * context, Renderer * renderer);
     ~Scene3D();
 
     void init();
-    void update(long elapsedTime);
+    void update(double elapsedTime);
     void draw(VkCommandBuffer commandbuffer);
 
-    void updateLighting(Message * message);
-    void getModelData(Message * message);
-    void addModel(Message * message);
+    Entity spawn(ModelBase * model, const Mat4 & transform);
+    void collectModels();
+    void updateBounds();
+    void prepareUniforms();
+    void prepareInstances();
+    void buildRenderQueue();
+
+    void createRecordSlots();
+    void resetRecordSlots();
+    void recordChunk(uint32_t chunk, uint32_t chunkCount);
+    void runRecordingBenchmark();
+
+    void updateLighting(const DirectionalLightData & data);
+    void getModelData(std::vector<ModelData> * models);
+    void addModel(std::vector<std::string> * args);
+    void spawnInstance(const SpawnData & data);
 };
 
 #endif
\ No newline at end of file
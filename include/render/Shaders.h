@@ -0,0 +1,20 @@
+#ifndef SHADERS_H
+#define SHADERS_H
+
+#include <string>
+#include <cstddef>
+#include <cstdint>
+
+// SPIR-V compiled from assets/shaders by the build and linked into the binary, so creating
+// a pipeline never touches the filesystem
+struct EmbeddedShader
+{
+    const char * name;
+    const uint32_t * code;
+    size_t size;
+};
+
+// Looked up by the GLSL source's file name, e.g. "shader.frag". nullptr if it wasn't built in
+const EmbeddedShader * findEmbeddedShader(const std::string & name);
+
+#endif
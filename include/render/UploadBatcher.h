@@ -0,0 +1,142 @@
+#ifndef UPLOAD_BATCHER_H
+#define UPLOAD_BATCHER_H
+
+#include <mutex>
+#include <deque>
+#include <vector>
+#include <atomic>
+#include <cstdint>
+
+#include <render/KoiVulkan.h>
+#include <render/DeviceAllocator.h>
+
+// Persistently mapped staging memory reused as a ring. Uploads that don't fit get a staging
+// buffer of their own
+#define UPLOAD_RING_SIZE (32ull * 1024 * 1024)
+// Bytes copied on the transfer queue each frame, see RenderSystem::uploadBudget
+#define UPLOAD_DEFAULT_FRAME_BUDGET (8ull * 1024 * 1024)
+// Submits in flight at once, each with its own command buffer and fence
+#define UPLOAD_MAX_BATCHES 4
+// Ring offsets are kept to this, a multiple of every texel block size
+#define UPLOAD_RING_ALIGNMENT 16
+
+#define UPLOAD_TICKET_NONE 0
+
+class Context;
+
+// Uploads complete in the order they were requested, a ticket is done once every ticket up to it is
+typedef uint64_t UploadTicket;
+
+struct UploadBatcherStats
+{
+    // Submitted by the last flush
+    VkDeviceSize bytes = 0;
+    uint32_t copies = 0;
+    uint32_t batchesInFlight = 0;
+
+    // Left for the following frames' budgets
+    uint32_t pending = 0;
+    VkDeviceSize pendingBytes = 0;
+};
+
+// Uploads buffer and image data to device local memory without waiting on the GPU. Data is
+// copied to staging memory when requested, from any thread. Each frame's flush then records up
+// to frameBudget bytes of copies and layout transitions into one submit on the transfer queue,
+// its fence says when those uploads are done and their staging memory can be reused.
+class UploadBatcher
+{
+    public:
+    VkDeviceSize frameBudget = UPLOAD_DEFAULT_FRAME_BUDGET;
+
+    // After the context's allocator is created, and before it is destroyed
+    void create(Context * context);
+    // Waits for submitted uploads and drops pending ones, no thread may still be requesting
+    void destroy();
+
+    UploadTicket uploadBuffer(VkBuffer buffer, VkDeviceSize offset, const void * data, VkDeviceSize size);
+    // Single mip images, left in VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL
+    UploadTicket uploadImage(VkImage image, VkExtent3D extent, uint32_t layers, const void * data, VkDeviceSize size);
+
+    bool isComplete(UploadTicket ticket) const { return ticket <= completed.load(std::memory_order_acquire); }
+
+    // Once a frame on the render thread, retires finished submits and submits pending uploads
+    void flush();
+
+    UploadBatcherStats getLastFrame() const { return lastFrame; }
+
+    private:
+    struct Upload
+    {
+        UploadTicket ticket;
+
+        // A buffer range, or the whole of an image
+        VkBuffer buffer = VK_NULL_HANDLE;
+        VkDeviceSize offset = 0;
+        VkImage image = VK_NULL_HANDLE;
+        VkExtent3D extent = {};
+        uint32_t layers = 0;
+
+        VkDeviceSize size;
+
+        // Where the data waits, the ring or a staging buffer of the upload's own
+        VkBuffer stagingBuffer;
+        VkDeviceSize stagingOffset = 0;
+        DeviceAllocation stagingAllocation;
+
+        // Ring space taken including wrap padding, and the ring's head after it
+        VkDeviceSize ringBytes = 0;
+        VkDeviceSize ringEnd = 0;
+
+        // The requesting thread copies the data in without the lock, flush stops at the first
+        // upload that isn't written yet
+        bool written = false;
+    };
+
+    struct Batch
+    {
+        VkCommandBuffer commandBuffer;
+        VkFence fence;
+
+        UploadTicket lastTicket = UPLOAD_TICKET_NONE;
+        VkDeviceSize ringBytes = 0;
+        VkDeviceSize ringEnd = 0;
+
+        std::vector<VkBuffer> stagingBuffers;
+        std::vector<DeviceAllocation> stagingAllocations;
+    };
+
+    Context * context = nullptr;
+    std::mutex mutex;
+
+    VkBuffer ringBuffer = VK_NULL_HANDLE;
+    DeviceAllocation ringAllocation;
+    VkDeviceSize ringHead = 0;
+    VkDeviceSize ringTail = 0;
+    VkDeviceSize ringUsed = 0;
+
+    // Oldest first, tickets ascending
+    std::deque<Upload> pending;
+    VkDeviceSize pendingBytes = 0;
+    UploadTicket lastTicket = UPLOAD_TICKET_NONE;
+    std::atomic<UploadTicket> completed = {UPLOAD_TICKET_NONE};
+
+    VkCommandPool commandPool = VK_NULL_HANDLE;
+    Batch batches[UPLOAD_MAX_BATCHES];
+    // Submitted round robin, retired oldest first
+    uint32_t oldestBatch = 0;
+    uint32_t batchesInFlight = 0;
+
+    UploadBatcherStats lastFrame;
+
+    // Reused by flush so recording doesn't allocate every frame
+    std::vector<Upload> submitting;
+    std::vector<VkImageMemoryBarrier> imageBarriers;
+    std::vector<VkBufferCopy> regions;
+
+    UploadTicket request(Upload & upload, const void * data);
+    bool reserveRing(VkDeviceSize size, VkDeviceSize * offset, VkDeviceSize * bytes);
+    void retire(bool wait);
+    void record(Batch & batch);
+};
+
+#endif
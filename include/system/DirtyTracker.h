@@ -0,0 +1,68 @@
+#ifndef DIRTY_TRACKER_H
+#define DIRTY_TRACKER_H
+
+#include <atomic>
+#include <vector>
+#include <cstdint>
+
+#define DIRTY_TRACKER_NEVER_UPLOADED (~0ull)
+
+// GPU visible state that is only written when it changes
+enum UploadType
+{
+	UploadCamera,
+	UploadLighting,
+	UploadInstances,
+	UploadTypeCount
+};
+
+struct UploadCounters
+{
+	uint32_t uploaded = 0;
+	uint32_t skipped = 0;
+};
+
+// Per frame count of buffer writes made and avoided, published by ProjectKoi::run. Recording
+// is thread safe, systems updating in parallel may upload at the same time.
+class UploadStats
+{
+	public:
+	static void record(UploadType type, bool uploaded);
+	static void endFrame();
+
+	static UploadCounters getLastFrame(UploadType type) { return lastFrame[type]; }
+	static const char * getTypeName(UploadType type);
+
+	private:
+	static std::atomic<uint32_t> uploaded[UploadTypeCount];
+	static std::atomic<uint32_t> skipped[UploadTypeCount];
+	static UploadCounters lastFrame[UploadTypeCount];
+};
+
+// Tracks which copies of a piece of state are stale. State kept in several buffers (one
+// per swapchain image, say) has one copy each. The owner bumps the version when the source
+// changes, or takes it from a source that is versioned already (a ComponentPool). Each copy
+// is then written once and skipped until the next change.
+class DirtyTracker
+{
+	public:
+	DirtyTracker(UploadType type, uint32_t copies = 1);
+
+	void resize(uint32_t copies);
+
+	void markDirty() { version++; }
+	void setVersion(uint64_t version) { this->version = version; }
+
+	// The copy's buffer was recreated and holds nothing
+	void invalidate(uint32_t copy) { uploaded[copy] = DIRTY_TRACKER_NEVER_UPLOADED; }
+
+	// True when the copy is stale, after which it's considered up to date
+	bool needsUpload(uint32_t copy);
+
+	private:
+	UploadType type;
+	uint64_t version = 0;
+	std::vector<uint64_t> uploaded;
+};
+
+#endif
\ No newline at end of file
@@ -0,0 +1,256 @@
+#ifndef ENTITY_H
+#define ENTITY_H
+
+#include <atomic>
+#include <memory>
+#include <vector>
+#include <cstdint>
+#include <numeric>
+#include <algorithm>
+
+#include <system/Log.h>
+#include <system/Memory.h>
+
+// An entity is just an id, the low bits index the registry and the high bits hold a
+// generation that is bumped each time the index is recycled, so stale ids are caught
+typedef uint32_t Entity;
+
+#define ENTITY_INDEX_BITS 24
+#define ENTITY_INDEX_MASK ((1u << ENTITY_INDEX_BITS) - 1)
+#define NULL_ENTITY 0xFFFFFFFF
+#define MAX_COMPONENT_TYPES 32
+#define COMPONENT_POOL_NULL_SLOT 0xFFFFFFFF
+
+inline uint32_t getEntityIndex(Entity entity) { return entity & ENTITY_INDEX_MASK; }
+inline uint32_t getEntityGeneration(Entity entity) { return entity >> ENTITY_INDEX_BITS; }
+
+// ===============================================================================================================
+//                                             Component Pool
+// ===============================================================================================================
+
+class ComponentPoolBase
+{
+	public:
+	virtual ~ComponentPoolBase() {}
+
+	virtual bool has(Entity entity) const = 0;
+	virtual void remove(Entity entity) = 0;
+	virtual uint32_t size() const = 0;
+};
+
+// Sparse set. Components live packed in a dense array in no particular entity order, so a
+// sweep over one component type is a linear walk over contiguous memory. sparse maps an
+// entity index to its slot in the dense arrays, removal swaps the last slot into the hole.
+template <typename T>
+class ComponentPool : public ComponentPoolBase
+{
+	public:
+	// Bumped whenever components are added, removed or reordered
+	uint64_t structureVersion = 0;
+
+	// Bumped by add() and by modified(), anything caching the dense array compares against it
+	uint64_t version = 0;
+
+	T & add(Entity entity, const T & component)
+	{
+		uint32_t index = getEntityIndex(entity);
+
+		if (index >= sparse.size())
+			sparse.resize(index + 1, COMPONENT_POOL_NULL_SLOT);
+
+		version++;
+
+		if (sparse[index] != COMPONENT_POOL_NULL_SLOT)
+		{
+			components[sparse[index]] = component;
+			return components[sparse[index]];
+		}
+
+		sparse[index] = (uint32_t) components.size();
+		components.push_back(component);
+		entities.push_back(entity);
+		structureVersion++;
+
+		return components.back();
+	}
+
+	void remove(Entity entity)
+	{
+		if (!has(entity))
+			return;
+
+		uint32_t slot = sparse[getEntityIndex(entity)];
+		uint32_t last = (uint32_t) components.size() - 1;
+
+		if (slot != last)
+		{
+			components[slot] = std::move(components[last]);
+			entities[slot] = entities[last];
+			sparse[getEntityIndex(entities[slot])] = slot;
+		}
+
+		components.pop_back();
+		entities.pop_back();
+		sparse[getEntityIndex(entity)] = COMPONENT_POOL_NULL_SLOT;
+
+		structureVersion++;
+		version++;
+	}
+
+	bool has(Entity entity) const
+	{
+		uint32_t index = getEntityIndex(entity);
+		return index < sparse.size() && sparse[index] != COMPONENT_POOL_NULL_SLOT && entities[sparse[index]] == entity;
+	}
+
+	T & get(Entity entity)
+	{
+		VALIDATE(has(entity), "ENTITY - Entity %u does not have the requested component", entity);
+		return components[sparse[getEntityIndex(entity)]];
+	}
+
+	T * find(Entity entity)
+	{
+		return has(entity) ? &components[sparse[getEntityIndex(entity)]] : nullptr;
+	}
+
+	// Writes through get() or data() are not tracked, call this once after changing components
+	void modified() { version++; }
+
+	uint32_t size() const { return (uint32_t) components.size(); }
+
+	T * data() { return components.data(); }
+	const T * data() const { return components.data(); }
+	const Entity * getEntities() const { return entities.data(); }
+
+	void reserve(uint32_t count)
+	{
+		components.reserve(count);
+		entities.reserve(count);
+	}
+
+	// Reorders the dense arrays by compare(Entity a, Entity b), e.g. to group together the
+	// transforms that are drawn with one call. Structural changes only, not per frame work.
+	template <typename Compare>
+	void sort(Compare compare)
+	{
+		tagged_vector<uint32_t, MemoryTagEntities> order(components.size());
+		std::iota(order.begin(), order.end(), 0);
+		std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) { return compare(entities[a], entities[b]); });
+
+		tagged_vector<T, MemoryTagEntities> sortedComponents;
+		tagged_vector<Entity, MemoryTagEntities> sortedEntities;
+		sortedComponents.reserve(components.size());
+		sortedEntities.reserve(entities.size());
+
+		for (uint32_t i = 0; i < order.size(); i++)
+		{
+			sortedComponents.push_back(std::move(components[order[i]]));
+			sortedEntities.push_back(entities[order[i]]);
+			sparse[getEntityIndex(sortedEntities[i])] = i;
+		}
+
+		components.swap(sortedComponents);
+		entities.swap(sortedEntities);
+
+		structureVersion++;
+		version++;
+	}
+
+	private:
+	tagged_vector<T, MemoryTagEntities> components;
+	tagged_vector<Entity, MemoryTagEntities> entities;
+	tagged_vector<uint32_t, MemoryTagEntities> sparse;
+};
+
+// ===============================================================================================================
+//                                            Entity Registry
+// ===============================================================================================================
+
+// Owns the entities and one pool per component type. Entities have no behaviour and no base
+// class, what an entity is comes entirely from the components attached to it. Not thread
+// safe, structural changes belong to the system that owns the registry.
+class EntityRegistry
+{
+	public:
+	EntityRegistry();
+	~EntityRegistry();
+
+	Entity create();
+	void destroy(Entity entity);
+	bool isAlive(Entity entity) const;
+
+	uint32_t getAliveCount() const { return aliveCount; }
+
+	template <typename T>
+	ComponentPool<T> & getPool()
+	{
+		uint32_t type = getComponentType<T>();
+
+		if (pools[type] == nullptr)
+			pools[type].reset(new ComponentPool<T>());
+
+		return *static_cast<ComponentPool<T> *>(pools[type].get());
+	}
+
+	template <typename T>
+	T & add(Entity entity, const T & component = T())
+	{
+		VALIDATE(isAlive(entity), "ENTITY - Adding a component to dead entity %u", entity);
+		return getPool<T>().add(entity, component);
+	}
+
+	template <typename T>
+	void remove(Entity entity) { getPool<T>().remove(entity); }
+
+	template <typename T>
+	bool has(Entity entity) { return getPool<T>().has(entity); }
+
+	template <typename T>
+	T & get(Entity entity) { return getPool<T>().get(entity); }
+
+	template <typename T>
+	T * find(Entity entity) { return getPool<T>().find(entity); }
+
+	// Calls function(entity, T &, Others &...) for every entity holding all of the components.
+	// Walks T's dense array in order, so T should be the rarest of the set.
+	template <typename T, typename... Others, typename Function>
+	void each(Function function)
+	{
+		ComponentPool<T> & pool = getPool<T>();
+
+		T * components = pool.data();
+		const Entity * entities = pool.getEntities();
+
+		for (uint32_t i = 0; i < pool.size(); i++)
+		{
+			if (hasAll<Others...>(entities[i]))
+				function(entities[i], components[i], getPool<Others>().get(entities[i])...);
+		}
+	}
+
+	private:
+	template <typename T>
+	static uint32_t getComponentType()
+	{
+		static const uint32_t type = nextComponentType.fetch_add(1, std::memory_order_relaxed);
+		VALIDATE(type < MAX_COMPONENT_TYPES, "ENTITY - Too many component types, raise MAX_COMPONENT_TYPES");
+		return type;
+	}
+
+	template <typename... Types>
+	typename std::enable_if<sizeof...(Types) == 0, bool>::type hasAll(Entity entity) { return true; }
+
+	template <typename T, typename... Types>
+	bool hasAll(Entity entity) { return getPool<T>().has(entity) && hasAll<Types...>(entity); }
+
+	static std::atomic<uint32_t> nextComponentType;
+
+	std::unique_ptr<ComponentPoolBase> pools[MAX_COMPONENT_TYPES];
+
+	tagged_vector<uint32_t, MemoryTagEntities> generations;
+	tagged_vector<uint32_t, MemoryTagEntities> freeIndices;
+	uint32_t aliveCount = 0;
+};
+
+#endif
\ No newline at end of file
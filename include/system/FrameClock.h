@@ -0,0 +1,70 @@
+#ifndef FRAME_CLOCK_H
+#define FRAME_CLOCK_H
+
+#include <chrono>
+#include <thread>
+#include <cstdint>
+
+typedef std::chrono::steady_clock frame_clock_t;
+
+#define FRAME_CLOCK_DEFAULT_FIXED_STEP (1000.0 / 120.0)
+#define FRAME_CLOCK_MAX_ACCUMULATED 250.0
+#define FRAME_CLOCK_SPIN_THRESHOLD 2.0
+
+// Monotonic frame timing. All times are in milliseconds as doubles, so nothing is
+// truncated at high frame rates.
+//
+// Each frame: waitForNextFrame() -> tick() -> while (stepFixed()) fixed update ->
+// update interpolated by getAlpha() -> draw -> markPresent().
+class FrameClock
+{
+	public:
+	FrameClock();
+
+	// Starts a new frame, returns the time since the previous tick
+	double tick();
+
+	// Starts a new frame that took the given time, whatever the wall clock says. Used to
+	// play back recorded frame times
+	double tick(double elapsed);
+
+	// Consumes one fixed step from the accumulator, false once less than a step is left
+	bool stepFixed();
+
+	// How far the current frame is between the last two fixed steps, in [0, 1)
+	double getAlpha() const { return accumulator / fixedStep; }
+
+	void setFixedStep(double milliseconds);
+
+	// 0 disables the limiter
+	void setFrameLimit(double framesPerSecond);
+
+	// Sleeps for most of the remaining frame budget and spins for the last
+	// FRAME_CLOCK_SPIN_THRESHOLD ms, sleep alone overshoots by the scheduler's granularity
+	void waitForNextFrame();
+
+	// Waits until the given time has passed since the last tick, same sleep then spin
+	void waitForFrameTime(double milliseconds);
+
+	// Input-to-present latency. The first input after a present starts the timer,
+	// the next present stops it. Measured up to vkQueuePresentKHR returning, not scan out
+	void markInput();
+	void markPresent();
+
+	double elapsed = 0.0;
+	double fixedStep = FRAME_CLOCK_DEFAULT_FIXED_STEP;
+	double frameLimit = 0.0;
+	uint64_t frameCount = 0;
+
+	double latency = 0.0;
+	double averageLatency = 0.0;
+
+	private:
+	frame_clock_t::time_point lastTick;
+	frame_clock_t::time_point inputTime;
+	bool inputPending = false;
+
+	double accumulator = 0.0;
+};
+
+#endif
\ No newline at end of file
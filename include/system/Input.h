@@ -0,0 +1,107 @@
+#ifndef INPUT_H
+#define INPUT_H
+
+#include <atomic>
+#include <bitset>
+#include <vector>
+#include <cstdint>
+
+#include <system/Message.h>
+
+// Key codes are GLFW's, which top out at 348
+#define INPUT_KEY_COUNT 512
+#define INPUT_MOUSE_BUTTON_COUNT 8
+#define INPUT_EVENT_RING_CAPACITY 1024
+#ifndef CACHE_LINE_SIZE
+#define CACHE_LINE_SIZE 64
+#endif
+
+enum InputEventType : uint32_t
+{
+	InputKeyPress,
+	InputKeyRelease,
+	InputMouseButtonPress,
+	InputMouseButtonRelease,
+	InputCursorMove,
+	InputCursorWarp,
+	InputFocus
+};
+
+// Raw event as reported by the platform. code is the key, button or focus state,
+// x and y the cursor position for InputCursorMove and InputCursorWarp. A warp moves the
+// cursor without it counting as mouse movement.
+struct InputEvent
+{
+	InputEventType type;
+	int32_t code;
+	float x;
+	float y;
+};
+
+// ===============================================================================================================
+//                                            Input Event Ring
+// ===============================================================================================================
+
+// Bounded single-producer / single-consumer ring. The platform's event callbacks push, the
+// InputSystem drains once per frame. Neither side blocks or allocates, and they may live
+// on different threads.
+class InputEventRing
+{
+	public:
+	InputEventRing(uint32_t capacity = INPUT_EVENT_RING_CAPACITY);
+
+	// Returns false (and counts a drop) when the ring is full
+	bool push(const InputEvent & event);
+	bool pop(InputEvent & event);
+
+	uint32_t takeDroppedCount() { return dropped.exchange(0, std::memory_order_relaxed); }
+
+	private:
+	std::vector<InputEvent> events;
+	uint32_t mask;
+
+	alignas(CACHE_LINE_SIZE) std::atomic<uint32_t> writePosition;
+	alignas(CACHE_LINE_SIZE) std::atomic<uint32_t> readPosition;
+	alignas(CACHE_LINE_SIZE) std::atomic<uint32_t> dropped;
+};
+
+// ===============================================================================================================
+//                                             Input Snapshot
+// ===============================================================================================================
+
+// Everything that happened to the input devices over one frame. Held state carries over
+// between frames, presses, releases and the mouse delta only cover the events drained this
+// frame. Written by the InputSystem before the frame's updates, read only afterwards.
+struct InputSnapshot
+{
+	std::bitset<INPUT_KEY_COUNT> keysDown;
+	std::bitset<INPUT_KEY_COUNT> keysPressed;
+	std::bitset<INPUT_KEY_COUNT> keysReleased;
+
+	std::bitset<INPUT_MOUSE_BUTTON_COUNT> buttonsDown;
+	std::bitset<INPUT_MOUSE_BUTTON_COUNT> buttonsPressed;
+	std::bitset<INPUT_MOUSE_BUTTON_COUNT> buttonsReleased;
+
+	Float2 cursor = {0.0f, 0.0f};
+	Float2 mouseDelta = {0.0f, 0.0f};
+
+	bool focused = true;
+
+	// Mouse deltas are only kept while the window has captured the cursor
+	bool cursorCaptured = false;
+
+	uint32_t eventCount = 0;
+
+	void beginFrame();
+	void apply(const InputEvent & event);
+
+	bool isKeyDown(int key) const { return key >= 0 && key < INPUT_KEY_COUNT && keysDown[key]; }
+	bool wasKeyPressed(int key) const { return key >= 0 && key < INPUT_KEY_COUNT && keysPressed[key]; }
+	bool wasKeyReleased(int key) const { return key >= 0 && key < INPUT_KEY_COUNT && keysReleased[key]; }
+
+	bool isButtonDown(int button) const { return button >= 0 && button < INPUT_MOUSE_BUTTON_COUNT && buttonsDown[button]; }
+	bool wasButtonPressed(int button) const { return button >= 0 && button < INPUT_MOUSE_BUTTON_COUNT && buttonsPressed[button]; }
+	bool wasButtonReleased(int button) const { return button >= 0 && button < INPUT_MOUSE_BUTTON_COUNT && buttonsReleased[button]; }
+};
+
+#endif
\ No newline at end of file
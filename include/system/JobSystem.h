@@ -0,0 +1,124 @@
+#ifndef JOB_SYSTEM_H
+#define JOB_SYSTEM_H
+
+#include <mutex>
+#include <deque>
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <condition_variable>
+
+#include <system/Log.h>
+#include <system/Memory.h>
+
+#define JOB_QUEUE_INITIAL_CAPACITY 64
+
+#ifndef CACHE_LINE_SIZE
+#define CACHE_LINE_SIZE 64
+#endif
+
+class TaskGraph;
+
+struct Task
+{
+	std::function<void()> work;
+	std::vector<Task *> successors;
+
+	// Number of predecessors, pending is reset to this each time the graph is run
+	uint32_t dependencyCount = 0;
+	std::atomic<uint32_t> pending;
+
+	// Tasks that touch the window, GLFW or the Android looper may only run on the main thread
+	bool mainThreadOnly = false;
+
+	TaskGraph * graph = nullptr;
+};
+
+// A dependency graph of tasks that is built once and run many times (e.g. every frame).
+// Edges are added with precede(a, b), meaning a must finish before b starts.
+class TaskGraph
+{
+	public:
+	TaskGraph() {}
+	~TaskGraph() {}
+
+	Task * addTask(std::function<void()> work, bool mainThreadOnly = false);
+	void precede(Task * before, Task * after);
+	void clear();
+
+	size_t size() const { return tasks.size(); }
+
+	private:
+	friend class JobSystem;
+
+	// Deque so task pointers stay valid as the graph grows
+	std::deque<Task> tasks;
+	std::atomic<uint32_t> remaining;
+
+	std::mutex exceptionMutex;
+	std::exception_ptr exception;
+};
+
+// Work-stealing thread pool. Each thread owns a queue, pushes and pops its own work
+// from the back and steals from the front of the others when it runs dry. The thread
+// calling run() takes part in the work and is the only one allowed to run main thread
+// tasks. In serial mode every task runs on the calling thread in the order it was added.
+class JobSystem
+{
+	public:
+	JobSystem(uint32_t workerCount = defaultWorkerCount());
+	~JobSystem();
+
+	// Blocks until every task in the graph has run. Rethrows the first exception a task threw.
+	// The graph must be acyclic and run() must not be called from inside a task
+	void run(TaskGraph & graph);
+
+	uint32_t getWorkerCount() const { return (uint32_t) workers.size(); }
+
+	static uint32_t defaultWorkerCount();
+
+	bool serial = false;
+
+	private:
+	// Growable ring, steady state frames push and pop without touching the heap
+	struct alignas(CACHE_LINE_SIZE) WorkQueue
+	{
+		std::mutex mutex;
+		tagged_vector<Task *, MemoryTagJobs> tasks;
+		size_t head = 0;
+		size_t count = 0;
+
+		WorkQueue() : tasks(JOB_QUEUE_INITIAL_CAPACITY) {}
+
+		bool empty() const { return count == 0; }
+		void pushBack(Task * task);
+		Task * popBack();
+		Task * popFront();
+	};
+
+	void runSerial(TaskGraph & graph);
+	void workerLoop(uint32_t index);
+
+	void submit(Task * task, uint32_t index);
+	Task * pop(uint32_t index);
+	Task * steal(uint32_t index);
+	Task * popMainThread();
+	void execute(Task * task, uint32_t index);
+
+	// Queue 0 belongs to the thread calling run(), workers own 1..n
+	std::vector<std::unique_ptr<WorkQueue>> queues;
+	WorkQueue mainThreadQueue;
+
+	std::vector<std::thread> workers;
+
+	std::mutex sleepMutex;
+	std::condition_variable wake;
+	std::atomic<uint32_t> queuedTasks;
+	std::atomic<bool> running;
+};
+
+#endif
\ No newline at end of file
@@ -1,6 +1,9 @@
 #ifndef LOG_H
 #define LOG_H
 
+#include <cstdio>
+#include <stdexcept>
+
 #if !defined(LOG_HANDLE)
 #define LOG_HANDLE "Project-Koi"
 #endif
@@ -51,6 +54,7 @@
 
 #endif
 
-#define VALIDATE(result, ...) { if(!(result)) { PANIC(__VA_ARGS__); throw std::runtime_error("helpful error message"); } }
+// The exception carries the same message, so whoever catches it can report why
+#define VALIDATE(result, ...) { if(!(result)) { char validateMessage[512]; snprintf(validateMessage, sizeof(validateMessage), __VA_ARGS__); PANIC("%s", validateMessage); throw std::runtime_error(validateMessage); } }
 
 #endif
\ No newline at end of file
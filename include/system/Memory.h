@@ -0,0 +1,207 @@
+#ifndef MEMORY_H
+#define MEMORY_H
+
+#include <new>
+#include <mutex>
+#include <atomic>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <utility>
+
+#include <system/Log.h>
+
+#define MEMORY_DEFAULT_ALIGNMENT 16
+#define FRAME_ARENA_DEFAULT_SIZE (4 * 1024 * 1024)
+#define OBJECT_POOL_DEFAULT_CHUNK 32
+
+// Every engine allocation is charged to a tag so the memory panel can tell where it went
+enum MemoryTag
+{
+	MemoryTagGeneral,
+	MemoryTagFrame,
+	MemoryTagPool,
+	MemoryTagGeometry,
+	MemoryTagTextures,
+	MemoryTagModels,
+	MemoryTagGUI,
+	MemoryTagJobs,
+	MemoryTagEntities,
+	MemoryTagCount
+};
+
+struct MemoryTagStats
+{
+	std::atomic<uint64_t> bytes;
+	std::atomic<uint64_t> peakBytes;
+	std::atomic<uint64_t> allocations;
+	std::atomic<uint64_t> liveAllocations;
+};
+
+// ===============================================================================================================
+//                                              Memory Manager
+// ===============================================================================================================
+
+// Long lived heap with per tag accounting. Blocks carry a small header recording their
+// tag and size, so deallocate() needs only the pointer. Thread safe.
+class MemoryManager
+{
+	public:
+	static void * allocate(size_t size, MemoryTag tag = MemoryTagGeneral);
+	static void deallocate(void * pointer);
+
+	static const MemoryTagStats & getStats(MemoryTag tag) { return stats[tag]; }
+	static const char * getTagName(MemoryTag tag);
+
+	// Calls to the global operator new, only counted when built with KOI_TRACK_ALLOCATIONS
+	static uint64_t getGlobalAllocationCount();
+
+	private:
+	static MemoryTagStats stats[MemoryTagCount];
+};
+
+// std compatible allocator that routes a container through the MemoryManager
+template <typename T, MemoryTag Tag>
+struct TaggedAllocator
+{
+	typedef T value_type;
+
+	template <typename U>
+	struct rebind { typedef TaggedAllocator<U, Tag> other; };
+
+	TaggedAllocator() {}
+
+	template <typename U>
+	TaggedAllocator(const TaggedAllocator<U, Tag> &) {}
+
+	T * allocate(size_t count)
+	{
+		static_assert(alignof(T) <= MEMORY_DEFAULT_ALIGNMENT, "Type is over-aligned for the MemoryManager");
+		return static_cast<T *>(MemoryManager::allocate(count * sizeof(T), Tag));
+	}
+
+	void deallocate(T * pointer, size_t /*count*/)
+	{
+		MemoryManager::deallocate(pointer);
+	}
+
+	template <typename U>
+	bool operator == (const TaggedAllocator<U, Tag> &) const { return true; }
+
+	template <typename U>
+	bool operator != (const TaggedAllocator<U, Tag> &) const { return false; }
+};
+
+template <typename T, MemoryTag Tag = MemoryTagGeneral>
+using tagged_vector = std::vector<T, TaggedAllocator<T, Tag>>;
+
+// ===============================================================================================================
+//                                               Frame Arena
+// ===============================================================================================================
+
+// Linear allocator for data that lives until the end of the frame. Allocation is a single
+// atomic add, so systems updating in parallel can share it. Nothing is freed individually,
+// ProjectKoi::run resets the whole arena after present. Destructors are never run.
+class FrameArena
+{
+	public:
+	FrameArena(size_t capacity = FRAME_ARENA_DEFAULT_SIZE);
+	~FrameArena();
+
+	// Returns nullptr when the frame's budget is used up
+	void * allocate(size_t size, size_t alignment = MEMORY_DEFAULT_ALIGNMENT);
+	void reset();
+
+	template <typename T, typename... Args>
+	T * create(Args&&... args)
+	{
+		void * memory = allocate(sizeof(T), alignof(T));
+		return (memory != nullptr) ? new (memory) T(std::forward<Args>(args)...) : nullptr;
+	}
+
+	size_t getCapacity() const { return capacity; }
+	size_t getUsed() const { return offset.load(std::memory_order_relaxed); }
+	size_t getPeak() const { return peak; }
+
+	private:
+	unsigned char * memory;
+	size_t capacity;
+	size_t peak = 0;
+	std::atomic<size_t> offset;
+};
+
+// std compatible allocator for transient containers, deallocation is a no-op
+template <typename T>
+struct FrameAllocator
+{
+	typedef T value_type;
+
+	FrameArena * arena;
+
+	FrameAllocator(FrameArena * arena) : arena(arena) {}
+
+	template <typename U>
+	FrameAllocator(const FrameAllocator<U> & other) : arena(other.arena) {}
+
+	T * allocate(size_t count)
+	{
+		void * memory = arena->allocate(count * sizeof(T), alignof(T));
+		VALIDATE(memory != nullptr, "MEMORY - Frame arena exhausted allocating %zu bytes", count * sizeof(T));
+		return static_cast<T *>(memory);
+	}
+
+	void deallocate(T * pointer, size_t count) {}
+
+	template <typename U>
+	bool operator == (const FrameAllocator<U> & other) const { return arena == other.arena; }
+
+	template <typename U>
+	bool operator != (const FrameAllocator<U> & other) const { return arena != other.arena; }
+};
+
+template <typename T>
+using frame_vector = std::vector<T, FrameAllocator<T>>;
+
+// ===============================================================================================================
+//                                               Object Pool
+// ===============================================================================================================
+
+// Fixed size blocks carved from chunks taken from the MemoryManager. Freed blocks go on a
+// free list and are reused, chunks are only returned when the pool is destroyed.
+class ObjectPool
+{
+	public:
+	ObjectPool(size_t blockSize, size_t blocksPerChunk = OBJECT_POOL_DEFAULT_CHUNK);
+	~ObjectPool();
+
+	void * allocate();
+	void deallocate(void * pointer);
+
+	size_t getBlockSize() const { return blockSize; }
+	size_t getLiveCount() const { return liveCount; }
+
+	private:
+	struct FreeBlock
+	{
+		FreeBlock * next;
+	};
+
+	void grow();
+
+	std::mutex mutex;
+	size_t blockSize;
+	size_t blocksPerChunk;
+	size_t liveCount = 0;
+
+	FreeBlock * freeList = nullptr;
+	std::vector<void *> chunks;
+};
+
+// Gives a class pooled operator new/delete. Allocations of a different size (a derived
+// class that doesn't declare its own pool) fall back to the tagged heap.
+#define POOL_ALLOCATED(className, memoryTag) \
+	static ObjectPool & getPool() { static ObjectPool pool(sizeof(className)); return pool; } \
+	static void * operator new(size_t size) { return (size == sizeof(className)) ? getPool().allocate() : MemoryManager::allocate(size, memoryTag); } \
+	static void operator delete(void * pointer, size_t size) { if (size == sizeof(className)) getPool().deallocate(pointer); else MemoryManager::deallocate(pointer); }
+
+#endif
\ No newline at end of file
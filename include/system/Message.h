@@ -1,8 +1,18 @@
 #ifndef MESSAGE_H
 #define MESSAGE_H
 
-#include <memory>
+#include <array>
 #include <string>
+#include <vector>
+#include <utility>
+#include <type_traits>
+
+#include <system/Log.h>
+
+struct GLFWwindow;
+// Defined in system/Payloads.h
+struct ModelData;
+struct DirectionalLightData;
 
 enum MessageType
 {
@@ -19,8 +29,6 @@ enum MessageType
 	SceneDestroyed,
 	KeyPress,
 	KeyRelease,
-	SetMouseCursor,
-	SetMouseDelta,
 	MouseButtonPress,
 	MouseButtonRelease,
 	SetWindowFocus,
@@ -28,87 +36,135 @@ enum MessageType
 	SetCameraDirection,
 	SetLighting,
 	GetModelData,
-	AddModel
+	AddModel,
+	SetFrameLimit,
+	SpawnInstance,
+	MessageTypeCount
 };
 
-class Message
-{
-    public:
-        MessageType type;
+// ===============================================================================================================
+//                                            Message Payloads
+// ===============================================================================================================
 
-		Message(MessageType type)
-		{
-			this->type = type;
-		}
+struct EmptyPayload {};
 
-		virtual ~Message() {};
+struct Float2
+{
+	float x;
+	float y;
 };
 
-class EmptyMessage : public Message
+struct Float3
 {
-	public:
-		EmptyMessage(MessageType type) : Message(type) {}
-		~EmptyMessage() {}
+	float x;
+	float y;
+	float z;
 };
 
-class StringMessage : public Message
+struct SpawnData
 {
-	public:
-		StringMessage(MessageType type, std::string & data) : Message(type)
-		{
-			this->data = data;
-		}
+	uint32_t model;
+	Float3 position;
+};
 
-		~StringMessage() {}
+// Each MessageType carries exactly one payload type, fixed at compile time
+template <MessageType T>
+struct MessagePayload
+{
+	typedef EmptyPayload type;
+};
 
-        std::string data;
+#define MESSAGE_PAYLOAD(messageType, payloadType) \
+	template <> struct MessagePayload<messageType> { typedef payloadType type; };
+
+MESSAGE_PAYLOAD(GLFWwindowCreated, GLFWwindow *)
+MESSAGE_PAYLOAD(KeyPress, int)
+MESSAGE_PAYLOAD(KeyRelease, int)
+MESSAGE_PAYLOAD(MouseButtonPress, int)
+MESSAGE_PAYLOAD(MouseButtonRelease, int)
+MESSAGE_PAYLOAD(SetWindowFocus, int)
+MESSAGE_PAYLOAD(SetCameraPosition, Float3)
+MESSAGE_PAYLOAD(SetCameraDirection, Float3)
+MESSAGE_PAYLOAD(SetLighting, DirectionalLightData)
+MESSAGE_PAYLOAD(GetModelData, std::vector<ModelData> *)
+MESSAGE_PAYLOAD(AddModel, std::vector<std::string> *)
+MESSAGE_PAYLOAD(SetFrameLimit, float)
+MESSAGE_PAYLOAD(SpawnInstance, SpawnData)
+
+template <MessageType T>
+using message_payload_t = typename MessagePayload<T>::type;
+
+// State messages where only the newest value matters. When several of one of these types
+// are queued within a frame, only the last is delivered, in its place among the others.
+template <MessageType T>
+struct MessageCoalesced
+{
+	static const bool value = false;
 };
 
-class IntegerMessage : public Message
+#define MESSAGE_COALESCED(messageType) \
+	template <> struct MessageCoalesced<messageType> { static const bool value = true; };
+
+MESSAGE_COALESCED(SetWindowFocus)
+MESSAGE_COALESCED(SetCameraPosition)
+MESSAGE_COALESCED(SetCameraDirection)
+MESSAGE_COALESCED(SetLighting)
+MESSAGE_COALESCED(SetFrameLimit)
+
+template <size_t... Types>
+constexpr std::array<bool, MessageTypeCount> makeMessageCoalescedTable(std::index_sequence<Types...>)
 {
-	public:
-		IntegerMessage(MessageType type, int data) : Message(type)
-		{
-			this->data = data;
-		}
+	return {{MessageCoalesced<(MessageType) Types>::value...}};
+}
 
-		~IntegerMessage() {}
-		
-        int data;
+inline bool isMessageCoalesced(MessageType type)
+{
+	static constexpr std::array<bool, MessageTypeCount> table = makeMessageCoalescedTable(std::make_index_sequence<MessageTypeCount>());
+	return table[type];
+}
+
+// Messages that originate from the user rather than from other systems, captured by a replay
+// recording alongside the raw input events. Anything derived from input or from these is
+// regenerated on playback and must not be listed.
+template <MessageType T>
+struct MessageRecorded
+{
+	static const bool value = false;
 };
 
-class PointerMessage : public Message
+#define MESSAGE_RECORDED(messageType) \
+	template <> struct MessageRecorded<messageType> { static const bool value = true; };
+
+MESSAGE_RECORDED(SetLighting)
+MESSAGE_RECORDED(AddModel)
+MESSAGE_RECORDED(SetFrameLimit)
+MESSAGE_RECORDED(SpawnInstance)
+
+// ===============================================================================================================
+//                                               Messages
+// ===============================================================================================================
+
+class MessageHeader
 {
-	public:
-		PointerMessage(MessageType type, void * data) : Message(type)
+    public:
+        MessageType type;
+
+		MessageHeader(MessageType type)
 		{
-			this->data = data;
+			this->type = type;
 		}
-
-		~PointerMessage() {}
-		
-        void * data;
 };
 
-class VectorMessage : public Message
+template <MessageType T, typename P = message_payload_t<T>>
+class Message : public MessageHeader
 {
-	public:
-		VectorMessage(MessageType type, float * data, int length) : Message(type)
-		{
-			this->data = (float *) malloc(sizeof(float) * length);
-			this->length = length;
+	static_assert(std::is_same<P, message_payload_t<T>>::value, "Payload does not match the MessageType's declared payload");
 
-			for (int i = 0; i < length; i++)
-				this->data[i] = data[i];
-		}
-
-		~VectorMessage()
-		{
-			free(data);
-		}
+	public:
+		Message() : MessageHeader(T), data() {}
+		Message(const P & data) : MessageHeader(T), data(data) {}
 
-	int length;
-	float * data;
+		P data;
 };
 
 #endif
\ No newline at end of file
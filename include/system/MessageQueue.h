@@ -0,0 +1,93 @@
+#ifndef MESSAGE_QUEUE_H
+#define MESSAGE_QUEUE_H
+
+#include <new>
+#include <atomic>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <utility>
+#include <type_traits>
+
+#include <system/Log.h>
+#include <system/Message.h>
+
+#define MESSAGE_QUEUE_CAPACITY 1024
+#define MESSAGE_SLOT_SIZE 128
+#ifndef CACHE_LINE_SIZE
+#define CACHE_LINE_SIZE 64
+#endif
+
+// Bounded multi-producer / single-consumer ring of inline message slots.
+// Any thread may push. Only the thread draining the bus (ProjectKoi::update)
+// may call front/pop. Each cell carries a sequence number that tells producers
+// when it is free and the consumer when it has been published, so no locks are
+// taken and messages never touch the heap. Queued messages must be trivially
+// copyable, they are never destroyed, only overwritten.
+
+struct alignas(16) MessageSlot
+{
+	unsigned char data[MESSAGE_SLOT_SIZE];
+};
+
+struct MessageCell
+{
+	std::atomic<size_t> sequence;
+	MessageSlot slot;
+};
+
+class MessageQueue
+{
+	public:
+	MessageQueue(uint32_t capacity = MESSAGE_QUEUE_CAPACITY);
+	~MessageQueue();
+
+	// Returns false (and counts a drop) when the queue is full
+	template <typename T, typename... Args>
+	bool push(Args&&... args)
+	{
+		static_assert(std::is_base_of<MessageHeader, T>::value, "MessageQueue can only hold Message types");
+		static_assert(std::is_trivially_copyable<T>::value, "Queued message payloads must be trivially copyable");
+		static_assert(sizeof(T) <= MESSAGE_SLOT_SIZE, "Message type does not fit in a MessageSlot");
+		static_assert(alignof(T) <= alignof(MessageSlot), "Message type is over-aligned for a MessageSlot");
+
+		MessageCell * cell = reserve();
+
+		if (cell == nullptr)
+		{
+			dropped.fetch_add(1, std::memory_order_relaxed);
+			return false;
+		}
+
+		new (cell->slot.data) T(std::forward<Args>(args)...);
+		publish(cell);
+
+		return true;
+	}
+
+	MessageHeader * front();
+	void pop();
+
+	// Consumer only, the message offset places behind the front or nullptr if it isn't published yet
+	MessageHeader * peek(uint32_t offset);
+
+	bool empty() { return front() == nullptr; }
+	uint32_t size() const;
+	uint32_t getCapacity() const { return capacity; }
+
+	uint32_t takeDroppedCount() { return dropped.exchange(0, std::memory_order_relaxed); }
+
+	private:
+	MessageCell * reserve();
+	void publish(MessageCell * cell);
+
+	std::vector<MessageCell> cells;
+	uint32_t capacity;
+	size_t mask;
+
+	alignas(CACHE_LINE_SIZE) std::atomic<size_t> enqueuePosition;
+	alignas(CACHE_LINE_SIZE) size_t dequeuePosition;
+	alignas(CACHE_LINE_SIZE) std::atomic<uint32_t> dropped;
+};
+
+#endif
\ No newline at end of file
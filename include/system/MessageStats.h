@@ -0,0 +1,82 @@
+#ifndef MESSAGE_STATS_H
+#define MESSAGE_STATS_H
+
+// Message bus instrumentation is on unless the build defines KOI_DISABLE_MESSAGE_STATS,
+// in which case none of the bookkeeping below is compiled into the bus
+#ifndef KOI_DISABLE_MESSAGE_STATS
+#define KOI_MESSAGE_STATS
+#endif
+
+#ifdef KOI_MESSAGE_STATS
+
+#include <string>
+#include <vector>
+#include <cstdint>
+
+#include <system/Message.h>
+
+class System;
+
+// Bucket 0 is under 1us, bucket i covers [2^(i-1), 2^i) us, the last bucket is open ended
+#define MESSAGE_STATS_BUCKET_COUNT 16
+
+struct MessageTimingStats
+{
+	uint64_t count = 0;
+	uint64_t totalNanoseconds = 0;
+	uint64_t maxNanoseconds = 0;
+	uint32_t histogram[MESSAGE_STATS_BUCKET_COUNT] = {};
+
+	void record(uint64_t nanoseconds);
+	void add(const MessageTimingStats & other);
+	void reset();
+
+	static uint32_t getBucket(uint64_t nanoseconds);
+};
+
+struct MessageHandlerStats
+{
+	System * system;
+	MessageType type;
+	std::string name;
+
+	MessageTimingStats frame;
+	MessageTimingStats lastFrame;
+	MessageTimingStats total;
+};
+
+// Per MessageType and per handler call counts and latencies. Times are inclusive, a
+// handler that sends messages with sendMessageNow is charged for their handlers too.
+// Main thread only, like sendMessageNow.
+class MessageStats
+{
+	public:
+	MessageStats();
+
+	// Handlers are registered once when subscribed, the index is kept by the subscriber
+	uint32_t registerHandler(System * system, MessageType type);
+
+	void recordDispatch(MessageType type, uint64_t nanoseconds);
+	void recordHandler(uint32_t handler, uint64_t nanoseconds);
+	void recordHandler(System * system, MessageType type, uint64_t nanoseconds);
+
+	// Publishes the current frame's numbers as lastFrame and starts a new frame
+	void endFrame();
+
+	const MessageTimingStats & getTypeStats(MessageType type) const { return lastFrame[type]; }
+	const MessageTimingStats & getTypeTotals(MessageType type) const { return total[type]; }
+	const std::vector<MessageHandlerStats> & getHandlerStats() const { return handlers; }
+
+	static const char * getMessageTypeName(MessageType type);
+
+	private:
+	MessageTimingStats frame[MessageTypeCount];
+	MessageTimingStats lastFrame[MessageTypeCount];
+	MessageTimingStats total[MessageTypeCount];
+
+	std::vector<MessageHandlerStats> handlers;
+};
+
+#endif
+
+#endif
\ No newline at end of file
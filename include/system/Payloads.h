@@ -0,0 +1,31 @@
+#ifndef PAYLOADS_H
+#define PAYLOADS_H
+
+#include <string>
+#include <cstdint>
+
+#include <render/KoiVector.h>
+
+// Payloads Message.h only declares, defined here so the system layer (replay, benchmarks)
+// can use them without the renderer. KoiVector.h is just glm.
+
+struct ModelData
+{
+    uint32_t _id;
+    std::string name;
+    uint32_t instanceCount;
+
+    // Models still loading come after the resident ones, with the id they'll keep
+    bool loading = false;
+    float progress = 1.0f;
+};
+
+struct DirectionalLightData
+{
+    alignas(16) Vec3 direction = {1.0f, 1.0f, 1.0f};
+    alignas(16) Vec3 ambient = {0.1f, 0.1f, 0.1f};
+    alignas(16) Vec3 diffuse = {0.5f, 0.5f, 0.5f};
+    alignas(16) Vec3 specular = {1.0f, 1.0f, 1.0f};
+};
+
+#endif
@@ -0,0 +1,107 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+// CPU zones are compiled in unless the build defines KOI_DISABLE_PROFILER. While no capture
+// is running a zone costs a relaxed load and a branch
+#ifndef KOI_DISABLE_PROFILER
+#define KOI_PROFILER
+#endif
+
+#include <mutex>
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+#include <cstdint>
+
+// Events each thread can hold per capture, later ones are dropped
+#define PROFILER_THREAD_CAPACITY 65536
+#define PROFILER_DEFAULT_FRAMES 300
+#define PROFILER_DEFAULT_FILENAME "profile.json"
+
+struct ProfileEvent
+{
+	const char * name;
+	uint64_t start;
+	uint64_t end;
+};
+
+// One thread's events. Only the owning thread writes, it allocates and clears the buffer
+// itself the first time it records into a new capture. The exporter reads up to count,
+// which is only published once the event is written, so recording never locks.
+struct ProfileThreadBuffer
+{
+	std::vector<ProfileEvent> events;
+	std::atomic<uint32_t> count;
+	std::atomic<uint32_t> capture;
+	std::atomic<uint32_t> dropped;
+
+	uint32_t index = 0;
+	std::string name;
+
+	ProfileThreadBuffer() : count(0), capture(0), dropped(0) {}
+};
+
+// Captures the zones every thread enters over a number of frames and writes them as a
+// Chrome trace (chrome://tracing, ui.perfetto.dev). Started from the console with
+// "profile <frames> [file]" or with --profile <frames>.
+class Profiler
+{
+	public:
+	static bool isCapturing() { return capturing.load(std::memory_order_relaxed); }
+
+	static void startCapture(uint32_t frames = PROFILER_DEFAULT_FRAMES, const std::string & filename = PROFILER_DEFAULT_FILENAME);
+	// Ends the capture early and writes what was recorded so far
+	static void stopCapture();
+
+	// Called by ProjectKoi::run at the end of every frame, main thread only
+	static void endFrame();
+
+	// Shown as the thread's name in the trace
+	static void setThreadName(const std::string & name);
+
+	static uint64_t now();
+	static void record(const char * name, uint64_t start, uint64_t end);
+
+	private:
+	static ProfileThreadBuffer * getThreadBuffer();
+	static bool writeTrace(const std::string & filename, uint32_t capture);
+
+	static std::atomic<bool> capturing;
+	static std::atomic<uint32_t> capture;
+
+	// Guards threads and their names, taken once per thread and when exporting
+	static std::mutex mutex;
+	static std::vector<std::unique_ptr<ProfileThreadBuffer>> threads;
+
+	static uint32_t framesRemaining;
+	static uint64_t captureStart;
+	static std::string filename;
+};
+
+// Records the time between its construction and destruction on the calling thread
+class ProfileZone
+{
+	const char * name;
+	uint64_t start;
+
+	public:
+	ProfileZone(const char * name) : name(name), start(Profiler::isCapturing() ? Profiler::now() : 0) {}
+	~ProfileZone() { if (start != 0) Profiler::record(name, start, Profiler::now()); }
+};
+
+#ifdef KOI_PROFILER
+
+#define PROFILE_CONCAT_IMPL(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_IMPL(a, b)
+
+// name must be a string literal, events keep the pointer
+#define PROFILE_ZONE(name) ProfileZone PROFILE_CONCAT(profileZone, __LINE__)(name)
+
+#else
+
+#define PROFILE_ZONE(name)
+
+#endif
+
+#endif
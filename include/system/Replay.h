@@ -0,0 +1,185 @@
+#ifndef REPLAY_H
+#define REPLAY_H
+
+#include <mutex>
+#include <atomic>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <cstring>
+#include <cstdint>
+#include <fstream>
+#include <type_traits>
+
+#include <system/Log.h>
+#include <system/Memory.h>
+#include <system/Message.h>
+#include <system/Input.h>
+
+#define REPLAY_MAGIC 0x52494F4B
+#define REPLAY_VERSION 1
+
+class MessageBus;
+
+typedef tagged_vector<unsigned char, MemoryTagGeneral> replay_buffer_t;
+
+enum ReplayMode
+{
+	ReplayIdle,
+	ReplayRecording,
+	ReplayPlaying
+};
+
+// A recording is a header followed by one block per frame: the frame marker with the
+// frame's elapsed time, the recorded messages sent during the previous frame, then the
+// input events polled at the start of this one.
+enum ReplayRecordKind : uint8_t
+{
+	ReplayRecordFrame,
+	ReplayRecordMessage,
+	ReplayRecordInput
+};
+
+struct ReplayHeader
+{
+	uint32_t magic;
+	uint32_t version;
+	double fixedStep;
+};
+
+// ===============================================================================================================
+//                                             Payload Codecs
+// ===============================================================================================================
+
+// Plain payloads are stored as their bytes. Payloads holding pointers need a specialization.
+template <typename P>
+struct ReplayCodec
+{
+	static_assert(std::is_trivially_copyable<P>::value && !std::is_pointer<P>::value, "Recorded payload needs its own ReplayCodec");
+
+	typedef P storage_t;
+
+	static void encode(replay_buffer_t & out, const P & payload)
+	{
+		const unsigned char * bytes = reinterpret_cast<const unsigned char *>(&payload);
+		out.insert(out.end(), bytes, bytes + sizeof(P));
+	}
+
+	static bool decode(const unsigned char * data, uint32_t size, storage_t & storage)
+	{
+		if (size != sizeof(P))
+			return false;
+
+		memcpy(&storage, data, sizeof(P));
+		return true;
+	}
+
+	static P getPayload(storage_t & storage) { return storage; }
+};
+
+// Console arguments, a count followed by length prefixed strings
+template <>
+struct ReplayCodec<std::vector<std::string> *>
+{
+	typedef std::vector<std::string> storage_t;
+
+	static void encode(replay_buffer_t & out, std::vector<std::string> * const & payload);
+	static bool decode(const unsigned char * data, uint32_t size, storage_t & storage);
+
+	static std::vector<std::string> * getPayload(storage_t & storage) { return &storage; }
+};
+
+// ===============================================================================================================
+//                                                 Replay
+// ===============================================================================================================
+
+// Records what enters the bus from outside, the raw input events, the user originated
+// messages (see MESSAGE_RECORDED) and every frame's elapsed time, and plays it back. The
+// simulation is fed the recorded frame times whatever the playback speed, so a replayed
+// run takes the same fixed steps and sees the same input on the same frames.
+class Replay
+{
+	public:
+	Replay();
+	~Replay();
+
+	bool startRecording(const std::string & filename, double fixedStep);
+	bool startPlayback(const std::string & filename);
+	void stop();
+
+	bool isRecording() const { return mode == ReplayRecording; }
+	bool isPlaying() const { return mode == ReplayPlaying; }
+
+	// ===== Recording (main thread) =====
+
+	void recordFrame(double elapsed);
+	void recordInput(const InputEvent & event);
+
+	// Thread safe. While playing back it returns false, live messages of recorded types are
+	// dropped so only the recording's copies are delivered.
+	template <MessageType T>
+	bool capture(const message_payload_t<T> & payload)
+	{
+		if (mode == ReplayPlaying)
+			return false;
+
+		if (mode == ReplayRecording)
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+
+			size_t start = pending.size();
+			uint16_t type = T;
+			uint32_t size = 0;
+
+			pending.push_back(ReplayRecordMessage);
+			append(pending, &type, sizeof(type));
+			append(pending, &size, sizeof(size));
+
+			ReplayCodec<message_payload_t<T>>::encode(pending, payload);
+
+			size = (uint32_t) (pending.size() - start - 1 - sizeof(type) - sizeof(size));
+			memcpy(&pending[start + 1 + sizeof(type)], &size, sizeof(size));
+		}
+
+		return true;
+	}
+
+	// ===== Playback (main thread) =====
+
+	// The next frame's recorded elapsed time. False once the recording is exhausted, at
+	// which point playback stops and a summary is logged.
+	bool nextFrame(double & elapsed);
+
+	// Sends this frame's recorded messages through the bus
+	void deliverMessages(MessageBus * bus);
+
+	bool nextInput(InputEvent & event);
+
+	double getFixedStep() const { return fixedStep; }
+
+	// Playback speed relative to the recording, 0 runs frames back to back
+	double speed = 1.0;
+
+	private:
+	static void append(replay_buffer_t & out, const void * data, size_t size);
+
+	bool read(void * out, size_t size);
+	bool peekKind(ReplayRecordKind kind);
+
+	// Read by capture() from any thread, only changed when starting or stopping
+	std::atomic<ReplayMode> mode;
+	double fixedStep = 0.0;
+
+	std::ofstream file;
+	std::mutex mutex;
+	replay_buffer_t pending;
+
+	replay_buffer_t data;
+	size_t position = 0;
+
+	uint64_t frameCount = 0;
+	double recordedTime = 0.0;
+	std::chrono::steady_clock::time_point startTime;
+};
+
+#endif
\ No newline at end of file
@@ -1,16 +1,78 @@
 #ifndef SYSTEM_H
 #define SYSTEM_H
 
-#include <queue>
 #include <vector>
 #include <unordered_map>
+#include <type_traits>
 
 #include <system/Message.h>
+#include <system/MessageQueue.h>
+#include <system/FrameClock.h>
+#include <system/Memory.h>
+#include <system/MessageStats.h>
+#include <system/Input.h>
+#include <system/Replay.h>
+#include <system/JobSystem.h>
+#include <system/Profiler.h>
 
 class System;
 class MessageBus;
 
-typedef void (System::*message_method_t)(Message *);
+// Shared state a System::update reads or writes. Updates that don't conflict on any
+// resource may run in parallel, conflicting ones run in registration order.
+enum SystemResource : uint32_t
+{
+	ResourceNone     = 0,
+	ResourceWindow   = 1 << 0,  // Window and surface
+	ResourceInput    = 1 << 1,  // Input state owned by the InputSystem, the frame snapshot is read only
+	ResourceCamera   = 1 << 2,  // Camera state and uniform buffers
+	ResourceScene    = 1 << 3,  // Models, lights and their buffers
+	ResourceRenderer = 1 << 4,  // Swapchain, command buffers and sync objects
+	ResourceGUI      = 1 << 5,  // GUI element state
+	ResourceAll      = 0xFFFFFFFF
+};
+
+// Callbacks are stored type-erased and recovered by an invoker instantiated for
+// the exact MessageType and handler signature they were registered with.
+typedef void (System::*message_method_t)();
+typedef void (*message_invoker_t)(System * system, message_method_t method, const MessageHeader * msg);
+
+// Between a handler's own type and message_method_t. Only ever cast back to the type it was
+// registered with before being called, so the mismatch GCC warns about never reaches a call
+template <typename To, typename From>
+inline To castMessageMethod(From method)
+{
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wcast-function-type"
+#endif
+	return reinterpret_cast<To>(method);
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+}
+
+template <MessageType T, typename A>
+void invokeMessageCallback(System * system, message_method_t method, const MessageHeader * msg)
+{
+	typedef void (System::*typed_method_t)(A);
+	(system->*castMessageMethod<typed_method_t>(method))(static_cast<const Message<T> *>(msg)->data);
+}
+
+inline void invokeEmptyMessageCallback(System * system, message_method_t method, const MessageHeader * /*msg*/)
+{
+	(system->*method)();
+}
+
+struct MessageSubscriber
+{
+    System * system;
+    message_method_t method;
+    message_invoker_t invoke;
+#ifdef KOI_MESSAGE_STATS
+    uint32_t statsIndex = 0;
+#endif
+};
 
 class MessageBus
 {
@@ -21,23 +83,80 @@ class MessageBus
     void registerSystem(System * s);
     void destroySystems();
 
-    void sendMessage(MessageType type);
-    void sendMessage(MessageType type, void * data);
-    void sendMessage(MessageType type, int data);
-    void sendMessage(MessageType type, std::string str);
-    void sendMessage(MessageType type, float * data, int length);
-    void sendMessage(Message * msg);
+    void subscribe(System * s, MessageType type, message_method_t method, message_invoker_t invoke);
+
+    // Thread safe, queued until the next ProjectKoi::update. Returns false if the queue is full
+    template <MessageType T>
+    bool sendMessage(const message_payload_t<T> & data)
+    {
+        // Suppressed while a replay supplies this type, which isn't a failure to queue
+        if constexpr (MessageRecorded<T>::value)
+        {
+            if (!replay.capture<T>(data))
+                return true;
+        }
+
+        return msgQueue.push<Message<T>>(data);
+    }
+
+    template <MessageType T>
+    bool sendMessage()
+    {
+        static_assert(std::is_same<message_payload_t<T>, EmptyPayload>::value, "MessageType requires a payload");
+        return msgQueue.push<Message<T>>();
+    }
+
+    // Main thread only, dispatched before returning
+    template <MessageType T>
+    void sendMessageNow(const message_payload_t<T> & data)
+    {
+        if constexpr (MessageRecorded<T>::value)
+        {
+            if (!replay.capture<T>(data))
+                return;
+        }
+
+        Message<T> msg(data);
+        sendMessageNow(&msg);
+    }
 
-    void sendMessageNow(MessageType type);
-    void sendMessageNow(MessageType type, void * data);
-    void sendMessageNow(MessageType type, int data);
-    void sendMessageNow(MessageType type, std::string str);
-    void sendMessageNow(MessageType type, float * data, int length);
-    void sendMessageNow(Message * msg);
+    template <MessageType T>
+    void sendMessageNow()
+    {
+        static_assert(std::is_same<message_payload_t<T>, EmptyPayload>::value, "MessageType requires a payload");
+        Message<T> msg;
+        sendMessageNow(&msg);
+    }
+
+    void sendMessageNow(const MessageHeader * msg);
+
+    // Frame timing shared with every registered system, ticked by ProjectKoi::run
+    FrameClock clock;
+
+    // Scratch memory valid until the end of the frame, reset by ProjectKoi::run
+    FrameArena frameArena;
+
+    // This frame's input, built by the InputSystem before any update runs
+    InputSnapshot input;
+
+    // Records or plays back the input and user messages, see --record and --replay
+    Replay replay;
+
+    // Worker threads shared by the update graphs and any system splitting up its own work.
+    // run() must be called from the main thread, outside of a running graph
+    JobSystem jobs;
+
+#ifdef KOI_MESSAGE_STATS
+    MessageStats messageStats;
+#endif
+
+    // Queued messages dropped in favour of a newer one of the same type, last drain only
+    uint32_t coalescedMessageCount = 0;
 
 	protected:
-    std::queue<Message *> msgQueue;
+    MessageQueue msgQueue;
     std::vector<System *> registeredSystems;
+    std::vector<MessageSubscriber> subscribers[MessageTypeCount];
 };
 
 class System
@@ -46,14 +165,54 @@ class System
 	System() {}
 	virtual ~System() {};
 
-	virtual void handleMessage(Message * msg);
-	void setMessageCallback(MessageType type, message_method_t methodName);
+	virtual void handleMessage(const MessageHeader * msg);
+
+	// Handlers take the payload by value, by const reference, or not at all
+	template <MessageType T, typename S>
+	void setMessageCallback(void (S::*method)(message_payload_t<T>))
+	{
+		static_assert(std::is_base_of<System, S>::value, "Message callbacks must be System methods");
+		typedef void (System::*typed_method_t)(message_payload_t<T>);
+		setMessageCallback(T, castMessageMethod<message_method_t>(static_cast<typed_method_t>(method)), &invokeMessageCallback<T, message_payload_t<T>>);
+	}
+
+	template <MessageType T, typename S>
+	void setMessageCallback(void (S::*method)(const message_payload_t<T> &))
+	{
+		static_assert(std::is_base_of<System, S>::value, "Message callbacks must be System methods");
+		typedef void (System::*typed_method_t)(const message_payload_t<T> &);
+		setMessageCallback(T, castMessageMethod<message_method_t>(static_cast<typed_method_t>(method)), &invokeMessageCallback<T, const message_payload_t<T> &>);
+	}
+
+	template <MessageType T, typename S>
+	void setMessageCallback(void (S::*method)())
+	{
+		static_assert(std::is_base_of<System, S>::value, "Message callbacks must be System methods");
+		setMessageCallback(T, static_cast<message_method_t>(method), &invokeEmptyMessageCallback);
+	}
+
+	void setMessageCallback(MessageType type, message_method_t method, message_invoker_t invoke);
+
+	// Declares what update() touches so it can be scheduled against the other systems
+	void setResourceAccess(uint32_t reads, uint32_t writes, bool mainThreadOnly = false);
+	bool conflictsWith(const System * other) const;
 
 	virtual void init() {}
-	virtual void update(long elapsedTime) = 0;
+
+	// Called zero or more times per frame with a constant step, before update.
+	// Simulation goes here, update() interpolates with app->clock.getAlpha()
+	virtual void fixedUpdate(double /*step*/) {}
+
+	// Called once per frame, elapsedTime is in milliseconds
+	virtual void update(double elapsedTime) = 0;
 
 	MessageBus * app = nullptr;
-	std::unordered_map<MessageType, message_method_t> messageActions;
+	std::unordered_map<MessageType, MessageSubscriber> messageActions;
+
+	// Systems that declare nothing are assumed to touch everything and never overlap
+	uint32_t reads = ResourceAll;
+	uint32_t writes = ResourceAll;
+	bool mainThreadOnly = false;
 };
 
 #endif
\ No newline at end of file
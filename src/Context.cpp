@@ -1,4 +1,7 @@
+#include <chrono>
+#include <cstdio>
 #include <cstring>
+#include <fstream>
 
 #include <render/Context.h>
 
@@ -57,6 +60,43 @@ void Context::destroyValidationDebugCallback()
     vkDestroyDebugUtilsMessengerEXT(this->instance, this->messanger, nullptr);
 }
 
+void Context::createPipelineCache()
+{
+    pipelineCache = createVkPipelineCache(physicalDevice, device, pipelineCacheFilename, &pipelineCacheWarm);
+}
+
+void Context::destroyPipelineCache()
+{
+    if (pipelineCache == VK_NULL_HANDLE)
+        return;
+
+    if (pipelineCount > 0)
+        INFO("CONTEXT - %u pipelines created in %.2f ms with a %s cache", pipelineCount, pipelineCreationTime, pipelineCacheWarm ? "warm" : "cold");
+
+    saveVkPipelineCache(physicalDevice, device, pipelineCache, pipelineCacheFilename);
+
+    vkDestroyPipelineCache(device, pipelineCache, nullptr);
+    pipelineCache = VK_NULL_HANDLE;
+}
+
+VkResult Context::createGraphicsPipeline(const VkGraphicsPipelineCreateInfo * pipelineInfo, VkPipeline * pipeline)
+{
+    PROFILE_ZONE("Create Pipeline");
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    VkResult result = vkCreateGraphicsPipelines(device, pipelineCache, 1, pipelineInfo, nullptr, pipeline);
+    double time = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+    {
+        std::lock_guard<std::mutex> lock(pipelineStatsMutex);
+        pipelineCreationTime += time;
+        pipelineCount++;
+    }
+
+    DEBUG("CONTEXT - Pipeline created in %.2f ms", time);
+    return result;
+}
+
 VKAPI_ATTR VkBool32 VKAPI_CALL Context::debugCallback(VkDebugUtilsMessageSeverityFlagBitsEXT messageSeverity, VkDebugUtilsMessageTypeFlagsEXT messageType, const VkDebugUtilsMessengerCallbackDataEXT* pCallbackData, void* pUserData)
 {
     if (VK_DEBUG_UTILS_MESSAGE_SEVERITY_VERBOSE_BIT_EXT)
@@ -453,4 +493,186 @@ VkDevice createVkDevice(VkPhysicalDevice physicalDevice, VkPhysicalDeviceFeature
 
     DEBUG("CONTEXT - VkDevice Created");
     return device;
-}
\ No newline at end of file
+}
+
+// ===============================================================================================================
+//                                         VkPipelineCache Helpers
+// ===============================================================================================================
+
+struct PipelineCacheFileHeader
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t vendorID;
+    uint32_t deviceID;
+    uint32_t driverVersion;
+    uint8_t pipelineCacheUUID[VK_UUID_SIZE];
+    uint64_t dataSize;
+};
+
+// The header every VkPipelineCache's data starts with (VK_PIPELINE_CACHE_HEADER_VERSION_ONE)
+struct VulkanPipelineCacheHeader
+{
+    uint32_t headerSize;
+    uint32_t headerVersion;
+    uint32_t vendorID;
+    uint32_t deviceID;
+    uint8_t pipelineCacheUUID[VK_UUID_SIZE];
+};
+
+static PipelineCacheFileHeader getPipelineCacheFileHeader(VkPhysicalDevice physicalDevice, uint64_t dataSize)
+{
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+
+    PipelineCacheFileHeader header = {};
+    header.magic = PIPELINE_CACHE_MAGIC;
+    header.version = PIPELINE_CACHE_VERSION;
+    header.vendorID = properties.vendorID;
+    header.deviceID = properties.deviceID;
+    header.driverVersion = properties.driverVersion;
+    memcpy(header.pipelineCacheUUID, properties.pipelineCacheUUID, VK_UUID_SIZE);
+    header.dataSize = dataSize;
+
+    return header;
+}
+
+static bool readPipelineCacheFile(VkPhysicalDevice physicalDevice, const std::string & filename, std::vector<char> & data)
+{
+    std::ifstream file(filename, std::ios::binary | std::ios::ate);
+    if (!file.is_open())
+        return false;
+
+    uint64_t fileSize = (uint64_t) file.tellg();
+    file.seekg(0);
+
+    PipelineCacheFileHeader header;
+    PipelineCacheFileHeader expected = getPipelineCacheFileHeader(physicalDevice, 0);
+
+    if (!file.read(reinterpret_cast<char *>(&header), sizeof(header)))
+    {
+        WARN("CONTEXT - Pipeline cache %s is truncated, starting cold", filename.c_str());
+        return false;
+    }
+
+    if (header.magic != expected.magic || header.version != expected.version)
+    {
+        WARN("CONTEXT - %s is not a pipeline cache, starting cold", filename.c_str());
+        return false;
+    }
+
+    if (header.vendorID != expected.vendorID || header.deviceID != expected.deviceID || header.driverVersion != expected.driverVersion ||
+        memcmp(header.pipelineCacheUUID, expected.pipelineCacheUUID, VK_UUID_SIZE) != 0)
+    {
+        INFO("CONTEXT - Pipeline cache was saved by another device or driver, starting cold");
+        return false;
+    }
+
+    if (header.dataSize != fileSize - sizeof(header))
+    {
+        WARN("CONTEXT - Pipeline cache %s has the wrong size, starting cold", filename.c_str());
+        return false;
+    }
+
+    data.resize(header.dataSize);
+    if (!file.read(data.data(), data.size()))
+    {
+        WARN("CONTEXT - Pipeline cache %s has the wrong size, starting cold", filename.c_str());
+        return false;
+    }
+
+    // The driver checks this too, but not every driver checks it carefully
+    VulkanPipelineCacheHeader vulkanHeader;
+    if (data.size() < sizeof(vulkanHeader))
+        return false;
+
+    memcpy(&vulkanHeader, data.data(), sizeof(vulkanHeader));
+
+    if (vulkanHeader.headerSize < sizeof(vulkanHeader) || vulkanHeader.headerVersion != VK_PIPELINE_CACHE_HEADER_VERSION_ONE ||
+        vulkanHeader.vendorID != expected.vendorID || vulkanHeader.deviceID != expected.deviceID ||
+        memcmp(vulkanHeader.pipelineCacheUUID, expected.pipelineCacheUUID, VK_UUID_SIZE) != 0)
+    {
+        WARN("CONTEXT - Pipeline cache data doesn't match the device, starting cold");
+        return false;
+    }
+
+    return true;
+}
+
+VkPipelineCache createVkPipelineCache(VkPhysicalDevice physicalDevice, VkDevice device, const std::string & filename, bool * warm)
+{
+    std::vector<char> data;
+    bool loaded = readPipelineCacheFile(physicalDevice, filename, data);
+
+    VkPipelineCacheCreateInfo createInfo = {};
+    createInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+    createInfo.pNext = nullptr;
+    createInfo.flags = 0;
+    createInfo.initialDataSize = loaded ? data.size() : 0;
+    createInfo.pInitialData = loaded ? data.data() : nullptr;
+
+    VkPipelineCache pipelineCache = VK_NULL_HANDLE;
+    int result = vkCreatePipelineCache(device, &createInfo, nullptr, &pipelineCache);
+
+    if (result != VK_SUCCESS && loaded)
+    {
+        WARN("CONTEXT - Driver rejected the pipeline cache %d, starting cold", result);
+
+        loaded = false;
+        createInfo.initialDataSize = 0;
+        createInfo.pInitialData = nullptr;
+        result = vkCreatePipelineCache(device, &createInfo, nullptr, &pipelineCache);
+    }
+
+    VALIDATE(result == VK_SUCCESS, "Failed to create VkPipelineCache %d", result);
+
+    if (warm != nullptr)
+        *warm = loaded;
+
+    DEBUG("CONTEXT - VkPipelineCache Created, %zu bytes loaded from %s", loaded ? data.size() : (size_t) 0, filename.c_str());
+    return pipelineCache;
+}
+
+bool saveVkPipelineCache(VkPhysicalDevice physicalDevice, VkDevice device, VkPipelineCache pipelineCache, const std::string & filename)
+{
+    size_t size = 0;
+    int result = vkGetPipelineCacheData(device, pipelineCache, &size, nullptr);
+    if (result != VK_SUCCESS || size == 0)
+        return false;
+
+    std::vector<char> data(size);
+    result = vkGetPipelineCacheData(device, pipelineCache, &size, data.data());
+    if (result != VK_SUCCESS)
+        return false;
+
+    PipelineCacheFileHeader header = getPipelineCacheFileHeader(physicalDevice, size);
+
+    // Written next to the old file and swapped in, a crash mid write leaves the old cache
+    std::string temporary = filename + ".tmp";
+    {
+        std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+        if (!file.is_open())
+        {
+            WARN("CONTEXT - Could not write pipeline cache %s", temporary.c_str());
+            return false;
+        }
+
+        file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+        file.write(data.data(), size);
+
+        if (!file.good())
+        {
+            WARN("CONTEXT - Could not write pipeline cache %s", temporary.c_str());
+            return false;
+        }
+    }
+
+    if (std::rename(temporary.c_str(), filename.c_str()) != 0)
+    {
+        WARN("CONTEXT - Could not replace pipeline cache %s", filename.c_str());
+        return false;
+    }
+
+    DEBUG("CONTEXT - Saved %zu bytes of pipeline cache to %s", size, filename.c_str());
+    return true;
+}
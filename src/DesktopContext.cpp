@@ -88,6 +88,15 @@ DesktopContext::DesktopContext()
         vkCreateCommandPool(device, &poolInfo, nullptr, &queue.commandPool);
     }
 
+    // ===== Setup DeviceAllocator =====
+    allocator.create(physicalDevice, device);
+
+    // ===== Setup UploadBatcher =====
+    uploads.create(this);
+
+    // ===== Setup VkPipelineCache =====
+    createPipelineCache();
+
     DEBUG("CONTEXT - Context Created");
 }
 
@@ -98,6 +107,10 @@ DesktopContext::~DesktopContext()
         vkDestroyCommandPool(device, queue.commandPool, nullptr);
     }
 
+    destroyPipelineCache();
+    uploads.destroy();
+    allocator.destroy();
+
     vkDestroyDevice(device, nullptr);
     vkDestroySurfaceKHR(instance, surface, nullptr);
     this->destroyValidationDebugCallback();
@@ -110,14 +123,17 @@ DesktopContext::~DesktopContext()
 
 void DesktopContext::init()
 {
-	app->sendMessageNow(GLFWwindowCreated, (void *) window);
+	// GLFW events may only be polled from the main thread
+	setResourceAccess(ResourceNone, ResourceWindow, true);
+
+	app->sendMessageNow<GLFWwindowCreated>(window);
 }
 
-void DesktopContext::update(long elapsedTime)
+void DesktopContext::update(double elapsedTime)
 {
-    glfwPollEvents();
+    // Events are polled by the InputSystem at the start of the frame
 	if (glfwWindowShouldClose(window))
 	{
-        app->sendMessage(Exit);
+        app->sendMessage<Exit>();
 	}
 }
\ No newline at end of file
@@ -15,29 +15,40 @@ VkPresentModeKHR choosePresentMode(std::vector<VkPresentModeKHR> & presentModes)
 
 void DesktopRenderer::init()
 {
-
+	setResourceAccess(ResourceNone, ResourceRenderer);
 }
 
-void DesktopRenderer::update(long elapsedTime)
+void DesktopRenderer::update(double elapsedTime)
 {
 
 }
 
 VkCommandBuffer DesktopRenderer::getNextCommandBuffer()
 {
-    vkAcquireNextImageKHR(context->device, swapchain, UINT64_MAX, imageAvailable, VK_NULL_HANDLE, &currentImageIndex);
+    FrameContext & frame = waitForFrame(context->device);
+
+    // Suboptimal still hands out an image and signals the semaphore, the swapchain is never recreated
+    VkResult acquireResult = vkAcquireNextImageKHR(context->device, swapchain, UINT64_MAX, frame.imageAvailable, VK_NULL_HANDLE, &currentImageIndex);
+    VALIDATE(acquireResult == VK_SUCCESS || acquireResult == VK_SUBOPTIMAL_KHR, "RENDERER - Failed to acquire swapchain image %d", acquireResult);
 
-	vkWaitForFences(context->device, 1, &fences[currentImageIndex], VK_TRUE, std::numeric_limits<uint64_t>::max());
-	vkResetFences(context->device, 1, &fences[currentImageIndex]);
+    // Images come back in any order, and there may be fewer than frames in flight. An
+    // older frame can still be rendering to this one
+    VkFence imageFence = imageFences[currentImageIndex];
+    if (imageFence != VK_NULL_HANDLE && imageFence != frame.fence)
+        vkWaitForFences(context->device, 1, &imageFence, VK_TRUE, std::numeric_limits<uint64_t>::max());
+
+    imageFences[currentImageIndex] = frame.fence;
 
     VkCommandBufferBeginInfo beginInfo = {};
     beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-    beginInfo.flags = 0;
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
     beginInfo.pInheritanceInfo = nullptr;
 
-    int result = vkBeginCommandBuffer(commandbuffers[currentImageIndex], &beginInfo);
+    int result = vkBeginCommandBuffer(frame.commandBuffer, &beginInfo);
     VALIDATE(result == VK_SUCCESS, "RENDERER - Failed to begin recording command buffer! %d", result);
 
+    profiler.beginFrame(frame.commandBuffer, currentFrame);
+
     VkImageMemoryBarrier barrier;
     barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
     barrier.pNext = nullptr;
@@ -54,11 +65,11 @@ VkCommandBuffer DesktopRenderer::getNextCommandBuffer()
     barrier.subresourceRange.baseArrayLayer = 0;
     barrier.subresourceRange.layerCount = 1;
 
-    vkCmdPipelineBarrier(commandbuffers[currentImageIndex], VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+    vkCmdPipelineBarrier(frame.commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
                          VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, 0, 0, nullptr, 0, nullptr,
                          1, &barrier);
 
-    return commandbuffers[currentImageIndex];
+    return frame.commandBuffer;
 }
 
 void DesktopRenderer::render(VkCommandBuffer commandbuffer)
@@ -79,25 +90,30 @@ void DesktopRenderer::render(VkCommandBuffer commandbuffer)
     barrier.subresourceRange.baseArrayLayer = 0;
     barrier.subresourceRange.layerCount = 1;
 
-    vkCmdPipelineBarrier(commandbuffers[currentImageIndex], VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+    vkCmdPipelineBarrier(commandbuffer, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
                          VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr, 0, nullptr,
                          1, &barrier);
 
+    profiler.endFrame(commandbuffer);
     vkEndCommandBuffer(commandbuffer);
 
+    FrameContext & frame = frames[currentFrame];
+
 	VkPipelineStageFlags waitStages[] = {VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT};
 
 	VkSubmitInfo submitInfo = {};
 	submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
 	submitInfo.waitSemaphoreCount = 1;
-	submitInfo.pWaitSemaphores = &imageAvailable;
+	submitInfo.pWaitSemaphores = &frame.imageAvailable;
 	submitInfo.pWaitDstStageMask = waitStages;
 	submitInfo.commandBufferCount = 1;
 	submitInfo.pCommandBuffers = &commandbuffer;
 	submitInfo.signalSemaphoreCount = 1;
-	submitInfo.pSignalSemaphores = &renderFinished;
+	submitInfo.pSignalSemaphores = &frame.renderFinished;
+
+	vkResetFences(context->device, 1, &frame.fence);
 
-	VkResult result = vkQueueSubmit(context->primaryGraphicsQueue->queue, 1, &submitInfo, fences[currentImageIndex]);
+	VkResult result = vkQueueSubmit(context->primaryGraphicsQueue->queue, 1, &submitInfo, frame.fence);
 	VALIDATE(result == VK_SUCCESS, "RENDERER - Failed to submit draw command buffer %d", result);
 }
 
@@ -109,7 +125,7 @@ void DesktopRenderer::present()
 	presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
 	presentInfo.pNext = nullptr;
 	presentInfo.waitSemaphoreCount = 1;
-	presentInfo.pWaitSemaphores = &renderFinished;
+	presentInfo.pWaitSemaphores = &frames[currentFrame].renderFinished;
 	presentInfo.swapchainCount = 1;
 	presentInfo.pSwapchains = &swapchain;
 	presentInfo.pImageIndices = &currentImageIndex;
@@ -117,13 +133,16 @@ void DesktopRenderer::present()
 
 	vkQueuePresentKHR(context->primaryPresentQueue->queue, &presentInfo);
 	VALIDATE(result == VK_SUCCESS, "RENDERER - Failed to present swapchain image %d", result);
+
+	advanceFrame();
 }
 
-DesktopRenderer::DesktopRenderer(DesktopContext * context)
+DesktopRenderer::DesktopRenderer(DesktopContext * context, uint32_t framesInFlight)
 {
     // ===== Initialization =====
 
     this->context = context;
+    this->framesInFlight = framesInFlight;
 
     VkSurfaceCapabilitiesKHR capabilities;
     std::vector<VkPresentModeKHR> presentModes;
@@ -182,7 +201,7 @@ DesktopRenderer::DesktopRenderer(DesktopContext * context)
     createVkImage(context, VK_IMAGE_TYPE_2D, colorFormat,
                     extent, 1, 1, sample_count, VK_IMAGE_TILING_OPTIMAL,
                     VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT | VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT,
-                    VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &colorImage, &colorImageMemory);
+                    VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &colorImage, &colorImageAllocation);
 
     transitionImageLayout(context->device, context->primaryGraphicsQueue->queue, context->primaryGraphicsQueue->commandPool, colorImage, colorFormat, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, 1);
 
@@ -195,65 +214,38 @@ DesktopRenderer::DesktopRenderer(DesktopContext * context)
     createVkImage(context, VK_IMAGE_TYPE_2D, depthFormat,
                     extent, 1, 1, sample_count, VK_IMAGE_TILING_OPTIMAL,
                     VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT,
-                    VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &depthImage, &depthImageMemory);
+                    VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &depthImage, &depthImageAllocation);
 
     transitionImageLayout(context->device, context->primaryGraphicsQueue->queue, context->primaryGraphicsQueue->commandPool, depthImage, depthFormat, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL, 1);
 
     createVkImageView(context->physicalDevice, context->device, depthImage, VK_IMAGE_VIEW_TYPE_2D,
                         depthFormat, 1, 1, VK_IMAGE_ASPECT_DEPTH_BIT, &depthImageView);
 
-    // ===== Queue Synchronization Objects =====
-
-	fences.resize(length);
-	for (int i = 0; i < length; i++)
-	{
-        VkFenceCreateInfo fenceInfo = {};
-        fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
-        fenceInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
-
-		vkCreateFence(context->device, &fenceInfo, nullptr, &fences[i]);
-	}
-
-	VkSemaphoreCreateInfo semaphoreInfo = {};
-	semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
-
-	vkCreateSemaphore(context->device, &semaphoreInfo, nullptr, &imageAvailable);
-	vkCreateSemaphore(context->device, &semaphoreInfo, nullptr, &renderFinished);
-
-    // ===== Command Buffers =====
-
-    commandbuffers.resize(this->length);
+    // ===== Frames In Flight =====
 
-    VkCommandBufferAllocateInfo commandbufferInfo = {};
-    commandbufferInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-    commandbufferInfo.pNext = nullptr;
-    commandbufferInfo.commandPool = context->primaryGraphicsQueue->commandPool;
-    commandbufferInfo.commandBufferCount = commandbuffers.size();
-    commandbufferInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    createFrameContexts(context->device, context->primaryGraphicsQueue->index);
+    imageFences.resize(length, VK_NULL_HANDLE);
 
-    vkAllocateCommandBuffers(context->device, &commandbufferInfo, commandbuffers.data());
+    profiler.create(context->physicalDevice, context->device, context->primaryGraphicsQueue->index, framesInFlight);
 
     DEBUG("RENDERER - Renderer Created");
 }
 
 DesktopRenderer::~DesktopRenderer()
 {
-	vkDestroySemaphore(context->device, imageAvailable, nullptr);
-	vkDestroySemaphore(context->device, renderFinished, nullptr);
+	profiler.destroy();
+	destroyFrameContexts(context->device);
 
 	for (int i = 0; i < length; i++)
 	{
-		vkDestroyFence(context->device, fences[i], nullptr);
 		vkDestroyImageView(context->device, imageviews[i], nullptr);
 	}
 
     vkDestroyImageView(context->device, colorImageView, nullptr);
-    vkDestroyImage(context->device, colorImage, nullptr);
-    vkFreeMemory(context->device, colorImageMemory, nullptr);
+    destroyVkImage(context, colorImage, colorImageAllocation);
 
     vkDestroyImageView(context->device, depthImageView, nullptr);
-    vkDestroyImage(context->device, depthImage, nullptr);
-    vkFreeMemory(context->device, depthImageMemory, nullptr);
+    destroyVkImage(context, depthImage, depthImageAllocation);
 
     vkDestroySwapchainKHR(context->device, swapchain, nullptr);
 
@@ -0,0 +1,595 @@
+#include <render/DeviceAllocator.h>
+
+#include <system/Log.h>
+
+#include <algorithm>
+
+// Two level segregated fit. Free ranges are listed by size class, the first level splits by
+// power of two and the second splits each of those into TLSF_SECOND_LEVEL_COUNT. A bitmap
+// per level finds the smallest non empty class that fits in two bit scans
+#define TLSF_SECOND_LEVEL_LOG2 4
+#define TLSF_SECOND_LEVEL_COUNT (1 << TLSF_SECOND_LEVEL_LOG2)
+#define TLSF_FIRST_LEVEL_COUNT 32
+#define TLSF_MIN_LEVEL 8
+#define TLSF_NONE (~0u)
+
+static_assert(DEVICE_ALLOCATOR_MIN_SIZE == (1 << TLSF_MIN_LEVEL), "TLSF_MIN_LEVEL must be log2 of DEVICE_ALLOCATOR_MIN_SIZE");
+
+struct TlsfNode
+{
+    VkDeviceSize offset;
+    VkDeviceSize size;
+
+    // Neighbours in the block's memory, and in the free list of the node's size class
+    uint32_t prevPhysical;
+    uint32_t nextPhysical;
+    uint32_t prevFree;
+    uint32_t nextFree;
+
+    bool free;
+};
+
+struct DeviceMemoryBlock
+{
+    VkDeviceMemory memory = VK_NULL_HANDLE;
+    VkDeviceSize size = 0;
+    uint8_t * mapped = nullptr;
+
+    uint32_t memoryType = 0;
+    DeviceMemoryPool pool = DevicePoolLinear;
+    bool dedicated = false;
+
+    VkDeviceSize used = 0;
+    uint32_t allocations = 0;
+
+    // DevicePoolLinear and DevicePoolOptimal
+    uint32_t firstLevelMap = 0;
+    uint32_t secondLevelMaps[TLSF_FIRST_LEVEL_COUNT] = {};
+    uint32_t freeHeads[TLSF_FIRST_LEVEL_COUNT][TLSF_SECOND_LEVEL_COUNT];
+
+    std::vector<TlsfNode> nodes;
+    std::vector<uint32_t> unusedNodes;
+
+    // DevicePoolTransient
+    VkDeviceSize head = 0;
+};
+
+static VkDeviceSize alignUp(VkDeviceSize value, VkDeviceSize alignment)
+{
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+// ===============================================================================================================
+//                                                  TLSF
+// ===============================================================================================================
+
+static void tlsfMapping(VkDeviceSize size, uint32_t * firstLevel, uint32_t * secondLevel)
+{
+    uint32_t msb = 63 - __builtin_clzll(size);
+
+    *firstLevel = msb - TLSF_MIN_LEVEL;
+    *secondLevel = (uint32_t) (size >> (msb - TLSF_SECOND_LEVEL_LOG2)) - TLSF_SECOND_LEVEL_COUNT;
+}
+
+static uint32_t tlsfNewNode(DeviceMemoryBlock * block)
+{
+    if (!block->unusedNodes.empty())
+    {
+        uint32_t index = block->unusedNodes.back();
+        block->unusedNodes.pop_back();
+        return index;
+    }
+
+    block->nodes.emplace_back();
+    return (uint32_t) block->nodes.size() - 1;
+}
+
+static void tlsfInsertFree(DeviceMemoryBlock * block, uint32_t index)
+{
+    TlsfNode & node = block->nodes[index];
+
+    uint32_t firstLevel, secondLevel;
+    tlsfMapping(node.size, &firstLevel, &secondLevel);
+
+    uint32_t & head = block->freeHeads[firstLevel][secondLevel];
+
+    node.free = true;
+    node.prevFree = TLSF_NONE;
+    node.nextFree = head;
+
+    if (head != TLSF_NONE)
+        block->nodes[head].prevFree = index;
+
+    head = index;
+
+    block->firstLevelMap |= 1u << firstLevel;
+    block->secondLevelMaps[firstLevel] |= 1u << secondLevel;
+}
+
+static void tlsfRemoveFree(DeviceMemoryBlock * block, uint32_t index)
+{
+    TlsfNode & node = block->nodes[index];
+
+    uint32_t firstLevel, secondLevel;
+    tlsfMapping(node.size, &firstLevel, &secondLevel);
+
+    if (node.prevFree != TLSF_NONE)
+        block->nodes[node.prevFree].nextFree = node.nextFree;
+    else
+        block->freeHeads[firstLevel][secondLevel] = node.nextFree;
+
+    if (node.nextFree != TLSF_NONE)
+        block->nodes[node.nextFree].prevFree = node.prevFree;
+
+    if (block->freeHeads[firstLevel][secondLevel] == TLSF_NONE)
+    {
+        block->secondLevelMaps[firstLevel] &= ~(1u << secondLevel);
+
+        if (block->secondLevelMaps[firstLevel] == 0)
+            block->firstLevelMap &= ~(1u << firstLevel);
+    }
+
+    node.free = false;
+}
+
+static void tlsfInit(DeviceMemoryBlock * block)
+{
+    for (auto & heads : block->freeHeads)
+        std::fill(std::begin(heads), std::end(heads), TLSF_NONE);
+
+    uint32_t index = tlsfNewNode(block);
+    block->nodes[index] = {0, block->size, TLSF_NONE, TLSF_NONE, TLSF_NONE, TLSF_NONE, false};
+
+    tlsfInsertFree(block, index);
+}
+
+// Splits a free node's tail of size bytes off into a new free node
+static void tlsfSplit(DeviceMemoryBlock * block, uint32_t index, VkDeviceSize size)
+{
+    uint32_t tail = tlsfNewNode(block);
+
+    TlsfNode & node = block->nodes[index];
+    TlsfNode & tailNode = block->nodes[tail];
+
+    node.size -= size;
+    tailNode = {node.offset + node.size, size, index, node.nextPhysical, TLSF_NONE, TLSF_NONE, false};
+
+    if (node.nextPhysical != TLSF_NONE)
+        block->nodes[node.nextPhysical].prevPhysical = tail;
+
+    node.nextPhysical = tail;
+
+    tlsfInsertFree(block, tail);
+}
+
+static uint32_t tlsfAllocate(DeviceMemoryBlock * block, VkDeviceSize size, VkDeviceSize alignment)
+{
+    // Offsets are multiples of DEVICE_ALLOCATOR_MIN_SIZE, so aligning wastes at most this much
+    VkDeviceSize request = size + alignment - DEVICE_ALLOCATOR_MIN_SIZE;
+
+    // Round up to the next class, every node listed there or above is large enough
+    uint32_t msb = 63 - __builtin_clzll(request);
+    request += (1ull << (msb - TLSF_SECOND_LEVEL_LOG2)) - 1;
+
+    uint32_t firstLevel, secondLevel;
+    tlsfMapping(request, &firstLevel, &secondLevel);
+
+    if (firstLevel >= TLSF_FIRST_LEVEL_COUNT)
+        return TLSF_NONE;
+
+    uint32_t secondLevelMap = block->secondLevelMaps[firstLevel] & (~0u << secondLevel);
+
+    if (secondLevelMap == 0)
+    {
+        uint32_t firstLevelMap = (firstLevel + 1 < 32) ? block->firstLevelMap & (~0u << (firstLevel + 1)) : 0;
+
+        if (firstLevelMap == 0)
+            return TLSF_NONE;
+
+        firstLevel = __builtin_ctz(firstLevelMap);
+        secondLevelMap = block->secondLevelMaps[firstLevel];
+    }
+
+    secondLevel = __builtin_ctz(secondLevelMap);
+
+    uint32_t index = block->freeHeads[firstLevel][secondLevel];
+    tlsfRemoveFree(block, index);
+
+    // Padding in front becomes a free node of its own, the node moves up to the aligned offset
+    VkDeviceSize padding = alignUp(block->nodes[index].offset, alignment) - block->nodes[index].offset;
+
+    if (padding > 0)
+    {
+        VkDeviceSize remaining = block->nodes[index].size - padding;
+
+        tlsfSplit(block, index, remaining);
+
+        uint32_t front = index;
+        index = block->nodes[front].nextPhysical;
+
+        tlsfRemoveFree(block, index);
+        tlsfInsertFree(block, front);
+    }
+
+    if (block->nodes[index].size > size)
+        tlsfSplit(block, index, block->nodes[index].size - size);
+
+    return index;
+}
+
+static void tlsfFree(DeviceMemoryBlock * block, uint32_t index)
+{
+    uint32_t prev = block->nodes[index].prevPhysical;
+    uint32_t next = block->nodes[index].nextPhysical;
+
+    if (next != TLSF_NONE && block->nodes[next].free)
+    {
+        tlsfRemoveFree(block, next);
+
+        block->nodes[index].size += block->nodes[next].size;
+        block->nodes[index].nextPhysical = block->nodes[next].nextPhysical;
+
+        if (block->nodes[next].nextPhysical != TLSF_NONE)
+            block->nodes[block->nodes[next].nextPhysical].prevPhysical = index;
+
+        block->unusedNodes.push_back(next);
+    }
+
+    if (prev != TLSF_NONE && block->nodes[prev].free)
+    {
+        tlsfRemoveFree(block, prev);
+
+        block->nodes[prev].size += block->nodes[index].size;
+        block->nodes[prev].nextPhysical = block->nodes[index].nextPhysical;
+
+        if (block->nodes[index].nextPhysical != TLSF_NONE)
+            block->nodes[block->nodes[index].nextPhysical].prevPhysical = prev;
+
+        block->unusedNodes.push_back(index);
+        index = prev;
+    }
+
+    tlsfInsertFree(block, index);
+}
+
+// ===============================================================================================================
+//                                            Device Allocator
+// ===============================================================================================================
+
+void DeviceAllocator::create(VkPhysicalDevice physicalDevice, VkDevice device)
+{
+    this->device = device;
+
+    vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memoryProperties);
+
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+
+    bufferImageGranularity = properties.limits.bufferImageGranularity;
+    maxMemoryObjects = properties.limits.maxMemoryAllocationCount;
+
+    DEBUG("DEVICE_ALLOCATOR - Device Allocator Created, %u memory types, %u heaps, buffer image granularity %llu",
+          memoryProperties.memoryTypeCount, memoryProperties.memoryHeapCount, (unsigned long long) bufferImageGranularity);
+}
+
+void DeviceAllocator::destroy()
+{
+    if (device == VK_NULL_HANDLE)
+        return;
+
+    for (uint32_t i = 0; i < getHeapCount(); i++)
+    {
+        DeviceHeapStats stats = getHeapStats(i);
+
+        if (stats.allocations > 0)
+            WARN("DEVICE_ALLOCATOR - Heap %u still has %u allocations, %llu bytes", i, stats.allocations, (unsigned long long) stats.usedBytes);
+    }
+
+    INFO("DEVICE_ALLOCATOR - At most %u VkDeviceMemory objects were alive, the device allows %u", peakMemoryObjects, maxMemoryObjects);
+
+    for (auto & pools : blocks)
+    {
+        for (auto & pool : pools)
+        {
+            for (auto block : pool)
+                destroyBlock(block);
+
+            pool.clear();
+        }
+    }
+
+    for (auto block : dedicated)
+        destroyBlock(block);
+
+    dedicated.clear();
+
+    device = VK_NULL_HANDLE;
+}
+
+uint32_t DeviceAllocator::findMemoryType(uint32_t typeBits, VkMemoryPropertyFlags properties) const
+{
+    uint32_t best = UINT32_MAX;
+    uint32_t bestExtraFlags = UINT32_MAX;
+
+    // Flags beyond the ones asked for tend to mean scarcer memory, e.g. device local and host
+    // visible is often a small window of VRAM
+    for (uint32_t i = 0; i < memoryProperties.memoryTypeCount; i++)
+    {
+        VkMemoryPropertyFlags flags = memoryProperties.memoryTypes[i].propertyFlags;
+
+        if (!(typeBits & (1u << i)) || (flags & properties) != properties)
+            continue;
+
+        uint32_t extraFlags = __builtin_popcount(flags & ~properties);
+
+        if (extraFlags < bestExtraFlags)
+        {
+            best = i;
+            bestExtraFlags = extraFlags;
+        }
+    }
+
+    return best;
+}
+
+DeviceMemoryBlock * DeviceAllocator::createBlock(uint32_t memoryType, DeviceMemoryPool pool, VkDeviceSize size, bool isDedicated)
+{
+    VkMemoryAllocateInfo allocInfo = {};
+    allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    allocInfo.pNext = nullptr;
+    allocInfo.allocationSize = size;
+    allocInfo.memoryTypeIndex = memoryType;
+
+    VkDeviceMemory memory;
+    VkResult result = vkAllocateMemory(device, &allocInfo, nullptr, &memory);
+
+    if (result != VK_SUCCESS)
+    {
+        WARN("DEVICE_ALLOCATOR - Failed to allocate %llu bytes of memory type %u %d", (unsigned long long) size, memoryType, result);
+        return nullptr;
+    }
+
+    DeviceMemoryBlock * block = new DeviceMemoryBlock();
+    block->memory = memory;
+    block->size = size;
+    block->memoryType = memoryType;
+    block->pool = pool;
+    block->dedicated = isDedicated;
+
+    if (memoryProperties.memoryTypes[memoryType].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT)
+    {
+        void * mapped;
+        vkMapMemory(device, memory, 0, VK_WHOLE_SIZE, 0, &mapped);
+        block->mapped = (uint8_t *) mapped;
+    }
+
+    if (pool != DevicePoolTransient && !isDedicated)
+        tlsfInit(block);
+
+    memoryObjects++;
+    peakMemoryObjects = std::max(peakMemoryObjects, memoryObjects);
+
+    if (memoryObjects == maxMemoryObjects)
+        WARN("DEVICE_ALLOCATOR - Reached maxMemoryAllocationCount, %u VkDeviceMemory objects", memoryObjects);
+
+    return block;
+}
+
+void DeviceAllocator::destroyBlock(DeviceMemoryBlock * block)
+{
+    if (block->mapped != nullptr)
+        vkUnmapMemory(device, block->memory);
+
+    vkFreeMemory(device, block->memory, nullptr);
+
+    memoryObjects--;
+
+    delete block;
+}
+
+VkResult DeviceAllocator::allocate(const VkMemoryRequirements & requirements, VkMemoryPropertyFlags properties, DeviceResourceKind kind, bool transient, DeviceAllocation * allocation)
+{
+    uint32_t memoryType = findMemoryType(requirements.memoryTypeBits, properties);
+
+    if (memoryType == UINT32_MAX)
+    {
+        WARN("DEVICE_ALLOCATOR - No memory type with properties 0x%x", properties);
+        return VK_ERROR_OUT_OF_DEVICE_MEMORY;
+    }
+
+    VkDeviceSize size = alignUp(std::max(requirements.size, (VkDeviceSize) 1), DEVICE_ALLOCATOR_MIN_SIZE);
+    VkDeviceSize alignment = alignUp(std::max(requirements.alignment, (VkDeviceSize) 1), DEVICE_ALLOCATOR_MIN_SIZE);
+
+    VkDeviceSize heapSize = memoryProperties.memoryHeaps[memoryProperties.memoryTypes[memoryType].heapIndex].size;
+    VkDeviceSize blockSize = transient ? DEVICE_ALLOCATOR_TRANSIENT_BLOCK_SIZE : DEVICE_ALLOCATOR_BLOCK_SIZE;
+    blockSize = std::max(std::min(blockSize, heapSize / 8) / DEVICE_ALLOCATOR_MIN_SIZE * DEVICE_ALLOCATOR_MIN_SIZE, (VkDeviceSize) DEVICE_ALLOCATOR_MIN_SIZE);
+
+    DeviceMemoryPool pool = DevicePoolLinear;
+    if (transient)
+        pool = DevicePoolTransient;
+    else if (kind == DeviceResourceOptimal && bufferImageGranularity > DEVICE_ALLOCATOR_MIN_SIZE)
+        pool = DevicePoolOptimal;
+
+    std::lock_guard<std::mutex> lock(mutex);
+
+    std::vector<DeviceMemoryBlock *> & poolBlocks = blocks[memoryType][pool];
+
+    DeviceMemoryBlock * block = nullptr;
+    VkDeviceSize offset = 0;
+    uint32_t node = 0;
+
+    if (!transient && size > blockSize / 2)
+    {
+        block = createBlock(memoryType, pool, size, true);
+
+        if (block == nullptr)
+            return VK_ERROR_OUT_OF_DEVICE_MEMORY;
+
+        dedicated.push_back(block);
+    }
+    else if (transient)
+    {
+        for (auto candidate : poolBlocks)
+        {
+            offset = alignUp(candidate->head, alignment);
+
+            if (offset + size <= candidate->size)
+            {
+                block = candidate;
+                break;
+            }
+        }
+
+        if (block == nullptr)
+        {
+            block = createBlock(memoryType, pool, std::max(blockSize, size), false);
+
+            if (block == nullptr)
+                return VK_ERROR_OUT_OF_DEVICE_MEMORY;
+
+            poolBlocks.push_back(block);
+            offset = 0;
+        }
+
+        block->head = offset + size;
+    }
+    else
+    {
+        node = TLSF_NONE;
+
+        for (auto candidate : poolBlocks)
+        {
+            node = tlsfAllocate(candidate, size, alignment);
+
+            if (node != TLSF_NONE)
+            {
+                block = candidate;
+                break;
+            }
+        }
+
+        if (block == nullptr)
+        {
+            block = createBlock(memoryType, pool, blockSize, false);
+
+            if (block == nullptr)
+                return VK_ERROR_OUT_OF_DEVICE_MEMORY;
+
+            poolBlocks.push_back(block);
+            node = tlsfAllocate(block, size, alignment);
+        }
+
+        offset = block->nodes[node].offset;
+    }
+
+    block->used += size;
+    block->allocations++;
+
+    allocation->memory = block->memory;
+    allocation->offset = offset;
+    allocation->size = size;
+    allocation->mapped = (block->mapped != nullptr) ? block->mapped + offset : nullptr;
+    allocation->block = block;
+    allocation->node = node;
+
+    return VK_SUCCESS;
+}
+
+void DeviceAllocator::free(DeviceAllocation & allocation)
+{
+    DeviceMemoryBlock * block = allocation.block;
+
+    if (block == nullptr)
+        return;
+
+    std::lock_guard<std::mutex> lock(mutex);
+
+    block->used -= allocation.size;
+    block->allocations--;
+
+    if (block->dedicated)
+    {
+        dedicated.erase(std::find(dedicated.begin(), dedicated.end(), block));
+        destroyBlock(block);
+    }
+    else
+    {
+        if (block->pool == DevicePoolTransient)
+        {
+            if (block->allocations == 0)
+                block->head = 0;
+        }
+        else
+        {
+            tlsfFree(block, allocation.node);
+        }
+
+        // An empty block is kept when it's the pool's only one, so a pool that empties and
+        // fills again doesn't allocate from the device every time
+        std::vector<DeviceMemoryBlock *> & poolBlocks = blocks[block->memoryType][block->pool];
+
+        if (block->allocations == 0 && poolBlocks.size() > 1)
+        {
+            poolBlocks.erase(std::find(poolBlocks.begin(), poolBlocks.end(), block));
+            destroyBlock(block);
+        }
+    }
+
+    allocation = DeviceAllocation();
+}
+
+DeviceHeapStats DeviceAllocator::getHeapStats(uint32_t heap)
+{
+    DeviceHeapStats stats;
+    stats.heapSize = memoryProperties.memoryHeaps[heap].size;
+
+    std::lock_guard<std::mutex> lock(mutex);
+
+    auto addBlock = [&](const DeviceMemoryBlock * block)
+    {
+        stats.allocatedBytes += block->size;
+        stats.usedBytes += block->used;
+        stats.memoryObjects++;
+        stats.allocations += block->allocations;
+
+        if (block->dedicated)
+            return;
+
+        // Transient space behind the head is lost until the block rewinds
+        if (block->pool == DevicePoolTransient)
+        {
+            stats.fragmentedBytes += block->head - block->used;
+            return;
+        }
+
+        VkDeviceSize freeBytes = 0;
+        VkDeviceSize largest = 0;
+
+        for (uint32_t i = 0; i != TLSF_NONE; i = block->nodes[i].nextPhysical)
+        {
+            if (!block->nodes[i].free)
+                continue;
+
+            freeBytes += block->nodes[i].size;
+            largest = std::max(largest, block->nodes[i].size);
+        }
+
+        stats.fragmentedBytes += freeBytes - largest;
+    };
+
+    for (uint32_t type = 0; type < memoryProperties.memoryTypeCount; type++)
+    {
+        if (memoryProperties.memoryTypes[type].heapIndex != heap)
+            continue;
+
+        for (auto & pool : blocks[type])
+            for (auto block : pool)
+                addBlock(block);
+    }
+
+    for (auto block : dedicated)
+        if (memoryProperties.memoryTypes[block->memoryType].heapIndex == heap)
+            addBlock(block);
+
+    return stats;
+}
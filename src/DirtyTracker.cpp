@@ -0,0 +1,65 @@
+#include <system/DirtyTracker.h>
+
+static const char * uploadTypeNames[] =
+{
+	"Camera",
+	"Lighting",
+	"Instances"
+};
+
+static_assert(sizeof(uploadTypeNames) / sizeof(uploadTypeNames[0]) == UploadTypeCount, "uploadTypeNames is out of sync with UploadType");
+
+// ===============================================================================================================
+//                                              Upload Stats
+// ===============================================================================================================
+
+std::atomic<uint32_t> UploadStats::uploaded[UploadTypeCount];
+std::atomic<uint32_t> UploadStats::skipped[UploadTypeCount];
+UploadCounters UploadStats::lastFrame[UploadTypeCount];
+
+void UploadStats::record(UploadType type, bool uploaded)
+{
+	if (uploaded)
+		UploadStats::uploaded[type].fetch_add(1, std::memory_order_relaxed);
+	else
+		UploadStats::skipped[type].fetch_add(1, std::memory_order_relaxed);
+}
+
+void UploadStats::endFrame()
+{
+	for (uint32_t i = 0; i < UploadTypeCount; i++)
+	{
+		lastFrame[i].uploaded = uploaded[i].exchange(0, std::memory_order_relaxed);
+		lastFrame[i].skipped = skipped[i].exchange(0, std::memory_order_relaxed);
+	}
+}
+
+const char * UploadStats::getTypeName(UploadType type)
+{
+	return (type < UploadTypeCount) ? uploadTypeNames[type] : "Unknown";
+}
+
+// ===============================================================================================================
+//                                              Dirty Tracker
+// ===============================================================================================================
+
+DirtyTracker::DirtyTracker(UploadType type, uint32_t copies)
+{
+	this->type = type;
+	resize(copies);
+}
+
+void DirtyTracker::resize(uint32_t copies)
+{
+	uploaded.assign(copies, DIRTY_TRACKER_NEVER_UPLOADED);
+}
+
+bool DirtyTracker::needsUpload(uint32_t copy)
+{
+	bool stale = uploaded[copy] != version;
+
+	uploaded[copy] = version;
+	UploadStats::record(type, stale);
+
+	return stale;
+}
\ No newline at end of file
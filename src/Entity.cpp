@@ -0,0 +1,59 @@
+#include <system/Entity.h>
+
+std::atomic<uint32_t> EntityRegistry::nextComponentType(0);
+
+EntityRegistry::EntityRegistry()
+{
+
+}
+
+EntityRegistry::~EntityRegistry()
+{
+
+}
+
+Entity EntityRegistry::create()
+{
+	uint32_t index;
+
+	if (!freeIndices.empty())
+	{
+		index = freeIndices.back();
+		freeIndices.pop_back();
+	}
+	else
+	{
+		index = (uint32_t) generations.size();
+		VALIDATE(index < ENTITY_INDEX_MASK, "ENTITY - Out of entity indices");
+		generations.push_back(0);
+	}
+
+	aliveCount++;
+
+	return (generations[index] << ENTITY_INDEX_BITS) | index;
+}
+
+void EntityRegistry::destroy(Entity entity)
+{
+	if (!isAlive(entity))
+	{
+		WARN("ENTITY - Destroying dead entity %u", entity);
+		return;
+	}
+
+	for (auto& pool : pools)
+		if (pool != nullptr)
+			pool->remove(entity);
+
+	uint32_t index = getEntityIndex(entity);
+	generations[index] = (generations[index] + 1) & (0xFFFFFFFF >> ENTITY_INDEX_BITS);
+	freeIndices.push_back(index);
+
+	aliveCount--;
+}
+
+bool EntityRegistry::isAlive(Entity entity) const
+{
+	uint32_t index = getEntityIndex(entity);
+	return entity != NULL_ENTITY && index < generations.size() && generations[index] == getEntityGeneration(entity);
+}
\ No newline at end of file
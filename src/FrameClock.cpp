@@ -0,0 +1,94 @@
+#include <system/FrameClock.h>
+#include <system/Log.h>
+
+typedef std::chrono::duration<double, std::milli> milliseconds_t;
+
+FrameClock::FrameClock()
+{
+	lastTick = frame_clock_t::now();
+	inputTime = lastTick;
+}
+
+double FrameClock::tick()
+{
+	frame_clock_t::time_point now = frame_clock_t::now();
+	double elapsed = milliseconds_t(now - lastTick).count();
+
+	return tick(elapsed);
+}
+
+double FrameClock::tick(double elapsed)
+{
+	this->elapsed = elapsed;
+	lastTick = frame_clock_t::now();
+	frameCount++;
+
+	// After a stall (breakpoint, window drag, model load) drop the backlog instead of
+	// running hundreds of fixed steps to catch up
+	accumulator += elapsed;
+	if (accumulator > FRAME_CLOCK_MAX_ACCUMULATED)
+		accumulator = FRAME_CLOCK_MAX_ACCUMULATED;
+
+	return elapsed;
+}
+
+bool FrameClock::stepFixed()
+{
+	if (accumulator < fixedStep)
+		return false;
+
+	accumulator -= fixedStep;
+	return true;
+}
+
+void FrameClock::setFixedStep(double milliseconds)
+{
+	VALIDATE(milliseconds > 0.0, "FRAME_CLOCK - Fixed step must be positive %f", milliseconds);
+
+	fixedStep = milliseconds;
+	accumulator = 0.0;
+}
+
+void FrameClock::setFrameLimit(double framesPerSecond)
+{
+	frameLimit = (framesPerSecond > 0.0) ? framesPerSecond : 0.0;
+}
+
+void FrameClock::waitForNextFrame()
+{
+	if (frameLimit <= 0.0)
+		return;
+
+	waitForFrameTime(1000.0 / frameLimit);
+}
+
+void FrameClock::waitForFrameTime(double milliseconds)
+{
+	frame_clock_t::time_point target = lastTick + std::chrono::duration_cast<frame_clock_t::duration>(milliseconds_t(milliseconds));
+	double remaining = milliseconds_t(target - frame_clock_t::now()).count();
+
+	if (remaining > FRAME_CLOCK_SPIN_THRESHOLD)
+		std::this_thread::sleep_for(milliseconds_t(remaining - FRAME_CLOCK_SPIN_THRESHOLD));
+
+	while (frame_clock_t::now() < target)
+		std::this_thread::yield();
+}
+
+void FrameClock::markInput()
+{
+	if (inputPending)
+		return;
+
+	inputTime = frame_clock_t::now();
+	inputPending = true;
+}
+
+void FrameClock::markPresent()
+{
+	if (!inputPending)
+		return;
+
+	latency = milliseconds_t(frame_clock_t::now() - inputTime).count();
+	averageLatency = (averageLatency == 0.0) ? latency : averageLatency * 0.9 + latency * 0.1;
+	inputPending = false;
+}
\ No newline at end of file
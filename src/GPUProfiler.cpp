@@ -0,0 +1,219 @@
+#include <render/GPUProfiler.h>
+
+#include <system/Log.h>
+
+// ===============================================================================================================
+//                                              Scope Stats
+// ===============================================================================================================
+
+void GPUScopeStats::add(double milliseconds)
+{
+    if (historyCount == GPU_PROFILER_HISTORY)
+        historyTotal -= history[historyPosition];
+    else
+        historyCount++;
+
+    history[historyPosition] = (float) milliseconds;
+    historyPosition = (historyPosition + 1) % GPU_PROFILER_HISTORY;
+    historyTotal += milliseconds;
+
+    last = milliseconds;
+    average = historyTotal / historyCount;
+}
+
+// ===============================================================================================================
+//                                              GPU Profiler
+// ===============================================================================================================
+
+void GPUProfiler::create(VkPhysicalDevice physicalDevice, VkDevice device, uint32_t queueFamilyIndex, uint32_t framesInFlight)
+{
+    this->device = device;
+
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+
+    std::vector<VkQueueFamilyProperties> queueProperties;
+    getQueueFamilyProperties(physicalDevice, queueProperties);
+
+    uint32_t validBits = queueProperties[queueFamilyIndex].timestampValidBits;
+
+    if (validBits == 0 || properties.limits.timestampPeriod <= 0.0f)
+    {
+        WARN("GPU_PROFILER - Graphics queue has no timestamps, GPU timings unavailable");
+        return;
+    }
+
+    VkQueryPoolCreateInfo queryInfo = {};
+    queryInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+    queryInfo.pNext = nullptr;
+    queryInfo.flags = 0;
+    queryInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+    queryInfo.queryCount = framesInFlight * GPU_PROFILER_MAX_SCOPES * 2;
+
+    int result = vkCreateQueryPool(device, &queryInfo, nullptr, &queryPool);
+    if (result != VK_SUCCESS)
+    {
+        WARN("GPU_PROFILER - Failed to create VkQueryPool %d, GPU timings unavailable", result);
+        queryPool = VK_NULL_HANDLE;
+        return;
+    }
+
+    nanosecondsPerTick = properties.limits.timestampPeriod;
+    timestampMask = (validBits >= 64) ? ~0ull : (1ull << validBits) - 1;
+
+    frames.resize(framesInFlight);
+    for (uint32_t i = 0; i < framesInFlight; i++)
+    {
+        frames[i].scopes.reserve(GPU_PROFILER_MAX_SCOPES);
+        frames[i].firstQuery = i * GPU_PROFILER_MAX_SCOPES * 2;
+    }
+
+    // A value and an availability word per query
+    results.resize(GPU_PROFILER_MAX_SCOPES * 2 * 2);
+
+    DEBUG("GPU_PROFILER - GPU Profiler Created, %u scopes per frame", GPU_PROFILER_MAX_SCOPES);
+}
+
+void GPUProfiler::destroy()
+{
+    stopCSV();
+
+    if (queryPool != VK_NULL_HANDLE)
+        vkDestroyQueryPool(device, queryPool, nullptr);
+
+    queryPool = VK_NULL_HANDLE;
+    frames.clear();
+}
+
+void GPUProfiler::beginFrame(VkCommandBuffer commandbuffer, uint32_t frame)
+{
+    if (queryPool == VK_NULL_HANDLE)
+        return;
+
+    recording = &frames[frame];
+
+    collect(*recording);
+
+    recording->scopes.clear();
+    recording->queryCount = 0;
+    recording->frameNumber = frameNumber++;
+
+    vkCmdResetQueryPool(commandbuffer, queryPool, recording->firstQuery, GPU_PROFILER_MAX_SCOPES * 2);
+
+    frameScope = beginScope(commandbuffer, "Frame");
+}
+
+void GPUProfiler::endFrame(VkCommandBuffer commandbuffer)
+{
+    if (recording == nullptr)
+        return;
+
+    endScope(commandbuffer, frameScope);
+
+    frameScope = GPU_PROFILER_NO_SCOPE;
+    recording = nullptr;
+}
+
+uint32_t GPUProfiler::beginScope(VkCommandBuffer commandbuffer, const char * name)
+{
+    if (recording == nullptr || recording->queryCount + 2 > GPU_PROFILER_MAX_SCOPES * 2)
+        return GPU_PROFILER_NO_SCOPE;
+
+    uint32_t query = recording->queryCount;
+    recording->queryCount += 2;
+    recording->scopes.push_back({findScope(name), query});
+
+    vkCmdWriteTimestamp(commandbuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, queryPool, recording->firstQuery + query);
+
+    return (uint32_t) recording->scopes.size() - 1;
+}
+
+void GPUProfiler::endScope(VkCommandBuffer commandbuffer, uint32_t scope)
+{
+    if (recording == nullptr || scope >= recording->scopes.size())
+        return;
+
+    vkCmdWriteTimestamp(commandbuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, queryPool, recording->firstQuery + recording->scopes[scope].query + 1);
+}
+
+void GPUProfiler::collect(FrameQueries & queries)
+{
+    if (queries.queryCount == 0)
+        return;
+
+    // The frame's fence has been waited on, so this never blocks. Scopes left open have
+    // no end timestamp and are skipped
+    VkResult result = vkGetQueryPoolResults(device, queryPool, queries.firstQuery, queries.queryCount,
+                                            queries.queryCount * 2 * sizeof(uint64_t), results.data(), 2 * sizeof(uint64_t),
+                                            VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT);
+
+    if (result != VK_SUCCESS && result != VK_NOT_READY)
+        return;
+
+    // Scopes opened more than once a frame are summed
+    totals.assign(scopes.size(), -1.0);
+
+    for (auto & pending : queries.scopes)
+    {
+        const uint64_t * begin = &results[pending.query * 2];
+        const uint64_t * end = &results[(pending.query + 1) * 2];
+
+        if (begin[1] == 0 || end[1] == 0)
+            continue;
+
+        double milliseconds = ((end[0] - begin[0]) & timestampMask) * nanosecondsPerTick / 1000000.0;
+        totals[pending.stats] = (totals[pending.stats] < 0.0) ? milliseconds : totals[pending.stats] + milliseconds;
+    }
+
+    for (uint32_t i = 0; i < totals.size(); i++)
+    {
+        if (totals[i] < 0.0)
+            continue;
+
+        scopes[i].add(totals[i]);
+
+        if (csv != nullptr)
+            fprintf(csv, "%llu,%s,%.4f\n", (unsigned long long) queries.frameNumber, scopes[i].name.c_str(), totals[i]);
+    }
+
+    collectedFrames++;
+    queries.queryCount = 0;
+}
+
+uint32_t GPUProfiler::findScope(const char * name)
+{
+    for (uint32_t i = 0; i < scopes.size(); i++)
+        if (scopes[i].name == name)
+            return i;
+
+    scopes.emplace_back();
+    scopes.back().name = name;
+
+    return (uint32_t) scopes.size() - 1;
+}
+
+bool GPUProfiler::startCSV(const std::string & filename)
+{
+    stopCSV();
+
+    csv = fopen(filename.c_str(), "w");
+    if (csv == nullptr)
+    {
+        WARN("GPU_PROFILER - Could not open %s", filename.c_str());
+        return false;
+    }
+
+    fprintf(csv, "frame,scope,gpu_ms\n");
+
+    INFO("GPU_PROFILER - Writing GPU timings to %s", filename.c_str());
+    return true;
+}
+
+void GPUProfiler::stopCSV()
+{
+    if (csv == nullptr)
+        return;
+
+    fclose(csv);
+    csv = nullptr;
+}
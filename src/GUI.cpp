@@ -1,5 +1,8 @@
 #include <render/GUI.h>
 #include <render/Utilities.h>
+#include <render/RenderQueue.h>
+
+#include <algorithm>
 
 GUIElement::GUIElement()
 {
@@ -11,9 +14,9 @@ GUIElement::~GUIElement()
 
 }
 
-FPSMeter::FPSMeter()
+FPSMeter::FPSMeter(Renderer * renderer)
 {
-
+    this->renderer = renderer;
 }
 
 FPSMeter::~FPSMeter()
@@ -23,20 +26,32 @@ FPSMeter::~FPSMeter()
 
 void FPSMeter::init()
 {
+    setResourceAccess(ResourceNone, ResourceGUI);
+
     this->FPS = 0;
     this->frameCount = 0;
-    this->timeBeforeFPSUpdate = 1000;
+    this->timeBeforeFPSUpdate = 1000.0;
+    this->frameTime = 0.0f;
+    this->latency = 0.0f;
+    this->fenceWait = 0.0f;
+    this->allocationCount = MemoryManager::getGlobalAllocationCount();
+    this->allocationsPerFrame = 0.0f;
 }
 
-void FPSMeter::update(long elapsedTime)
+void FPSMeter::update(double elapsedTime)
 {
     this->frameCount++;
     this->timeBeforeFPSUpdate -= elapsedTime;
 	if (timeBeforeFPSUpdate < 0)
 	{
 		this->FPS = this->frameCount;
+		this->frameTime = (float) ((1000.0 - this->timeBeforeFPSUpdate) / this->frameCount);
+		this->allocationsPerFrame = (float) (MemoryManager::getGlobalAllocationCount() - this->allocationCount) / this->frameCount;
+		this->allocationCount = MemoryManager::getGlobalAllocationCount();
+		this->latency = (float) app->clock.averageLatency;
+		this->fenceWait = (float) renderer->averageFenceWaitTime;
 		this->frameCount = 0;
-		this->timeBeforeFPSUpdate = 1000;
+		this->timeBeforeFPSUpdate += 1000.0;
 	}
 }
 
@@ -50,6 +65,42 @@ void FPSMeter::draw()
 	ImGui::Begin("FPS", nullptr, ImGuiWindowFlags_NoMove | ImGuiWindowFlags_NoDecoration |ImGuiWindowFlags_AlwaysAutoResize | ImGuiWindowFlags_NoSavedSettings | ImGuiWindowFlags_NoFocusOnAppearing | ImGuiWindowFlags_NoNav);
 	ImGui::SetWindowFontScale(1.5f);
     ImGui::Text("FPS: %u", FPS);
+    ImGui::Text("Frame: %.2f ms", frameTime);
+    ImGui::Text("Input Latency: %.2f ms", latency);
+    ImGui::Text("Fence Wait: %.2f ms (%u in flight)", fenceWait, renderer->framesInFlight);
+
+    // Averaged over the last GPU_PROFILER_HISTORY frames the GPU has finished
+    for (auto & scope : renderer->profiler.scopes)
+        ImGui::Text("GPU %s: %.2f ms", scope.name.c_str(), scope.average);
+#ifdef KOI_TRACK_ALLOCATIONS
+    ImGui::Text("Allocations: %.1f / frame", allocationsPerFrame);
+#endif
+
+    for (uint32_t i = 0; i < UploadTypeCount; i++)
+    {
+        UploadCounters uploads = UploadStats::getLastFrame((UploadType) i);
+        ImGui::Text("%s: %u uploaded, %u skipped", UploadStats::getTypeName((UploadType) i), uploads.uploaded, uploads.skipped);
+    }
+
+    // Heaps the device allocator took memory from, used out of allocated
+    for (uint32_t i = 0; i < renderer->context->allocator.getHeapCount(); i++)
+    {
+        DeviceHeapStats heap = renderer->context->allocator.getHeapStats(i);
+
+        if (heap.memoryObjects > 0)
+            ImGui::Text("Heap %u: %.1f / %.1f MB, %.1f MB fragmented", i, heap.usedBytes / 1048576.0, heap.allocatedBytes / 1048576.0, heap.fragmentedBytes / 1048576.0);
+    }
+
+    // Staging copies submitted this frame, and what's left for the following frames' budgets
+    UploadBatcherStats transfers = renderer->context->uploads.getLastFrame();
+    ImGui::Text("Transfers: %.1f MB in %u copies, %u pending (%.1f MB)", transfers.bytes / 1048576.0, transfers.copies, transfers.pending, transfers.pendingBytes / 1048576.0);
+
+    // Out of the four binds each draw made before the render queue sorted them
+    RenderQueueStats draws = RenderQueue::getLastFrame();
+    ImGui::Text("Draws: %u, Binds: %u / %u", draws.draws, draws.getBindCount(), draws.draws * 4);
+    ImGui::Text("Pipeline %u, Descriptor %u, Vertex %u, Index %u", draws.pipelineBinds, draws.descriptorBinds, draws.vertexBinds, draws.indexBinds);
+
+    ImGui::Text("Coalesced Messages: %u", app->coalescedMessageCount);
     ImGui::End();
 }
 
@@ -65,14 +116,19 @@ Console::~Console()
 
 void Console::init()
 {
+	setResourceAccess(ResourceNone, ResourceNone);
+
 	buffer[0] = '\0';
 	historyIndex = 0;
 
 	commands[hashCode("exit")] = &Console::exit;
     commands[hashCode("add")] = &Console::addModel;
+    commands[hashCode("fps")] = &Console::setFrameLimit;
+    commands[hashCode("spawn")] = &Console::spawnInstance;
+    commands[hashCode("profile")] = &Console::profile;
 }
 
-void Console::update(long elapsedTime)
+void Console::update(double elapsedTime)
 {
 
 }
@@ -192,21 +248,58 @@ long Console::hashCode(std::string command)
 
 void Console::exit(std::vector<std::string> args)
 {
-	app->sendMessage(Exit);
+	app->sendMessage<Exit>();
 }
 
 void Console::addModel(std::vector<std::string> args)
 {
     if (args.size() >= 3)
-		app->sendMessageNow(AddModel, &args);
+		app->sendMessageNow<AddModel>(&args);
 
 	if (args.size() == 2)
 	{
 		args.push_back(findFile(args[1], "assets/meshes/"));
-		app->sendMessageNow(AddModel, &args);
+		app->sendMessageNow<AddModel>(&args);
 	}
 }
 
+void Console::setFrameLimit(std::vector<std::string> args)
+{
+	// fps <limit>, 0 removes the limit
+	if (args.size() >= 2)
+		app->sendMessage<SetFrameLimit>(std::strtof(args[1].c_str(), nullptr));
+}
+
+void Console::spawnInstance(std::vector<std::string> args)
+{
+	// spawn <model id> [x y z]
+	if (args.size() < 2)
+		return;
+
+	SpawnData data = {};
+	data.model = std::strtoul(args[1].c_str(), nullptr, 10);
+
+	if (args.size() >= 5)
+		data.position = {std::strtof(args[2].c_str(), nullptr), std::strtof(args[3].c_str(), nullptr), std::strtof(args[4].c_str(), nullptr)};
+
+	app->sendMessage<SpawnInstance>(data);
+}
+
+void Console::profile(std::vector<std::string> args)
+{
+	// profile [frames] [file], "profile stop" writes what was captured so far
+	if (args.size() >= 2 && args[1] == "stop")
+	{
+		Profiler::stopCapture();
+		return;
+	}
+
+	uint32_t frames = (args.size() >= 2) ? std::strtoul(args[1].c_str(), nullptr, 10) : PROFILER_DEFAULT_FRAMES;
+	std::string filename = (args.size() >= 3) ? args[2] : PROFILER_DEFAULT_FILENAME;
+
+	Profiler::startCapture(frames, filename);
+}
+
 LightingTweaker::LightingTweaker()
 {
 
@@ -219,12 +312,17 @@ LightingTweaker::~LightingTweaker()
 
 void LightingTweaker::init()
 {
-
+    setResourceAccess(ResourceGUI, ResourceNone);
 }
 
-void LightingTweaker::update(long elapsedTime)
+void LightingTweaker::update(double elapsedTime)
 {
-    app->sendMessage(SetLighting, &this->data);
+    // Only when a control was edited last frame, the first update sends the defaults
+    if (!this->changed)
+        return;
+
+    app->sendMessage<SetLighting>(this->data);
+    this->changed = false;
 }
 
 void LightingTweaker::draw()
@@ -232,10 +330,10 @@ void LightingTweaker::draw()
 	ImGui::Begin("Lighting Tweaker");
 	ImGui::SetWindowFontScale(1.5f);
 
-    ImGui::InputFloat3("Direction", (float*)&data.direction);
-    ImGui::ColorEdit4("Ambient", (float*)&data.ambient);
-    ImGui::ColorEdit4("Diffuse", (float*)&data.diffuse);
-    ImGui::ColorEdit4("Specular", (float*)&data.specular);
+    changed |= ImGui::InputFloat3("Direction", (float*)&data.direction);
+    changed |= ImGui::ColorEdit4("Ambient", (float*)&data.ambient);
+    changed |= ImGui::ColorEdit4("Diffuse", (float*)&data.diffuse);
+    changed |= ImGui::ColorEdit4("Specular", (float*)&data.specular);
 
 	ImGui::End();
 }
@@ -252,14 +350,20 @@ ModelViewer::~ModelViewer()
 
 void ModelViewer::init()
 {
-    getModels(nullptr);
+    // Reads the scene's models and loads every frame while something is loading, through
+    // sendMessageNow which may only be called from the main thread
+    setResourceAccess(ResourceScene, ResourceNone, true);
 
-    this->setMessageCallback(AddModel, (message_method_t) &ModelViewer::getModels);
+    getModels();
+
+    this->setMessageCallback<AddModel>(&ModelViewer::getModels);
+    this->setMessageCallback<SpawnInstance>(&ModelViewer::getModels);
 }
 
-void ModelViewer::update(long elapsedTime)
+void ModelViewer::update(double elapsedTime)
 {
-
+    if (!this->models.empty() && this->models.back().loading)
+        getModels();
 }
 
 void ModelViewer::draw()
@@ -269,18 +373,103 @@ void ModelViewer::draw()
 
     for (auto & model : this->models)
     {
-        ImGui::Text("%u %s (%u)\n", model._id, model.name.c_str(), model.instanceCount);
+        if (!model.loading)
+        {
+            ImGui::Text("%u %s (%u)\n", model._id, model.name.c_str(), model.instanceCount);
+            continue;
+        }
+
+        ImGui::Text("%u %s (loading)", model._id, model.name.c_str());
+        ImGui::ProgressBar(model.progress);
     }
 
 	ImGui::End();
 }
 
-void ModelViewer::getModels(Message * msg)
+void ModelViewer::getModels()
 {
     this->models.clear();
-    app->sendMessageNow(GetModelData, &this->models);
+    app->sendMessageNow<GetModelData>(&this->models);
+}
+
+#ifdef KOI_MESSAGE_STATS
+
+MessageStatsPanel::MessageStatsPanel()
+{
+
+}
+
+MessageStatsPanel::~MessageStatsPanel()
+{
+
+}
+
+void MessageStatsPanel::init()
+{
+    setResourceAccess(ResourceNone, ResourceNone);
 }
 
+void MessageStatsPanel::update(double elapsedTime)
+{
+
+}
+
+void MessageStatsPanel::draw()
+{
+    const MessageStats & stats = app->messageStats;
+
+    ImGui::SetNextWindowPos(ImVec2(10.0f, 130.0f), ImGuiCond_FirstUseEver);
+	ImGui::Begin("Message Bus");
+
+    // Last frame per MessageType, only types that have been sent at least once
+    ImGui::Columns(4, "types");
+    ImGui::Text("Message"); ImGui::NextColumn();
+    ImGui::Text("Frame Count"); ImGui::NextColumn();
+    ImGui::Text("Frame ms"); ImGui::NextColumn();
+    ImGui::Text("Total Count"); ImGui::NextColumn();
+    ImGui::Separator();
+
+    for (uint32_t i = 0; i < MessageTypeCount; i++)
+    {
+        const MessageTimingStats & frame = stats.getTypeStats((MessageType) i);
+        const MessageTimingStats & total = stats.getTypeTotals((MessageType) i);
+
+        if (total.count == 0 && frame.count == 0)
+            continue;
+
+        ImGui::Text("%s", MessageStats::getMessageTypeName((MessageType) i)); ImGui::NextColumn();
+        ImGui::Text("%llu", (unsigned long long) frame.count); ImGui::NextColumn();
+        ImGui::Text("%.3f", frame.totalNanoseconds / 1000000.0); ImGui::NextColumn();
+        ImGui::Text("%llu", (unsigned long long) total.count); ImGui::NextColumn();
+    }
+    ImGui::Columns(1);
+    ImGui::Separator();
+
+    // Per handler totals since startup with a latency histogram
+    for (auto & handler : stats.getHandlerStats())
+    {
+        if (handler.total.count == 0)
+            continue;
+
+        if (ImGui::TreeNode(handler.name.c_str()))
+        {
+            ImGui::Text("Calls: %llu  Avg: %.2f us  Max: %.2f us", (unsigned long long) handler.total.count,
+                handler.total.totalNanoseconds / 1000.0 / handler.total.count, handler.total.maxNanoseconds / 1000.0);
+
+            float histogram[MESSAGE_STATS_BUCKET_COUNT];
+            for (uint32_t i = 0; i < MESSAGE_STATS_BUCKET_COUNT; i++)
+                histogram[i] = (float) handler.total.histogram[i];
+
+            ImGui::PlotHistogram("<1us .. >16ms", histogram, MESSAGE_STATS_BUCKET_COUNT, 0, nullptr, 0.0f, FLT_MAX, ImVec2(0, 60));
+            ImGui::TreePop();
+        }
+    }
+
+	ImGui::End();
+}
+
+#endif
+
 GUI::GUI(DesktopContext * context, DesktopRenderer * renderer, MessageBus * app)
 {
 	this->context = context;
@@ -289,6 +478,10 @@ GUI::GUI(DesktopContext * context, DesktopRenderer * renderer, MessageBus * app)
 	// ===== Create imgui context =====
 
 	IMGUI_CHECKVERSION();
+
+	// Charge imgui's allocations to the GUI tag
+	ImGui::SetAllocatorFunctions([](size_t size, void * userData) { return MemoryManager::allocate(size, MemoryTagGUI); },
+	                             [](void * pointer, void * userData) { MemoryManager::deallocate(pointer); });
 	ImGui::CreateContext();
 	ImGuiIO& io = ImGui::GetIO(); (void)io;
 
@@ -370,11 +563,12 @@ GUI::GUI(DesktopContext * context, DesktopRenderer * renderer, MessageBus * app)
 	init_info.Device = context->device;
 	init_info.QueueFamily = context->primaryGraphicsQueue->index;
 	init_info.Queue = context->primaryGraphicsQueue->queue;
-	init_info.PipelineCache = VK_NULL_HANDLE;
+	init_info.PipelineCache = context->pipelineCache;
 	init_info.DescriptorPool = descriptorPool;
 	init_info.Allocator = nullptr;
+	// ImGui rotates its vertex buffers through ImageCount, one per frame in flight at least
 	init_info.MinImageCount = renderer->length;
-	init_info.ImageCount = renderer->length;
+	init_info.ImageCount = std::max(renderer->length, renderer->framesInFlight);
 	init_info.CheckVkResultFn = nullptr;
 	ImGui_ImplVulkan_Init(&init_info, renderPass);
 
@@ -389,7 +583,7 @@ GUI::GUI(DesktopContext * context, DesktopRenderer * renderer, MessageBus * app)
 	ImGui_ImplVulkan_CreateFontsTexture(command_buffer);
 	endSingleTimeCommands(context->device, context->primaryGraphicsQueue->queue, context->primaryGraphicsQueue->commandPool, command_buffer);
 
-    FPSMeter * fpsmeter = new FPSMeter();
+    FPSMeter * fpsmeter = new FPSMeter(renderer);
     Console * console = new Console();
     LightingTweaker * lightingTweaker = new LightingTweaker();
     ModelViewer * modelViewer = new ModelViewer();
@@ -399,10 +593,18 @@ GUI::GUI(DesktopContext * context, DesktopRenderer * renderer, MessageBus * app)
     app->registerSystem(lightingTweaker);
     app->registerSystem(modelViewer);
 
+#ifdef KOI_MESSAGE_STATS
+    MessageStatsPanel * messageStatsPanel = new MessageStatsPanel();
+    app->registerSystem(messageStatsPanel);
+#endif
+
     elements.push_back(fpsmeter);
     elements.push_back(console);
     elements.push_back(lightingTweaker);
     elements.push_back(modelViewer);
+#ifdef KOI_MESSAGE_STATS
+    elements.push_back(messageStatsPanel);
+#endif
 
 	DEBUG("GUI - GUI Created");
 }
@@ -446,6 +648,9 @@ void GUI::draw(VkCommandBuffer commandbuffer)
 	passInfo.renderArea.extent.height = renderer->extent.height;
 	passInfo.clearValueCount = 0;
 	passInfo.pClearValues = nullptr;
+
+	GPUProfileScope gpuScope(renderer->profiler, commandbuffer, "GUI");
+
 	vkCmdBeginRenderPass(commandbuffer, &passInfo, VK_SUBPASS_CONTENTS_INLINE);
 
 	ImGui_ImplVulkan_RenderDrawData(ImGui::GetDrawData(), commandbuffer);
@@ -0,0 +1,156 @@
+#include <render/GeometryArena.h>
+#include <render/Utilities.h>
+#include <render/Model.h>
+
+#include <algorithm>
+
+void GeometryArena::create(Context * context)
+{
+    this->context = context;
+
+    heaps[GeometryVertices].name = "vertex";
+    heaps[GeometryVertices].stride = sizeof(Vertex);
+    heaps[GeometryVertices].usage = VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+
+    heaps[GeometryIndices].name = "index";
+    heaps[GeometryIndices].stride = sizeof(uint32_t);
+    heaps[GeometryIndices].usage = VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+
+    DEBUG("GEOMETRY_ARENA - Geometry Arena Created");
+}
+
+void GeometryArena::destroy()
+{
+    if (context == nullptr)
+        return;
+
+    for (auto & heap : heaps)
+    {
+        if (!heap.blocks.empty())
+            DEBUG("GEOMETRY_ARENA - %zu %s blocks, %llu bytes still in use", heap.blocks.size(), heap.name, (unsigned long long) heap.usedElements * heap.stride);
+
+        for (auto & block : heap.blocks)
+            destroyBuffer(context, block.buffer, block.allocation);
+
+        heap.blocks.clear();
+        heap.usedElements = 0;
+    }
+
+    context = nullptr;
+}
+
+// ===============================================================================================================
+//                                              Allocation
+// ===============================================================================================================
+
+void GeometryArena::createBlock(Heap & heap, uint32_t capacity)
+{
+    heap.blocks.emplace_back();
+    Block & block = heap.blocks.back();
+
+    block.capacity = capacity;
+    block.freeRuns.push_back({0, capacity});
+
+    createBuffer(context, (VkDeviceSize) capacity * heap.stride, heap.usage, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &block.buffer, &block.allocation);
+
+    DEBUG("GEOMETRY_ARENA - Created %s block %zu, %llu bytes", heap.name, heap.blocks.size() - 1, (unsigned long long) capacity * heap.stride);
+}
+
+GeometryRange GeometryArena::allocate(Heap & heap, uint32_t count)
+{
+    GeometryRange range;
+
+    // First fit, blocks are few and hold few free runs since shapes are freed a model at a time
+    for (uint32_t i = 0; i < heap.blocks.size() && range.block == GEOMETRY_ARENA_INVALID; i++)
+    {
+        auto & runs = heap.blocks[i].freeRuns;
+
+        for (uint32_t j = 0; j < runs.size(); j++)
+        {
+            if (runs[j].count < count)
+                continue;
+
+            range = {i, runs[j].first, count, heap.blocks[i].buffer};
+
+            runs[j].first += count;
+            runs[j].count -= count;
+
+            if (runs[j].count == 0)
+                runs.erase(runs.begin() + j);
+
+            break;
+        }
+    }
+
+    if (range.block == GEOMETRY_ARENA_INVALID)
+    {
+        createBlock(heap, std::max(count, (uint32_t) (GEOMETRY_ARENA_BLOCK_SIZE / heap.stride)));
+
+        Block & block = heap.blocks.back();
+        range = {(uint32_t) heap.blocks.size() - 1, 0, count, block.buffer};
+
+        block.freeRuns[0].first += count;
+        block.freeRuns[0].count -= count;
+
+        if (block.freeRuns[0].count == 0)
+            block.freeRuns.clear();
+    }
+
+    heap.usedElements += count;
+
+    return range;
+}
+
+GeometryRange GeometryArena::upload(GeometryBufferType type, const void * data, uint32_t count, UploadTicket * ticket)
+{
+    Heap & heap = heaps[type];
+
+    *ticket = UPLOAD_TICKET_NONE;
+
+    if (count == 0)
+        return GeometryRange();
+
+    GeometryRange range;
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        range = allocate(heap, count);
+    }
+
+    *ticket = context->uploads.uploadBuffer(range.buffer, (VkDeviceSize) range.first * heap.stride,
+                                            data, (VkDeviceSize) count * heap.stride);
+
+    return range;
+}
+
+void GeometryArena::free(GeometryBufferType type, const GeometryRange & range)
+{
+    Heap & heap = heaps[type];
+
+    if (range.block == GEOMETRY_ARENA_INVALID || range.count == 0)
+        return;
+
+    std::lock_guard<std::mutex> lock(mutex);
+
+    VALIDATE(range.block < heap.blocks.size(), "GEOMETRY_ARENA - Freed a range of %s block %u, which doesn't exist", heap.name, range.block);
+
+    auto & runs = heap.blocks[range.block].freeRuns;
+
+    auto next = std::lower_bound(runs.begin(), runs.end(), range.first, [](const FreeRun & run, uint32_t first) { return run.first < first; });
+    auto run = runs.insert(next, {range.first, range.count});
+
+    // Merge with the run after, then the one before
+    if (run + 1 != runs.end() && run->first + run->count == (run + 1)->first)
+    {
+        run->count += (run + 1)->count;
+        runs.erase(run + 1);
+    }
+
+    if (run != runs.begin() && (run - 1)->first + (run - 1)->count == run->first)
+    {
+        (run - 1)->count += run->count;
+        runs.erase(run);
+    }
+
+    heap.usedElements -= range.count;
+}
@@ -0,0 +1,86 @@
+#include <render/HeadlessContext.h>
+
+HeadlessContext::HeadlessContext(uint32_t width, uint32_t height)
+{
+    this->extent = {width, height};
+
+    // ===== Setup Instance =====
+
+    // Build machines rarely have the validation layers installed, run without them
+    if (!supportsLayers(layers))
+        layers.clear();
+
+    instance = createVkInstance(layers, instanceExtensions);
+
+    this->createValidationDebugCallback();
+
+    // ===== Setup VkPhysicalDevice =====
+    physicalDevice = chooseVkPhysicalDevice(instance, VK_NULL_HANDLE, VK_PHYSICAL_DEVICE_FEATURES_NONE, deviceExtensions, queueFlags);
+
+    std::vector<uint32_t> queueLocations;
+    selectVkQueues(physicalDevice, this->queueFlags, this->queues, queueLocations, VK_NULL_HANDLE, -1);
+
+    // Nothing is presented, the present queue is only there for code that expects one
+    this->primaryGraphicsQueue = &this->queues[queueLocations[0]];
+    this->primaryTransferQueue = &this->queues[queueLocations[1]];
+    this->primaryPresentQueue = &this->queues[queueLocations[0]];
+
+    DEBUG("CONTEXT - Found Graphics Queue - index: %d flags: %d", this->primaryGraphicsQueue->index, this->primaryGraphicsQueue->flags);
+    DEBUG("CONTEXT - Found Transfer Queue - index: %d flags: %d", this->primaryTransferQueue->index, this->primaryTransferQueue->flags);
+
+    for (auto& queue : queues)
+        queueIndices.push_back(queue.index);
+
+    // ===== Setup VkDevice =====
+    device = createVkDevice(physicalDevice, getPhysicalDeviceFeatures(physicalDevice), layers, deviceExtensions, queues);
+
+    // ===== Setup VkQueues =====
+    for (auto& queue : queues)
+        vkGetDeviceQueue(device, queue.index, 0, &queue.queue);
+
+    // ===== Setup VkCommandPools =====
+    for (auto& queue : queues)
+    {
+        VkCommandPoolCreateInfo poolInfo = queue.getVkCommandPoolCreateInfo();
+        vkCreateCommandPool(device, &poolInfo, nullptr, &queue.commandPool);
+    }
+
+    // ===== Setup DeviceAllocator =====
+    allocator.create(physicalDevice, device);
+
+    // ===== Setup UploadBatcher =====
+    uploads.create(this);
+
+    // ===== Setup VkPipelineCache =====
+    createPipelineCache();
+
+    DEBUG("CONTEXT - Headless Context Created %ux%u", width, height);
+}
+
+HeadlessContext::~HeadlessContext()
+{
+    for (auto& queue : queues)
+    {
+        vkDestroyCommandPool(device, queue.commandPool, nullptr);
+    }
+
+    destroyPipelineCache();
+    uploads.destroy();
+    allocator.destroy();
+
+    vkDestroyDevice(device, nullptr);
+    this->destroyValidationDebugCallback();
+    vkDestroyInstance(instance, nullptr);
+
+    DEBUG("CONTEXT - Headless Context Destroyed");
+}
+
+void HeadlessContext::init()
+{
+
+}
+
+void HeadlessContext::update(double elapsedTime)
+{
+
+}
@@ -0,0 +1,377 @@
+#include <cstdio>
+#include <limits>
+#include <algorithm>
+
+#include <system/Log.h>
+#include <render/HeadlessRenderer.h>
+#include <render/Utilities.h>
+
+void FrameTimeStats::add(double milliseconds)
+{
+    min = (count == 0) ? milliseconds : std::min(min, milliseconds);
+    max = (count == 0) ? milliseconds : std::max(max, milliseconds);
+    total += milliseconds;
+    count++;
+}
+
+void HeadlessRenderer::init()
+{
+	setResourceAccess(ResourceNone, ResourceRenderer);
+}
+
+void HeadlessRenderer::update(double elapsedTime)
+{
+    // The first frame's time includes startup
+    if (frameCount > 0)
+        cpuFrameTimes.add(elapsedTime);
+}
+
+VkCommandBuffer HeadlessRenderer::getNextCommandBuffer()
+{
+    // One image per frame in flight, nothing else can be using it once the fence is waited on
+    FrameContext & frame = waitForFrame(context->device);
+    currentImageIndex = currentFrame;
+
+    collectFrame(currentImageIndex);
+
+    VkCommandBufferBeginInfo beginInfo = {};
+    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    beginInfo.pInheritanceInfo = nullptr;
+
+    VkCommandBuffer commandbuffer = frame.commandBuffer;
+
+    int result = vkBeginCommandBuffer(commandbuffer, &beginInfo);
+    VALIDATE(result == VK_SUCCESS, "RENDERER - Failed to begin recording command buffer! %d", result);
+
+    if (queryPool != VK_NULL_HANDLE)
+    {
+        vkCmdResetQueryPool(commandbuffer, queryPool, currentImageIndex * 2, 2);
+        vkCmdWriteTimestamp(commandbuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, queryPool, currentImageIndex * 2);
+    }
+
+    profiler.beginFrame(commandbuffer, currentFrame);
+
+    VkImageMemoryBarrier barrier;
+    barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    barrier.pNext = nullptr;
+    barrier.srcAccessMask = 0;
+    barrier.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+    barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    barrier.newLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.image = images[currentImageIndex];
+    barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    barrier.subresourceRange.baseMipLevel = 0;
+    barrier.subresourceRange.levelCount = 1;
+    barrier.subresourceRange.baseArrayLayer = 0;
+    barrier.subresourceRange.layerCount = 1;
+
+    vkCmdPipelineBarrier(commandbuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+                         VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, 0, 0, nullptr, 0, nullptr,
+                         1, &barrier);
+
+    return commandbuffer;
+}
+
+void HeadlessRenderer::render(VkCommandBuffer commandbuffer)
+{
+    if (readback)
+    {
+        VkImageMemoryBarrier barrier;
+        barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+        barrier.pNext = nullptr;
+        barrier.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+        barrier.oldLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+        barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.image = images[currentImageIndex];
+        barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        barrier.subresourceRange.baseMipLevel = 0;
+        barrier.subresourceRange.levelCount = 1;
+        barrier.subresourceRange.baseArrayLayer = 0;
+        barrier.subresourceRange.layerCount = 1;
+
+        vkCmdPipelineBarrier(commandbuffer, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+                             VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr,
+                             1, &barrier);
+
+        VkBufferImageCopy region = {};
+        region.bufferOffset = 0;
+        region.bufferRowLength = 0;
+        region.bufferImageHeight = 0;
+        region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        region.imageSubresource.mipLevel = 0;
+        region.imageSubresource.baseArrayLayer = 0;
+        region.imageSubresource.layerCount = 1;
+        region.imageOffset = {0, 0, 0};
+        region.imageExtent = {extent.width, extent.height, 1};
+
+        vkCmdCopyImageToBuffer(commandbuffer, images[currentImageIndex], VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, readbackBuffers[currentImageIndex], 1, &region);
+
+        VkBufferMemoryBarrier bufferBarrier = {};
+        bufferBarrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+        bufferBarrier.pNext = nullptr;
+        bufferBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        bufferBarrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+        bufferBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        bufferBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        bufferBarrier.buffer = readbackBuffers[currentImageIndex];
+        bufferBarrier.offset = 0;
+        bufferBarrier.size = VK_WHOLE_SIZE;
+
+        vkCmdPipelineBarrier(commandbuffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                             VK_PIPELINE_STAGE_HOST_BIT, 0, 0, nullptr, 1, &bufferBarrier,
+                             0, nullptr);
+    }
+
+    profiler.endFrame(commandbuffer);
+
+    if (queryPool != VK_NULL_HANDLE)
+        vkCmdWriteTimestamp(commandbuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, queryPool, currentImageIndex * 2 + 1);
+
+    vkEndCommandBuffer(commandbuffer);
+
+	VkSubmitInfo submitInfo = {};
+	submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+	submitInfo.waitSemaphoreCount = 0;
+	submitInfo.pWaitSemaphores = nullptr;
+	submitInfo.pWaitDstStageMask = nullptr;
+	submitInfo.commandBufferCount = 1;
+	submitInfo.pCommandBuffers = &commandbuffer;
+	submitInfo.signalSemaphoreCount = 0;
+	submitInfo.pSignalSemaphores = nullptr;
+
+	vkResetFences(context->device, 1, &frames[currentFrame].fence);
+
+	VkResult result = vkQueueSubmit(context->primaryGraphicsQueue->queue, 1, &submitInfo, frames[currentFrame].fence);
+	VALIDATE(result == VK_SUCCESS, "RENDERER - Failed to submit draw command buffer %d", result);
+
+    submitted[currentImageIndex] = true;
+}
+
+void HeadlessRenderer::present()
+{
+    advanceFrame();
+
+    if (frameTarget > 0 && frameCount == frameTarget)
+        app->sendMessage<Exit>();
+}
+
+void HeadlessRenderer::collectFrame(uint32_t image)
+{
+    if (!submitted[image])
+        return;
+
+    submitted[image] = false;
+
+    if (queryPool != VK_NULL_HANDLE)
+    {
+        uint64_t timestamps[2];
+        VkResult result = vkGetQueryPoolResults(context->device, queryPool, image * 2, 2, sizeof(timestamps), timestamps, sizeof(uint64_t), VK_QUERY_RESULT_64_BIT);
+
+        if (result == VK_SUCCESS)
+            gpuFrameTimes.add((timestamps[1] - timestamps[0]) * timestampPeriod / 1000000.0);
+    }
+
+    if (readback)
+        lastReadback = image;
+}
+
+bool HeadlessRenderer::writeFrame(const std::string & filename)
+{
+    if (lastReadback < 0)
+        return false;
+
+    FILE * file = fopen(filename.c_str(), "wb");
+    if (file == nullptr)
+    {
+        WARN("RENDERER - Could not open %s", filename.c_str());
+        return false;
+    }
+
+    fprintf(file, "P6\n%u %u\n255\n", extent.width, extent.height);
+
+    const unsigned char * pixels = static_cast<const unsigned char *>(readbackData[lastReadback]);
+    bool bgra = colorFormat == VK_FORMAT_B8G8R8A8_UNORM;
+
+    std::vector<unsigned char> row(extent.width * 3);
+    for (uint32_t y = 0; y < extent.height; y++)
+    {
+        for (uint32_t x = 0; x < extent.width; x++)
+        {
+            const unsigned char * pixel = pixels + (y * extent.width + x) * 4;
+
+            row[x * 3 + 0] = bgra ? pixel[2] : pixel[0];
+            row[x * 3 + 1] = pixel[1];
+            row[x * 3 + 2] = bgra ? pixel[0] : pixel[2];
+        }
+
+        fwrite(row.data(), 1, row.size(), file);
+    }
+
+    fclose(file);
+
+    INFO("RENDERER - Frame written to %s", filename.c_str());
+
+    return true;
+}
+
+HeadlessRenderer::HeadlessRenderer(HeadlessContext * context, uint32_t frameTarget, std::string captureFilename, uint32_t framesInFlight)
+{
+    // ===== Initialization =====
+
+    this->context = context;
+
+    this->frameTarget = frameTarget;
+    this->captureFilename = captureFilename;
+    this->readback = !captureFilename.empty();
+
+    this->framesInFlight = framesInFlight;
+    this->length = framesInFlight;
+    this->extent = context->extent;
+
+    this->colorFormat = chooseColorFormat(context->physicalDevice);
+    this->depthFormat = chooseDepthFormat(context->physicalDevice);
+
+    // ===== Target Images =====
+
+    images.resize(length);
+    imageAllocations.resize(length);
+    imageviews.resize(length);
+	for (int i = 0; i < length; i++)
+	{
+        createVkImage(context, VK_IMAGE_TYPE_2D, colorFormat,
+                        extent, 1, 1, VK_SAMPLE_COUNT_1_BIT, VK_IMAGE_TILING_OPTIMAL,
+                        VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT,
+                        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &images[i], &imageAllocations[i]);
+
+		createVkImageView(context->physicalDevice, context->device, images[i], VK_IMAGE_VIEW_TYPE_2D,
+			              colorFormat, 1, 1, VK_IMAGE_ASPECT_COLOR_BIT, &imageviews[i]);
+	}
+
+    // ===== Readback Buffers =====
+
+    if (readback)
+    {
+        VkDeviceSize size = (VkDeviceSize) extent.width * extent.height * 4;
+
+        readbackBuffers.resize(length);
+        readbackAllocations.resize(length);
+        readbackData.resize(length);
+        for (int i = 0; i < length; i++)
+        {
+            createBuffer(context, size, VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                         VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                         &readbackBuffers[i], &readbackAllocations[i]);
+
+            readbackData[i] = readbackAllocations[i].mapped;
+        }
+    }
+
+    // ===== MSAA Color Resolve Image =====
+
+    createVkImage(context, VK_IMAGE_TYPE_2D, colorFormat,
+                    extent, 1, 1, sample_count, VK_IMAGE_TILING_OPTIMAL,
+                    VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT | VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT,
+                    VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &colorImage, &colorImageAllocation);
+
+    transitionImageLayout(context->device, context->primaryGraphicsQueue->queue, context->primaryGraphicsQueue->commandPool, colorImage, colorFormat, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, 1);
+
+    createVkImageView(context->physicalDevice, context->device, colorImage, VK_IMAGE_VIEW_TYPE_2D,
+                        colorFormat, 1, 1, VK_IMAGE_ASPECT_COLOR_BIT,
+                        &colorImageView);
+
+    // ===== Depth Image =====
+
+    createVkImage(context, VK_IMAGE_TYPE_2D, depthFormat,
+                    extent, 1, 1, sample_count, VK_IMAGE_TILING_OPTIMAL,
+                    VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT,
+                    VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &depthImage, &depthImageAllocation);
+
+    transitionImageLayout(context->device, context->primaryGraphicsQueue->queue, context->primaryGraphicsQueue->commandPool, depthImage, depthFormat, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL, 1);
+
+    createVkImageView(context->physicalDevice, context->device, depthImage, VK_IMAGE_VIEW_TYPE_2D,
+                        depthFormat, 1, 1, VK_IMAGE_ASPECT_DEPTH_BIT, &depthImageView);
+
+    // ===== Timestamp Queries =====
+
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(context->physicalDevice, &properties);
+
+    std::vector<VkQueueFamilyProperties> queueProperties;
+    getQueueFamilyProperties(context->physicalDevice, queueProperties);
+
+    if (queueProperties[context->primaryGraphicsQueue->index].timestampValidBits > 0 && properties.limits.timestampPeriod > 0.0f)
+    {
+        VkQueryPoolCreateInfo queryInfo = {};
+        queryInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+        queryInfo.pNext = nullptr;
+        queryInfo.flags = 0;
+        queryInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+        queryInfo.queryCount = length * 2;
+
+        vkCreateQueryPool(context->device, &queryInfo, nullptr, &queryPool);
+        timestampPeriod = properties.limits.timestampPeriod;
+    }
+    else
+    {
+        WARN("RENDERER - Graphics queue has no timestamps, GPU frame times unavailable");
+    }
+
+    submitted.resize(length, false);
+
+    // ===== Frames In Flight =====
+
+    createFrameContexts(context->device, context->primaryGraphicsQueue->index);
+
+    profiler.create(context->physicalDevice, context->device, context->primaryGraphicsQueue->index, framesInFlight);
+
+    DEBUG("RENDERER - Headless Renderer Created %ux%u", extent.width, extent.height);
+}
+
+HeadlessRenderer::~HeadlessRenderer()
+{
+    vkDeviceWaitIdle(context->device);
+
+    for (uint32_t i = 0; i < length; i++)
+        collectFrame((frameCount + i) % length);
+
+    INFO("RENDERER - Headless run of %llu frames at %ux%u", frameCount, extent.width, extent.height);
+    INFO("RENDERER - CPU frame time avg %.3f ms min %.3f ms max %.3f ms", cpuFrameTimes.getAverage(), cpuFrameTimes.min, cpuFrameTimes.max);
+
+    if (queryPool != VK_NULL_HANDLE)
+        INFO("RENDERER - GPU frame time avg %.3f ms min %.3f ms max %.3f ms", gpuFrameTimes.getAverage(), gpuFrameTimes.min, gpuFrameTimes.max);
+
+    for (auto & scope : profiler.scopes)
+        INFO("RENDERER - GPU %s avg %.3f ms over the last %u frames", scope.name.c_str(), scope.average, scope.historyCount);
+
+    if (readback)
+        writeFrame(captureFilename);
+
+    if (queryPool != VK_NULL_HANDLE)
+        vkDestroyQueryPool(context->device, queryPool, nullptr);
+
+    profiler.destroy();
+    destroyFrameContexts(context->device);
+
+	for (int i = 0; i < length; i++)
+	{
+		vkDestroyImageView(context->device, imageviews[i], nullptr);
+		destroyVkImage(context, images[i], imageAllocations[i]);
+
+        if (readback)
+            destroyBuffer(context, readbackBuffers[i], readbackAllocations[i]);
+	}
+
+    vkDestroyImageView(context->device, colorImageView, nullptr);
+    destroyVkImage(context, colorImage, colorImageAllocation);
+
+    vkDestroyImageView(context->device, depthImageView, nullptr);
+    destroyVkImage(context, depthImage, depthImageAllocation);
+
+    DEBUG("RENDERER - Headless Renderer Destroyed");
+}
@@ -0,0 +1,108 @@
+#include <system/Input.h>
+#include <system/Log.h>
+
+// ===============================================================================================================
+//                                            Input Event Ring
+// ===============================================================================================================
+
+InputEventRing::InputEventRing(uint32_t capacity) : events(capacity)
+{
+	VALIDATE(capacity > 0 && (capacity & (capacity - 1)) == 0, "INPUT - Ring capacity must be a power of two %u", capacity);
+
+	this->mask = capacity - 1;
+
+	writePosition.store(0, std::memory_order_relaxed);
+	readPosition.store(0, std::memory_order_relaxed);
+	dropped.store(0, std::memory_order_relaxed);
+}
+
+bool InputEventRing::push(const InputEvent & event)
+{
+	uint32_t write = writePosition.load(std::memory_order_relaxed);
+
+	if (write - readPosition.load(std::memory_order_acquire) > mask)
+	{
+		dropped.fetch_add(1, std::memory_order_relaxed);
+		return false;
+	}
+
+	events[write & mask] = event;
+	writePosition.store(write + 1, std::memory_order_release);
+
+	return true;
+}
+
+bool InputEventRing::pop(InputEvent & event)
+{
+	uint32_t read = readPosition.load(std::memory_order_relaxed);
+
+	if (read == writePosition.load(std::memory_order_acquire))
+		return false;
+
+	event = events[read & mask];
+	readPosition.store(read + 1, std::memory_order_release);
+
+	return true;
+}
+
+// ===============================================================================================================
+//                                             Input Snapshot
+// ===============================================================================================================
+
+void InputSnapshot::beginFrame()
+{
+	keysPressed.reset();
+	keysReleased.reset();
+	buttonsPressed.reset();
+	buttonsReleased.reset();
+
+	mouseDelta = {0.0f, 0.0f};
+	eventCount = 0;
+}
+
+void InputSnapshot::apply(const InputEvent & event)
+{
+	eventCount++;
+
+	switch (event.type)
+	{
+		case InputKeyPress:
+			if (event.code < 0 || event.code >= INPUT_KEY_COUNT) break;
+			keysDown[event.code] = true;
+			keysPressed[event.code] = true;
+			break;
+		case InputKeyRelease:
+			if (event.code < 0 || event.code >= INPUT_KEY_COUNT) break;
+			keysDown[event.code] = false;
+			keysReleased[event.code] = true;
+			break;
+		case InputMouseButtonPress:
+			if (event.code < 0 || event.code >= INPUT_MOUSE_BUTTON_COUNT) break;
+			buttonsDown[event.code] = true;
+			buttonsPressed[event.code] = true;
+			break;
+		case InputMouseButtonRelease:
+			if (event.code < 0 || event.code >= INPUT_MOUSE_BUTTON_COUNT) break;
+			buttonsDown[event.code] = false;
+			buttonsReleased[event.code] = true;
+			break;
+		case InputCursorMove:
+			mouseDelta.x += event.x - cursor.x;
+			mouseDelta.y += event.y - cursor.y;
+			cursor = {event.x, event.y};
+			break;
+		case InputCursorWarp:
+			cursor = {event.x, event.y};
+			break;
+		case InputFocus:
+			focused = event.code != 0;
+
+			// Releases that happen while unfocused never arrive
+			if (!focused)
+			{
+				keysDown.reset();
+				buttonsDown.reset();
+			}
+			break;
+	};
+}
\ No newline at end of file
@@ -1,14 +1,15 @@
-
 #include <InputSystem.h>
 
-void InputSystem::update(long elapsedTime)
+void InputSystem::update(double elapsedTime)
 {
 
 }
 
 InputSystem::InputSystem()
 {
-	setMessageCallback(GLFWwindowCreated, (message_method_t) &InputSystem::onWindowCreate);
+	setResourceAccess(ResourceNone, ResourceInput);
+
+	setMessageCallback<GLFWwindowCreated>(&InputSystem::onWindowCreate);
 
 	DEBUG("INPUT_SYSTEM - Input System Created");
 }
@@ -18,12 +19,71 @@ InputSystem::~InputSystem()
 	DEBUG("INPUT_SYSTEM - Input System Destroyed");
 }
 
-void InputSystem::toggleCursor(GLFWwindow * window)
+void InputSystem::poll()
 {
-	if (glfwGetInputMode(window, GLFW_CURSOR) == GLFW_CURSOR_DISABLED)
-		glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_NORMAL);		
-	else
-		glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
+	// Headless runs have no window, a replay is their only input
+	if (window != nullptr)
+		glfwPollEvents();
+	else if (!app->replay.isPlaying())
+		return;
+
+	InputSnapshot & input = app->input;
+	input.beginFrame();
+
+	// Key and button edges still go out as messages for systems that react to them, they
+	// are rare. Cursor movement only ever lands in the snapshot.
+	InputEvent event;
+
+	// A playing recording stands in for the devices
+	if (app->replay.isPlaying())
+		while (events.pop(event));
+
+	while (nextEvent(event))
+	{
+		input.apply(event);
+
+		switch (event.type)
+		{
+			case InputKeyPress:
+				if (event.code == '`')
+					toggleCursor();
+				app->sendMessageNow<KeyPress>(event.code);
+				break;
+			case InputKeyRelease:
+				app->sendMessageNow<KeyRelease>(event.code);
+				break;
+			case InputMouseButtonPress:
+				app->sendMessageNow<MouseButtonPress>(event.code);
+				break;
+			case InputMouseButtonRelease:
+				app->sendMessageNow<MouseButtonRelease>(event.code);
+				break;
+			case InputFocus:
+				app->sendMessageNow<SetWindowFocus>(event.code);
+				break;
+			default:
+				break;
+		};
+	}
+
+	uint32_t dropped = events.takeDroppedCount();
+	if (dropped > 0)
+		WARN("INPUT_SYSTEM - Event ring full, dropped %u events", dropped);
+
+	input.cursorCaptured = input.focused && cursorDisabled;
+
+	if (!input.cursorCaptured)
+		input.mouseDelta = {0.0f, 0.0f};
+}
+
+void InputSystem::toggleCursor()
+{
+	cursorDisabled = !cursorDisabled;
+
+	if (window == nullptr)
+		return;
+
+	glfwSetInputMode(window, GLFW_CURSOR, cursorDisabled ? GLFW_CURSOR_DISABLED : GLFW_CURSOR_NORMAL);
 
 	if (glfwRawMouseMotionSupported() && glfwGetInputMode(window, GLFW_RAW_MOUSE_MOTION) == GLFW_TRUE)
 		glfwSetInputMode(window, GLFW_RAW_MOUSE_MOTION, GLFW_FALSE);
@@ -34,19 +94,35 @@ void InputSystem::toggleCursor(GLFWwindow * window)
 
 	glfwGetCursorPos(window, &x, &y);
 
-	mousePosition[0] = x;
-	mousePosition[1] = y;
+	// The cursor jumps when its mode changes, measure further movement from here. Goes
+	// through the ring so a recording sees it in order with the other events
+	events.push({InputCursorWarp, 0, (float) x, (float) y});
 }
 
-void InputSystem::onWindowCreate(Message * msg)
+bool InputSystem::nextEvent(InputEvent & event)
 {
-	GLFWwindow * window = (GLFWwindow *) (dynamic_cast<PointerMessage *> (msg))->data;
+	Replay & replay = app->replay;
+
+	if (replay.isPlaying())
+		return replay.nextInput(event);
+
+	if (!events.pop(event))
+		return false;
+
+	replay.recordInput(event);
+	return true;
+}
+
+void InputSystem::onWindowCreate(GLFWwindow * window)
+{
+	this->window = window;
 
 	glfwSetWindowUserPointer(window, this);
 
 	glfwSetKeyCallback(window, (GLFWkeyfun) &InputSystem::keyCallback);
 
 	glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
+	cursorDisabled = true;
 
 	if (glfwRawMouseMotionSupported())
 		glfwSetInputMode(window, GLFW_RAW_MOUSE_MOTION, GLFW_TRUE);
@@ -56,64 +132,42 @@ void InputSystem::onWindowCreate(Message * msg)
 
 	glfwSetWindowFocusCallback(window, &InputSystem::windowFocusCallback);
 
-	toggleCursor(window);
+	toggleCursor();
 }
 
 void InputSystem::keyCallback(GLFWwindow * window, int key, int scancode, int action, int mods)
 {
 	InputSystem * inputSystem = (InputSystem *) glfwGetWindowUserPointer(window);
+	inputSystem->app->clock.markInput();
 
 	if (action == GLFW_PRESS)
-	{
-		if (key == '`')
-			inputSystem->toggleCursor(window);
-
-		inputSystem->keyCodes[key] = true;
-		inputSystem->app->sendMessageNow(KeyPress, key);
-	}
+		inputSystem->events.push({InputKeyPress, key, 0.0f, 0.0f});
 	else if (action == GLFW_RELEASE)
-	{
-		inputSystem->keyCodes[key] = false;
-		inputSystem->app->sendMessageNow(KeyRelease, key);
-	}
+		inputSystem->events.push({InputKeyRelease, key, 0.0f, 0.0f});
 }
 
 void InputSystem::cursorPositionCallback(GLFWwindow * window, double xpos, double ypos)
 {
 	InputSystem * inputSystem = (InputSystem *) glfwGetWindowUserPointer(window);
+	inputSystem->app->clock.markInput();
 
-	inputSystem->mouseDelta[0] = xpos - inputSystem->mousePosition[0];
-	inputSystem->mouseDelta[1] = ypos - inputSystem->mousePosition[1];
-
-	if (glfwGetWindowAttrib(window, GLFW_FOCUSED) == GLFW_TRUE && glfwGetInputMode(window, GLFW_CURSOR) == GLFW_CURSOR_DISABLED)
-		inputSystem->app->sendMessageNow(SetMouseDelta, inputSystem->mouseDelta, 2);
-
-	inputSystem->mousePosition[0] = xpos;
-	inputSystem->mousePosition[1] = ypos;
-
-	if (glfwGetWindowAttrib(window, GLFW_FOCUSED) == GLFW_TRUE)
-		inputSystem->app->sendMessageNow(SetMouseCursor, inputSystem->mousePosition, 2);
+	inputSystem->events.push({InputCursorMove, 0, (float) xpos, (float) ypos});
 }
 
 void InputSystem::mouseButtonCallback(GLFWwindow * window, int button, int action, int mods)
 {
 	InputSystem * inputSystem = (InputSystem *) glfwGetWindowUserPointer(window);
+	inputSystem->app->clock.markInput();
 
 	if (action == GLFW_PRESS)
-	{
-		inputSystem->mouseButtonCodes[button] = true;
-		inputSystem->app->sendMessageNow(MouseButtonPress, button);
-	}
+		inputSystem->events.push({InputMouseButtonPress, button, 0.0f, 0.0f});
 	else if (action == GLFW_RELEASE)
-	{
-		inputSystem->mouseButtonCodes[button] = false;
-		inputSystem->app->sendMessageNow(MouseButtonRelease, button);
-	}
+		inputSystem->events.push({InputMouseButtonRelease, button, 0.0f, 0.0f});
 }
 
 void InputSystem::windowFocusCallback(GLFWwindow* window, int focused)
 {
 	InputSystem * inputSystem = (InputSystem *) glfwGetWindowUserPointer(window);
 
-	inputSystem->app->sendMessageNow(SetWindowFocus, focused);
+	inputSystem->events.push({InputFocus, focused, 0.0f, 0.0f});
 }
\ No newline at end of file
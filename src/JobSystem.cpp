@@ -0,0 +1,277 @@
+#include <system/JobSystem.h>
+#include <system/Profiler.h>
+
+// ===============================================================================================================
+//                                               Task Graph
+// ===============================================================================================================
+
+Task * TaskGraph::addTask(std::function<void()> work, bool mainThreadOnly)
+{
+	tasks.emplace_back();
+
+	Task * task = &tasks.back();
+	task->work = std::move(work);
+	task->mainThreadOnly = mainThreadOnly;
+	task->graph = this;
+
+	return task;
+}
+
+void TaskGraph::precede(Task * before, Task * after)
+{
+	VALIDATE(before->graph == this && after->graph == this, "JOB_SYSTEM - Tasks belong to a different graph");
+
+	before->successors.push_back(after);
+	after->dependencyCount++;
+}
+
+void TaskGraph::clear()
+{
+	tasks.clear();
+}
+
+// ===============================================================================================================
+//                                               Work Queue
+// ===============================================================================================================
+
+void JobSystem::WorkQueue::pushBack(Task * task)
+{
+	if (count == tasks.size())
+	{
+		// Unwrap into a larger ring, capacity stays a power of two
+		tagged_vector<Task *, MemoryTagJobs> grown(tasks.size() * 2);
+		for (size_t i = 0; i < count; i++)
+			grown[i] = tasks[(head + i) & (tasks.size() - 1)];
+
+		tasks.swap(grown);
+		head = 0;
+	}
+
+	tasks[(head + count) & (tasks.size() - 1)] = task;
+	count++;
+}
+
+Task * JobSystem::WorkQueue::popBack()
+{
+	count--;
+	return tasks[(head + count) & (tasks.size() - 1)];
+}
+
+Task * JobSystem::WorkQueue::popFront()
+{
+	Task * task = tasks[head];
+	head = (head + 1) & (tasks.size() - 1);
+	count--;
+
+	return task;
+}
+
+// ===============================================================================================================
+//                                               Job System
+// ===============================================================================================================
+
+JobSystem::JobSystem(uint32_t workerCount)
+{
+	queuedTasks.store(0, std::memory_order_relaxed);
+	running.store(true, std::memory_order_relaxed);
+
+	for (uint32_t i = 0; i < workerCount + 1; i++)
+		queues.emplace_back(new WorkQueue());
+
+	for (uint32_t i = 1; i < workerCount + 1; i++)
+		workers.emplace_back(&JobSystem::workerLoop, this, i);
+
+	DEBUG("JOB_SYSTEM - Job System Created with %u workers", workerCount);
+}
+
+JobSystem::~JobSystem()
+{
+	{
+		std::lock_guard<std::mutex> lock(sleepMutex);
+		running.store(false, std::memory_order_release);
+	}
+	wake.notify_all();
+
+	for (auto& worker : workers)
+		worker.join();
+
+	DEBUG("JOB_SYSTEM - Job System Destroyed");
+}
+
+uint32_t JobSystem::defaultWorkerCount()
+{
+	uint32_t cores = std::thread::hardware_concurrency();
+
+	// The main thread is the remaining core
+	return (cores > 1) ? cores - 1 : 0;
+}
+
+void JobSystem::run(TaskGraph & graph)
+{
+	if (graph.tasks.empty())
+		return;
+
+	if (serial)
+	{
+		runSerial(graph);
+		return;
+	}
+
+	graph.remaining.store((uint32_t) graph.tasks.size(), std::memory_order_relaxed);
+	graph.exception = nullptr;
+
+	for (auto& task : graph.tasks)
+		task.pending.store(task.dependencyCount, std::memory_order_relaxed);
+
+	for (auto& task : graph.tasks)
+		if (task.dependencyCount == 0)
+			submit(&task, 0);
+
+	// The calling thread works through the graph alongside the workers
+	while (graph.remaining.load(std::memory_order_acquire) > 0)
+	{
+		Task * task = popMainThread();
+
+		if (task == nullptr) task = pop(0);
+		if (task == nullptr) task = steal(0);
+
+		if (task != nullptr)
+			execute(task, 0);
+		else
+			std::this_thread::yield();
+	}
+
+	if (graph.exception)
+		std::rethrow_exception(graph.exception);
+}
+
+// Tasks run in the order they were added, the same order every frame
+void JobSystem::runSerial(TaskGraph & graph)
+{
+	for (auto& task : graph.tasks)
+		task.pending.store(task.dependencyCount, std::memory_order_relaxed);
+
+	for (auto& task : graph.tasks)
+	{
+		VALIDATE(task.pending.load(std::memory_order_relaxed) == 0, "JOB_SYSTEM - Task added before one of its dependencies, can't run serially");
+
+		task.work();
+
+		for (auto& successor : task.successors)
+			successor->pending.fetch_sub(1, std::memory_order_relaxed);
+	}
+}
+
+void JobSystem::workerLoop(uint32_t index)
+{
+	Profiler::setThreadName("Worker " + std::to_string(index));
+
+	while (running.load(std::memory_order_acquire))
+	{
+		Task * task = pop(index);
+
+		if (task == nullptr)
+			task = steal(index);
+
+		if (task != nullptr)
+		{
+			execute(task, index);
+			continue;
+		}
+
+		std::unique_lock<std::mutex> lock(sleepMutex);
+		wake.wait(lock, [this] { return queuedTasks.load(std::memory_order_acquire) > 0 || !running.load(std::memory_order_acquire); });
+	}
+}
+
+void JobSystem::submit(Task * task, uint32_t index)
+{
+	if (task->mainThreadOnly)
+	{
+		// The main thread spins in run() until the graph finishes, no wake up needed
+		std::lock_guard<std::mutex> lock(mainThreadQueue.mutex);
+		mainThreadQueue.pushBack(task);
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(queues[index]->mutex);
+		queues[index]->pushBack(task);
+	}
+
+	queuedTasks.fetch_add(1, std::memory_order_release);
+
+	// Taking the lock orders this notify after a sleeping worker's predicate check
+	{
+		std::lock_guard<std::mutex> lock(sleepMutex);
+	}
+	wake.notify_one();
+}
+
+Task * JobSystem::pop(uint32_t index)
+{
+	WorkQueue & queue = *queues[index];
+	std::lock_guard<std::mutex> lock(queue.mutex);
+
+	if (queue.empty())
+		return nullptr;
+
+	Task * task = queue.popBack();
+	queuedTasks.fetch_sub(1, std::memory_order_relaxed);
+
+	return task;
+}
+
+Task * JobSystem::steal(uint32_t index)
+{
+	for (size_t i = 1; i < queues.size(); i++)
+	{
+		WorkQueue & victim = *queues[(index + i) % queues.size()];
+		std::lock_guard<std::mutex> lock(victim.mutex);
+
+		if (victim.empty())
+			continue;
+
+		Task * task = victim.popFront();
+		queuedTasks.fetch_sub(1, std::memory_order_relaxed);
+
+		return task;
+	}
+
+	return nullptr;
+}
+
+Task * JobSystem::popMainThread()
+{
+	std::lock_guard<std::mutex> lock(mainThreadQueue.mutex);
+
+	if (mainThreadQueue.empty())
+		return nullptr;
+
+	Task * task = mainThreadQueue.popFront();
+
+	return task;
+}
+
+void JobSystem::execute(Task * task, uint32_t index)
+{
+	TaskGraph * graph = task->graph;
+
+	try
+	{
+		task->work();
+	}
+	catch (...)
+	{
+		// Keep releasing successors so the graph still drains, the caller of run() rethrows
+		std::lock_guard<std::mutex> lock(graph->exceptionMutex);
+		if (!graph->exception)
+			graph->exception = std::current_exception();
+	}
+
+	for (auto& successor : task->successors)
+		if (successor->pending.fetch_sub(1, std::memory_order_acq_rel) == 1)
+			submit(successor, index);
+
+	graph->remaining.fetch_sub(1, std::memory_order_release);
+}
\ No newline at end of file
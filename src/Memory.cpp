@@ -0,0 +1,215 @@
+#include <system/Memory.h>
+
+#include <cstdlib>
+
+static const char * memoryTagNames[] =
+{
+	"General",
+	"Frame",
+	"Pool",
+	"Geometry",
+	"Textures",
+	"Models",
+	"GUI",
+	"Jobs",
+	"Entities"
+};
+
+static_assert(sizeof(memoryTagNames) / sizeof(memoryTagNames[0]) == MemoryTagCount, "memoryTagNames is out of sync with MemoryTag");
+
+// ===============================================================================================================
+//                                              Memory Manager
+// ===============================================================================================================
+
+struct alignas(MEMORY_DEFAULT_ALIGNMENT) AllocationHeader
+{
+	uint64_t size;
+	uint32_t tag;
+};
+
+static_assert(sizeof(AllocationHeader) == MEMORY_DEFAULT_ALIGNMENT, "AllocationHeader must keep blocks aligned");
+
+MemoryTagStats MemoryManager::stats[MemoryTagCount];
+
+void * MemoryManager::allocate(size_t size, MemoryTag tag)
+{
+	AllocationHeader * header = static_cast<AllocationHeader *>(std::malloc(sizeof(AllocationHeader) + size));
+
+	if (header == nullptr)
+		throw std::bad_alloc();
+
+	header->size = size;
+	header->tag = tag;
+
+	MemoryTagStats & tagStats = stats[tag];
+	uint64_t bytes = tagStats.bytes.fetch_add(size, std::memory_order_relaxed) + size;
+	tagStats.allocations.fetch_add(1, std::memory_order_relaxed);
+	tagStats.liveAllocations.fetch_add(1, std::memory_order_relaxed);
+
+	uint64_t peak = tagStats.peakBytes.load(std::memory_order_relaxed);
+	while (bytes > peak && !tagStats.peakBytes.compare_exchange_weak(peak, bytes, std::memory_order_relaxed));
+
+	return header + 1;
+}
+
+void MemoryManager::deallocate(void * pointer)
+{
+	if (pointer == nullptr)
+		return;
+
+	AllocationHeader * header = static_cast<AllocationHeader *>(pointer) - 1;
+
+	MemoryTagStats & tagStats = stats[header->tag];
+	tagStats.bytes.fetch_sub(header->size, std::memory_order_relaxed);
+	tagStats.liveAllocations.fetch_sub(1, std::memory_order_relaxed);
+
+	std::free(header);
+}
+
+const char * MemoryManager::getTagName(MemoryTag tag)
+{
+	return (tag < MemoryTagCount) ? memoryTagNames[tag] : "Unknown";
+}
+
+#ifdef KOI_TRACK_ALLOCATIONS
+
+// Counts every allocation that bypasses the MemoryManager. Debug builds only, replacing the
+// global operator new costs an atomic add per allocation
+static std::atomic<uint64_t> globalAllocationCount(0);
+
+void * operator new(size_t size)
+{
+	globalAllocationCount.fetch_add(1, std::memory_order_relaxed);
+
+	void * pointer = std::malloc(size == 0 ? 1 : size);
+	if (pointer == nullptr)
+		throw std::bad_alloc();
+
+	return pointer;
+}
+
+void operator delete(void * pointer) noexcept
+{
+	std::free(pointer);
+}
+
+void operator delete(void * pointer, size_t size) noexcept
+{
+	std::free(pointer);
+}
+
+uint64_t MemoryManager::getGlobalAllocationCount()
+{
+	return globalAllocationCount.load(std::memory_order_relaxed);
+}
+
+#else
+
+uint64_t MemoryManager::getGlobalAllocationCount()
+{
+	return 0;
+}
+
+#endif
+
+// ===============================================================================================================
+//                                               Frame Arena
+// ===============================================================================================================
+
+FrameArena::FrameArena(size_t capacity)
+{
+	this->capacity = capacity;
+	this->memory = static_cast<unsigned char *>(MemoryManager::allocate(capacity, MemoryTagFrame));
+	this->offset.store(0, std::memory_order_relaxed);
+}
+
+FrameArena::~FrameArena()
+{
+	MemoryManager::deallocate(memory);
+}
+
+void * FrameArena::allocate(size_t size, size_t alignment)
+{
+	size_t current = offset.load(std::memory_order_relaxed);
+
+	while (true)
+	{
+		size_t aligned = (current + alignment - 1) & ~(alignment - 1);
+
+		if (aligned + size > capacity)
+			return nullptr;
+
+		if (offset.compare_exchange_weak(current, aligned + size, std::memory_order_relaxed))
+			return memory + aligned;
+	}
+}
+
+void FrameArena::reset()
+{
+	size_t used = offset.exchange(0, std::memory_order_relaxed);
+
+	if (used > peak)
+		peak = used;
+}
+
+// ===============================================================================================================
+//                                               Object Pool
+// ===============================================================================================================
+
+ObjectPool::ObjectPool(size_t blockSize, size_t blocksPerChunk)
+{
+	if (blockSize < sizeof(FreeBlock))
+		blockSize = sizeof(FreeBlock);
+
+	this->blockSize = (blockSize + MEMORY_DEFAULT_ALIGNMENT - 1) & ~((size_t) MEMORY_DEFAULT_ALIGNMENT - 1);
+	this->blocksPerChunk = blocksPerChunk;
+}
+
+ObjectPool::~ObjectPool()
+{
+	if (liveCount > 0)
+		WARN("MEMORY - Object pool destroyed with %zu live objects", liveCount);
+
+	for (auto& chunk : chunks)
+		MemoryManager::deallocate(chunk);
+}
+
+void * ObjectPool::allocate()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+
+	if (freeList == nullptr)
+		grow();
+
+	FreeBlock * block = freeList;
+	freeList = block->next;
+	liveCount++;
+
+	return block;
+}
+
+void ObjectPool::deallocate(void * pointer)
+{
+	if (pointer == nullptr)
+		return;
+
+	std::lock_guard<std::mutex> lock(mutex);
+
+	FreeBlock * block = static_cast<FreeBlock *>(pointer);
+	block->next = freeList;
+	freeList = block;
+	liveCount--;
+}
+
+void ObjectPool::grow()
+{
+	unsigned char * chunk = static_cast<unsigned char *>(MemoryManager::allocate(blockSize * blocksPerChunk, MemoryTagPool));
+	chunks.push_back(chunk);
+
+	for (size_t i = blocksPerChunk; i > 0; i--)
+	{
+		FreeBlock * block = reinterpret_cast<FreeBlock *>(chunk + (i - 1) * blockSize);
+		block->next = freeList;
+		freeList = block;
+	}
+}
\ No newline at end of file
@@ -0,0 +1,91 @@
+#include <system/MessageQueue.h>
+
+MessageQueue::MessageQueue(uint32_t capacity) : cells(capacity)
+{
+	VALIDATE(capacity > 0 && (capacity & (capacity - 1)) == 0, "MESSAGE_QUEUE - Capacity must be a power of two %u", capacity);
+
+	this->capacity = capacity;
+	this->mask = capacity - 1;
+
+	for (size_t i = 0; i < cells.size(); i++)
+		cells[i].sequence.store(i, std::memory_order_relaxed);
+
+	enqueuePosition.store(0, std::memory_order_relaxed);
+	dequeuePosition = 0;
+	dropped.store(0, std::memory_order_relaxed);
+}
+
+MessageQueue::~MessageQueue()
+{
+
+}
+
+MessageCell * MessageQueue::reserve()
+{
+	size_t position = enqueuePosition.load(std::memory_order_relaxed);
+
+	while (true)
+	{
+		MessageCell * cell = &cells[position & mask];
+		size_t sequence = cell->sequence.load(std::memory_order_acquire);
+		intptr_t difference = (intptr_t) sequence - (intptr_t) position;
+
+		if (difference == 0)
+		{
+			if (enqueuePosition.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+				return cell;
+		}
+		else if (difference < 0)
+		{
+			// The consumer has not released this cell yet, queue is full
+			return nullptr;
+		}
+		else
+		{
+			position = enqueuePosition.load(std::memory_order_relaxed);
+		}
+	}
+}
+
+void MessageQueue::publish(MessageCell * cell)
+{
+	size_t position = cell->sequence.load(std::memory_order_relaxed);
+	cell->sequence.store(position + 1, std::memory_order_release);
+}
+
+MessageHeader * MessageQueue::front()
+{
+	return peek(0);
+}
+
+MessageHeader * MessageQueue::peek(uint32_t offset)
+{
+	if (offset >= capacity)
+		return nullptr;
+
+	size_t position = dequeuePosition + offset;
+	MessageCell * cell = &cells[position & mask];
+	size_t sequence = cell->sequence.load(std::memory_order_acquire);
+
+	// Either empty or the producer that reserved this cell is still writing it
+	if (sequence != position + 1)
+		return nullptr;
+
+	return reinterpret_cast<MessageHeader *> (cell->slot.data);
+}
+
+void MessageQueue::pop()
+{
+	MessageCell * cell = &cells[dequeuePosition & mask];
+
+	cell->sequence.store(dequeuePosition + capacity, std::memory_order_release);
+
+	dequeuePosition++;
+}
+
+uint32_t MessageQueue::size() const
+{
+	size_t position = enqueuePosition.load(std::memory_order_relaxed);
+
+	return (position > dequeuePosition) ? (uint32_t) (position - dequeuePosition) : 0;
+}
\ No newline at end of file
@@ -0,0 +1,154 @@
+#include <system/MessageStats.h>
+
+#ifdef KOI_MESSAGE_STATS
+
+#include <typeinfo>
+#include <cxxabi.h>
+#include <cstdlib>
+
+#include <system/System.h>
+
+static const char * messageTypeNames[] =
+{
+	"Initialize",
+	"Shutdown",
+	"Update",
+	"Exit",
+	"SystemRegistered",
+	"ConsolePause",
+	"ConsoleResume",
+	"GLFWwindowCreated",
+	"LoadScene",
+	"SceneLoaded",
+	"SceneDestroyed",
+	"KeyPress",
+	"KeyRelease",
+	"MouseButtonPress",
+	"MouseButtonRelease",
+	"SetWindowFocus",
+	"SetCameraPosition",
+	"SetCameraDirection",
+	"SetLighting",
+	"GetModelData",
+	"AddModel",
+	"SetFrameLimit",
+	"SpawnInstance"
+};
+
+static_assert(sizeof(messageTypeNames) / sizeof(messageTypeNames[0]) == MessageTypeCount, "messageTypeNames is out of sync with MessageType");
+
+// ===============================================================================================================
+//                                              Timing Stats
+// ===============================================================================================================
+
+uint32_t MessageTimingStats::getBucket(uint64_t nanoseconds)
+{
+	uint64_t microseconds = nanoseconds / 1000;
+
+	uint32_t bucket = 0;
+	while (microseconds > 0 && bucket < MESSAGE_STATS_BUCKET_COUNT - 1)
+	{
+		microseconds >>= 1;
+		bucket++;
+	}
+
+	return bucket;
+}
+
+void MessageTimingStats::record(uint64_t nanoseconds)
+{
+	count++;
+	totalNanoseconds += nanoseconds;
+
+	if (nanoseconds > maxNanoseconds)
+		maxNanoseconds = nanoseconds;
+
+	histogram[getBucket(nanoseconds)]++;
+}
+
+void MessageTimingStats::add(const MessageTimingStats & other)
+{
+	count += other.count;
+	totalNanoseconds += other.totalNanoseconds;
+
+	if (other.maxNanoseconds > maxNanoseconds)
+		maxNanoseconds = other.maxNanoseconds;
+
+	for (uint32_t i = 0; i < MESSAGE_STATS_BUCKET_COUNT; i++)
+		histogram[i] += other.histogram[i];
+}
+
+void MessageTimingStats::reset()
+{
+	*this = MessageTimingStats();
+}
+
+// ===============================================================================================================
+//                                             Message Stats
+// ===============================================================================================================
+
+MessageStats::MessageStats()
+{
+
+}
+
+uint32_t MessageStats::registerHandler(System * system, MessageType type)
+{
+	for (uint32_t i = 0; i < handlers.size(); i++)
+		if (handlers[i].system == system && handlers[i].type == type)
+			return i;
+
+	MessageHandlerStats handler = {};
+	handler.system = system;
+	handler.type = type;
+
+	int status = 0;
+	const char * mangled = typeid(*system).name();
+	char * demangled = abi::__cxa_demangle(mangled, nullptr, nullptr, &status);
+
+	handler.name = std::string((status == 0) ? demangled : mangled) + "::" + getMessageTypeName(type);
+	std::free(demangled);
+
+	handlers.push_back(handler);
+
+	return (uint32_t) handlers.size() - 1;
+}
+
+void MessageStats::recordDispatch(MessageType type, uint64_t nanoseconds)
+{
+	frame[type].record(nanoseconds);
+}
+
+void MessageStats::recordHandler(uint32_t handler, uint64_t nanoseconds)
+{
+	handlers[handler].frame.record(nanoseconds);
+}
+
+void MessageStats::recordHandler(System * system, MessageType type, uint64_t nanoseconds)
+{
+	recordHandler(registerHandler(system, type), nanoseconds);
+}
+
+void MessageStats::endFrame()
+{
+	for (uint32_t i = 0; i < MessageTypeCount; i++)
+	{
+		total[i].add(frame[i]);
+		lastFrame[i] = frame[i];
+		frame[i].reset();
+	}
+
+	for (auto& handler : handlers)
+	{
+		handler.total.add(handler.frame);
+		handler.lastFrame = handler.frame;
+		handler.frame.reset();
+	}
+}
+
+const char * MessageStats::getMessageTypeName(MessageType type)
+{
+	return (type < MessageTypeCount) ? messageTypeNames[type] : "Unknown";
+}
+
+#endif
\ No newline at end of file
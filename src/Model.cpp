@@ -1,18 +1,14 @@
+#include <atomic>
 #include <cstring>
+#include <cstdlib>
+#include <algorithm>
 
 #include <render/Utilities.h>
 #include <render/Model.h>
 
 uint32_t Texture::count;
 VkSampler Texture::sampler;
-
-uint32_t Model::count;
-VkPipelineLayout Model::pipelineLayout;
-VkPipeline Model::pipeline;
-
-uint32_t TexturedModel::count;
-VkPipelineLayout TexturedModel::pipelineLayout;
-VkPipeline TexturedModel::pipeline;
+std::mutex Texture::samplerMutex;
 
 void Vertex::getAttributeDescriptions(uint32_t binding, std::vector<VkVertexInputAttributeDescription> & attribDesc)
 {
@@ -103,28 +99,120 @@ ModelBase::~ModelBase()
 {
     for (auto & shape : shapes)
 	{
-        vkDestroyDescriptorSetLayout(context->device, shape.descriptorSetLayout, nullptr);
-		vkDestroyBuffer(context->device, shape.vertexBuffer, nullptr);
-		vkFreeMemory(context->device, shape.vertexMemory, nullptr);
-		vkDestroyBuffer(context->device, shape.indexBuffer, nullptr);
-		vkFreeMemory(context->device, shape.indexMemory, nullptr);
+		scene->geometry.free(GeometryVertices, shape.vertexRange);
+		scene->geometry.free(GeometryIndices, shape.indexRange);
 	}
 
 	for (auto & material : materials)
 	{
 		for (auto & buffer : material.buffers)
 		{
-			vkDestroyBuffer(context->device, buffer.buffer, nullptr);
-			vkFreeMemory(context->device, buffer.memory, nullptr);			
+			destroyBuffer(context, buffer.buffer, buffer.allocation);
 		}
 	}
 
-	vkDestroyBuffer(context->device, this->instanceBuffer, nullptr);
-	vkFreeMemory(context->device, this->instanceMemory, nullptr);
-
     vkDestroyDescriptorPool(context->device, this->descriptorPool, nullptr);
 }
 
+void ModelBase::computeBounds()
+{
+	bool empty = true;
+
+	for (auto & shape : shapes)
+	{
+		for (auto & vertex : shape.vertices)
+		{
+			boundsMin = empty ? vertex.data.position : glm::min(boundsMin, vertex.data.position);
+			boundsMax = empty ? vertex.data.position : glm::max(boundsMax, vertex.data.position);
+			empty = false;
+		}
+	}
+}
+
+void ModelBase::uploadGeometry()
+{
+	for (auto & shape : shapes)
+	{
+		UploadTicket vertices, indices;
+
+		shape.vertexRange = scene->geometry.upload(GeometryVertices, shape.vertices.data(), shape.vertices.size(), &vertices);
+		shape.indexRange = scene->geometry.upload(GeometryIndices, shape.indices.data(), shape.indices.size(), &indices);
+
+		upload = std::max(upload, std::max(vertices, indices));
+	}
+}
+
+void ModelBase::requestPipelines(uint32_t shaderFeatures)
+{
+	PipelineState state;
+	state.vertexShader = "shader.vert";
+	state.fragmentShader = "shader.frag";
+	state.samples = renderer->sample_count;
+	state.extent = renderer->extent;
+	state.renderPass = scene->renderPass;
+	state.layout = pipelineLayout;
+
+	for (auto & shape : shapes)
+	{
+		MaterialData & material = materials[shape.materialID].data;
+
+		// Blended shapes still test against depth but leave it for what's behind them
+		bool blended = material.opacity < 1.0f;
+		bool specular = glm::any(glm::greaterThan(material.specular, Vec3(0.0f)));
+
+		state.blendMode = blended ? PipelineBlendAlpha : PipelineBlendOpaque;
+		state.depthWrite = blended ? VK_FALSE : VK_TRUE;
+
+		state.shaderFeatures = shaderFeatures;
+		if (specular) state.shaderFeatures |= PipelineFeatureSpecular;
+		if (blended) state.shaderFeatures |= PipelineFeatureAlpha;
+
+		shape.pipeline = scene->pipelines.request(state);
+		shape.blended = blended;
+	}
+
+	// Wrapping past the key's bits only costs some grouping, never correctness
+	static std::atomic<uint32_t> nextSortID(0);
+
+	for (auto & shape : shapes)
+		shape.sortID = nextSortID++;
+
+	for (auto & material : materials)
+		material.sortID = nextSortID++;
+}
+
+void ModelBase::enqueue(RenderQueue & queue, uint32_t firstInstance, uint32_t instanceCount, float depth)
+{
+	// Still on its way to the GPU, shows up once the transfer queue is done with it
+	if (!context->uploads.isComplete(upload))
+		return;
+
+	for (auto & shape : shapes)
+	{
+		// Still compiling, the shape shows up once its pipeline is ready
+		VkPipeline pipeline = scene->pipelines.get(shape.pipeline);
+		if (pipeline == VK_NULL_HANDLE || shape.indexRange.count == 0)
+			continue;
+
+		Material & material = materials[shape.materialID];
+
+		DrawPacket packet;
+		packet.pipeline = pipeline;
+		packet.layout = pipelineLayout;
+		packet.material = material.descriptorSets[renderer->currentImageIndex];
+		packet.vertexBuffer = shape.vertexRange.buffer;
+		packet.indexBuffer = shape.indexRange.buffer;
+		packet.vertexOffset = shape.vertexRange.first;
+		packet.firstIndex = shape.indexRange.first;
+		packet.indexCount = shape.indexRange.count;
+		packet.firstInstance = firstInstance;
+		packet.instanceCount = instanceCount;
+
+		RenderQueuePass pass = shape.blended ? RenderQueueBlended : RenderQueueOpaque;
+		queue.push(RenderQueue::makeKey(pass, shape.pipeline, material.sortID, shape.sortID, depth), packet);
+	}
+}
+
 Model::Model(std::string filename, std::string location, Context * context, Renderer * renderer, Scene * scene) : ModelBase(context, renderer, scene)
 {
     // ===== Load Model Data =====
@@ -133,44 +221,38 @@ Model::Model(std::string filename, std::string location, Context * context, Rend
 
 	loadOBJ(filename, location, context, renderer, this, nullptr);
 
-	this->instances.resize(1);
+	computeBounds();
+
+    // ===== Upload Geometry =====
+
+	uploadGeometry();
 
     // ===== Create VkDescriptorPool =====
 
     VkDescriptorPoolSize poolSize;
     poolSize.type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-    poolSize.descriptorCount = renderer->length * shapes.size();
+    poolSize.descriptorCount = renderer->length * materials.size();
 
     VkDescriptorPoolCreateInfo poolInfo = {};
     poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
     poolInfo.pNext = nullptr;
     poolInfo.flags = 0;
-    poolInfo.maxSets = renderer->length * shapes.size();
+    poolInfo.maxSets = renderer->length * materials.size();
     poolInfo.poolSizeCount = 1;
     poolInfo.pPoolSizes = &poolSize;
 
     int result = vkCreateDescriptorPool(context->device, &poolInfo, nullptr, &this->descriptorPool);
     VALIDATE(result == VK_SUCCESS, "Failed to create VkDescriptorPool %d", result);
 
-    // ===== Create VkDescriptorSets (per shape) =====
-
-    for (auto& shape : shapes)
-    {
-        Material & m = materials[shape.materialID];
-
-	    VkDescriptorSetLayoutBinding binding = m.getVkDescriptorSetLayoutBinding(0);
+    // ===== Create VkDescriptorSets (per material) =====
 
-        VkDescriptorSetLayoutCreateInfo layoutInfo = {};
-        layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
-        layoutInfo.pNext = nullptr;
-        layoutInfo.flags = 0;
-        layoutInfo.bindingCount = 1;
-        layoutInfo.pBindings = &binding;
+    VkDescriptorSetLayout materialLayout = scene->pipelines.getDescriptorSetLayout({Material::getVkDescriptorSetLayoutBinding(0)});
 
-        result = vkCreateDescriptorSetLayout(context->device, &layoutInfo, nullptr, &shape.descriptorSetLayout);
-        VALIDATE(result == VK_SUCCESS, "Failed to create VkDescriptorSetLayout %d", result);
+    for (uint32_t j = 0; j < materials.size(); j++)
+    {
+        Material & m = materials[j];
 
-        std::vector<VkDescriptorSetLayout> layouts(renderer->length, shape.descriptorSetLayout);
+        std::vector<VkDescriptorSetLayout> layouts(renderer->length, materialLayout);
 
         VkDescriptorSetAllocateInfo allocInfo = {};
         allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
@@ -179,8 +261,8 @@ Model::Model(std::string filename, std::string location, Context * context, Rend
         allocInfo.descriptorSetCount = layouts.size();
         allocInfo.pSetLayouts = layouts.data();
 
-        shape.descriptorSets.resize(renderer->length);
-        result = vkAllocateDescriptorSets(context->device, &allocInfo, shape.descriptorSets.data());
+        m.descriptorSets.resize(renderer->length);
+        result = vkAllocateDescriptorSets(context->device, &allocInfo, m.descriptorSets.data());
         VALIDATE(result == VK_SUCCESS, "Failed to allocate VkDescriptorSets %d", result);
 
         std::vector<VkWriteDescriptorSet> descriptorWrites(renderer->length);
@@ -193,7 +275,7 @@ Model::Model(std::string filename, std::string location, Context * context, Rend
             bufferInfo.range = sizeof(MaterialData);
 
             descriptorWrites[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-            descriptorWrites[i].dstSet = shape.descriptorSets[i];
+            descriptorWrites[i].dstSet = m.descriptorSets[i];
             descriptorWrites[i].dstBinding = 0;
             descriptorWrites[i].dstArrayElement = 0;
             descriptorWrites[i].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
@@ -206,167 +288,67 @@ Model::Model(std::string filename, std::string location, Context * context, Rend
         vkUpdateDescriptorSets(context->device, descriptorWrites.size(), descriptorWrites.data(), 0, nullptr);
     }
 
-    // ===== Create Pipeline (On First Instantiation) =====
-
-    if (Model::count == 0)
-        this->createVkPipeline();
+    // ===== Request Pipelines =====
 
-    Model::count++;
+    this->pipelineLayout = scene->pipelines.getPipelineLayout({scene->descriptorSetLayout, materialLayout});
+    requestPipelines(0);
 }
 
 Model::~Model()
 {
-    Model::count--;
+}
 
-    if (Model::count == 0)
-    {
-        vkDestroyPipelineLayout(context->device, Model::pipelineLayout, nullptr);
-        vkDestroyPipeline(context->device, Model::pipeline, nullptr);
-    }
+
+Texture::Texture(std::string filename, Context * context, Renderer * renderer)
+{
+	this->context = context;
+
+	decode(filename);
+	create();
 }
 
-void Model::draw(VkCommandBuffer commandbuffer)
+Texture::Texture(Context * context)
 {
-	for (auto& shape : shapes)
-	{
-		VkDescriptorSet descriptors[] = {scene->descriptorSets[renderer->currentImageIndex], shape.descriptorSets[renderer->currentImageIndex]};
-		VkBuffer vertexBuffers[] = {shape.vertexBuffer, instanceBuffer};
-		VkDeviceSize offsets[] = {0, 0};
-
-        vkCmdBindPipeline(commandbuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, Model::pipeline);
-		vkCmdBindDescriptorSets(commandbuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 2, descriptors, 0, nullptr);
-		vkCmdBindVertexBuffers(commandbuffer, 0, 2, vertexBuffers, offsets);
-		vkCmdBindIndexBuffer(commandbuffer, shape.indexBuffer, 0, VK_INDEX_TYPE_UINT32);
-		vkCmdDrawIndexed(commandbuffer, shape.indices.size(), instances.size(), 0, 0, 0);
-	}
+	this->context = context;
 }
 
-void Model::createVkPipeline()
+Texture::~Texture()
 {
-    // ===== Pipeline Layout =====
+	// Decoded but never created
+	free(pixels.data);
+
+	if (image == VK_NULL_HANDLE)
+		return;
 
-    std::vector<VkDescriptorSetLayout> descriptorSetLayouts;
+	vkDestroyImageView(context->device, imageView, nullptr);
+	destroyVkImage(context, image, allocation);
 
-    for (auto& shape : shapes)
-        descriptorSetLayouts.push_back(shape.descriptorSetLayout);
+	std::lock_guard<std::mutex> lock(Texture::samplerMutex);
 
-    VkPipelineLayoutCreateInfo createInfo = {};
-	createInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-	createInfo.pNext = nullptr;
-	createInfo.flags = 0;
-	createInfo.setLayoutCount = descriptorSetLayouts.size();
-	createInfo.pSetLayouts = descriptorSetLayouts.data();
-	createInfo.pushConstantRangeCount = 0;
-	createInfo.pPushConstantRanges = nullptr;
-
-	VkPipelineLayout layout;
-	int result = vkCreatePipelineLayout(context->device, &createInfo, nullptr, &Model::pipelineLayout);
-	VALIDATE(result == VK_SUCCESS, "Failed to create pipeline layout %d", result);
-
-	// ===== Pipeline Shaders =====
-
-	std::vector<VkPipelineShaderStageCreateInfo> shaderStages(2);
-
-	VkShaderModule vertexShader = loadShader(context, "bin/vert.spv");
-	shaderStages[0].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-	shaderStages[0].stage = VK_SHADER_STAGE_VERTEX_BIT;
-	shaderStages[0].module = vertexShader;
-	shaderStages[0].pName = "main";
-
-	VkShaderModule fragmentShader = loadShader(context, "bin/frag.spv");
-	shaderStages[1].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-	shaderStages[1].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
-	shaderStages[1].module = fragmentShader;
-	shaderStages[1].pName = "main";
-
-	// ===== Pipeline Vertex Input Attributes =====
-
-	std::vector<VkVertexInputBindingDescription> bindingDesc(2);
-	std::vector<VkVertexInputAttributeDescription> attribDesc;
-
-	Vertex::getAttributeDescriptions(0, attribDesc);
-	bindingDesc[0].binding = 0;
-	bindingDesc[0].stride = sizeof(VertexData);
-	bindingDesc[0].inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
-
-	Instance::getAttributeDescriptions(1, attribDesc);
-	bindingDesc[1].binding = 1;
-	bindingDesc[1].stride = sizeof(InstanceData);
-	bindingDesc[1].inputRate = VK_VERTEX_INPUT_RATE_INSTANCE;
-
-	VkPipelineVertexInputStateCreateInfo vertexInputInfo = {};
-	vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
-	vertexInputInfo.vertexBindingDescriptionCount = bindingDesc.size();
-	vertexInputInfo.pVertexBindingDescriptions = bindingDesc.data();
-	vertexInputInfo.vertexAttributeDescriptionCount = attribDesc.size();
-	vertexInputInfo.pVertexAttributeDescriptions = attribDesc.data();
-
-	VkPipelineInputAssemblyStateCreateInfo inputAssembly = {};
-	inputAssembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
-	inputAssembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
-	inputAssembly.primitiveRestartEnable = VK_FALSE;
-
-	// ===== Pipeline Viewport =====
-
-	VkViewport viewport = renderer->getDefaultVkViewport();
-	VkRect2D scissor = renderer->getDefaultScissor();
-
-	VkPipelineViewportStateCreateInfo viewportState = {};
-	viewportState.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
-	viewportState.viewportCount = 1;
-	viewportState.pViewports = &viewport;
-	viewportState.scissorCount = 1;
-	viewportState.pScissors = &scissor;
-
-	// ===== Pipeline Rasterizer =====
-
-	VkPipelineRasterizationStateCreateInfo rasterizer = renderer->getDefaultRasterizer();
-
-	// ===== Pipeline Multisampling =====
-
-	VkPipelineMultisampleStateCreateInfo multisampling = renderer->getDefaultMultisampling();
-
-	// ===== Pipeline Depth Stencil =====
-
-	VkPipelineDepthStencilStateCreateInfo depthStencil = renderer->getDefaultDepthStencil();
-
-	// ===== Pipeline Color Blend =====
-
-	std::vector<VkPipelineColorBlendAttachmentState> colorBlendAttachments;
-	renderer->getDefaultColorBlendAttachments(colorBlendAttachments);
-	VkPipelineColorBlendStateCreateInfo colorBlending = renderer->getDefaultColorBlend(colorBlendAttachments);
-
-	// ===== Create Pipeline! =====
-	VkGraphicsPipelineCreateInfo pipelineInfo = {};
-	pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
-	pipelineInfo.stageCount = shaderStages.size();
-	pipelineInfo.pStages = shaderStages.data();
-	pipelineInfo.pVertexInputState = &vertexInputInfo;
-	pipelineInfo.pInputAssemblyState = &inputAssembly;
-	pipelineInfo.pViewportState = &viewportState;
-	pipelineInfo.pRasterizationState = &rasterizer;
-	pipelineInfo.pMultisampleState = &multisampling;
-	pipelineInfo.pDepthStencilState = &depthStencil;
-	pipelineInfo.pColorBlendState = &colorBlending;
-	pipelineInfo.pDynamicState = nullptr;
-	pipelineInfo.layout = pipelineLayout;
-	pipelineInfo.renderPass = scene->renderPass;
-	pipelineInfo.subpass = 0;
-	pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
-	pipelineInfo.basePipelineIndex = -1;
-
-	result = vkCreateGraphicsPipelines(context->device, nullptr, 1, &pipelineInfo, nullptr, &Model::pipeline);
-	VALIDATE(result == VK_SUCCESS, "Failed to create graphics pipeline %d", result);
+	Texture::count--;
+	if (Texture::count == 0)
+		vkDestroySampler(context->device, Texture::sampler, nullptr);
+}
 
-	vkDestroyShaderModule(context->device, vertexShader, nullptr);
-	vkDestroyShaderModule(context->device, fragmentShader, nullptr);
+void Texture::decode(std::string filename)
+{
+	decodeMeshTexture(filename, &pixels);
 }
 
-Texture::Texture(std::string filename, Context * context, Renderer * renderer)
+void Texture::decodeWhite()
 {
-	this->context = context;
+	pixels.data = (unsigned char *) malloc(4);
+	memset(pixels.data, 0xFF, 4);
+	pixels.extent = {1, 1};
+	pixels.size = 4;
+	pixels.format = VK_FORMAT_R8G8B8A8_UNORM;
+}
+
+void Texture::create()
+{
+	createMeshTexture(context, this);
 
-	loadMeshTexture(filename, context, renderer, this);
+	std::lock_guard<std::mutex> lock(Texture::samplerMutex);
 
 	if (Texture::count == 0)
 		createMeshTextureSampler(context->device, &Texture::sampler);
@@ -374,40 +356,80 @@ Texture::Texture(std::string filename, Context * context, Renderer * renderer)
 	Texture::count++;
 }
 
-Texture::~Texture()
+TexturedModel::TexturedModel(std::string filename, std::string location, Context * context, Renderer * renderer, Scene * scene) : ModelBase(context, renderer, scene)
 {
-	vkDestroyImage(context->device, image, nullptr);
-	vkDestroyImageView(context->device, imageView, nullptr);
-	vkFreeMemory(context->device, memory, nullptr);
+	parse(filename, location);
 
-	Texture::count--;
-	if (Texture::count == 0)
-		vkDestroySampler(context->device, Texture::sampler, nullptr);
+	for (uint32_t i = 0; i < textures.size(); i++)
+		decodeTexture(i);
+
+	createResources();
 }
 
-TexturedModel::TexturedModel(std::string filename, std::string location, Context * context, Renderer * renderer, Scene * scene) : ModelBase(context, renderer, scene)
+TexturedModel::TexturedModel(Context * context, Renderer * renderer, Scene * scene) : ModelBase(context, renderer, scene)
+{
+}
+
+void TexturedModel::parse(std::string filename, std::string location)
 {
     // ===== Load Model Data =====
 
 	this->name = filename;
-	
+
 	std::vector<std::string> texturenames;
 
 	loadOBJ(filename, location, context, renderer, this, &texturenames);
 
 	for (auto & texturename : texturenames)
-		this->textures.push_back(new Texture(location + texturename, context, renderer));
+	{
+		this->textures.push_back(new Texture(context));
+		this->textureFiles.push_back(location + texturename);
+	}
 
-	this->instances.resize(1);
+	// Materials that name no texture share a white one, they draw with their colors alone
+	uint32_t whiteID = MATERIAL_NO_TEXTURE;
 
-	// ===== Create Vertex/Index/Instance/Uniform Buffers =====
+	for (auto & material : materials)
+	{
+		if (material.textureID != MATERIAL_NO_TEXTURE)
+			continue;
 
-	for (auto & shape : shapes)
+		if (whiteID == MATERIAL_NO_TEXTURE)
+		{
+			whiteID = textures.size();
+			this->textures.push_back(new Texture(context));
+			this->textureFiles.push_back("");
+		}
+
+		material.textureID = whiteID;
+	}
+
+	computeBounds();
+}
+
+void TexturedModel::decodeTexture(uint32_t index)
+{
+	// No file for the white texture
+	if (textureFiles[index].empty())
+		textures[index]->decodeWhite();
+	else
+		textures[index]->decode(textureFiles[index]);
+}
+
+void TexturedModel::createResources()
+{
+	// ===== Create Textures =====
+
+	for (auto & texture : textures)
 	{
-		createVertexBuffer(context, shape.vertices, &shape.vertexBuffer, &shape.vertexMemory, &shape.vertexBufferSize);
-		createIndexBuffer(context, shape.indices, &shape.indexBuffer, &shape.indexMemory, &shape.indexBufferSize);
+		texture->create();
+		upload = std::max(upload, texture->upload);
 	}
 
+	// ===== Create Vertex/Index/Uniform Buffers =====
+
+	uploadGeometry();
+
 	for (auto & material : materials)
 	{
 		material.buffers.resize(renderer->length);
@@ -415,57 +437,45 @@ TexturedModel::TexturedModel(std::string filename, std::string location, Context
 		{
 			createBuffer(context, sizeof(MaterialData), VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
 						VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-						&material.buffers[i].buffer, &material.buffers[i].memory);
+						&material.buffers[i].buffer, &material.buffers[i].allocation);
 
-			vkMapMemory(context->device, material.buffers[i].memory, 0, sizeof(MaterialData), 0, &material.buffers[i].data);
+			material.buffers[i].data = material.buffers[i].allocation.mapped;
 			memcpy(material.buffers[i].data, &material.data, sizeof(MaterialData));
-			vkUnmapMemory(context->device, material.buffers[i].memory);
 		}   
 	}
 
-	createInstanceBuffer(context, this->instances, &this->instanceBuffer, &this->instanceMemory, &this->instanceBufferSize);
-
     // ===== Create VkDescriptorPool =====
 
     std::vector<VkDescriptorPoolSize> poolSizes(2);
     poolSizes[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-    poolSizes[0].descriptorCount = renderer->length * shapes.size();
+    poolSizes[0].descriptorCount = renderer->length * materials.size();
     poolSizes[1].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-    poolSizes[1].descriptorCount = renderer->length * shapes.size();
+    poolSizes[1].descriptorCount = renderer->length * materials.size();
 
     VkDescriptorPoolCreateInfo poolInfo = {};
     poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
     poolInfo.pNext = nullptr;
     poolInfo.flags = 0;
-    poolInfo.maxSets = renderer->length * shapes.size();
+    poolInfo.maxSets = renderer->length * materials.size();
     poolInfo.poolSizeCount = poolSizes.size();
     poolInfo.pPoolSizes = poolSizes.data();
 
     int result = vkCreateDescriptorPool(context->device, &poolInfo, nullptr, &this->descriptorPool);
     VALIDATE(result == VK_SUCCESS, "Failed to create VkDescriptorPool %d", result);
 
-    // ===== Create VkDescriptorSets (per shape) =====
+    // ===== Create VkDescriptorSets (per material) =====
 
-    for (auto& shape : shapes)
-    {
-        Material & m = materials[shape.materialID];
-        Texture * t = textures[shape.materialID];
-
-	    std::vector<VkDescriptorSetLayoutBinding> bindings(2);
-        bindings[0] = m.getVkDescriptorSetLayoutBinding(0);
-        bindings[1] = t->getVkDescriptorSetLayoutBinding(1);
+    std::vector<VkDescriptorSetLayoutBinding> bindings(2);
+    bindings[0] = Material::getVkDescriptorSetLayoutBinding(0);
+    bindings[1] = Texture::getVkDescriptorSetLayoutBinding(1);
 
-        VkDescriptorSetLayoutCreateInfo layoutInfo = {};
-        layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
-        layoutInfo.pNext = nullptr;
-        layoutInfo.flags = 0;
-        layoutInfo.bindingCount = bindings.size();
-        layoutInfo.pBindings = bindings.data();
+    VkDescriptorSetLayout materialLayout = scene->pipelines.getDescriptorSetLayout(bindings);
 
-        result = vkCreateDescriptorSetLayout(context->device, &layoutInfo, nullptr, &shape.descriptorSetLayout);
-        VALIDATE(result == VK_SUCCESS, "Failed to create VkDescriptorSetLayout %d", result);
+    for (auto & m : materials)
+    {
+        Texture * t = textures[m.textureID];
 
-        std::vector<VkDescriptorSetLayout> layouts(renderer->length, shape.descriptorSetLayout);
+        std::vector<VkDescriptorSetLayout> layouts(renderer->length, materialLayout);
 
         VkDescriptorSetAllocateInfo allocInfo = {};
         allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
@@ -474,8 +484,8 @@ TexturedModel::TexturedModel(std::string filename, std::string location, Context
         allocInfo.descriptorSetCount = layouts.size();
         allocInfo.pSetLayouts = layouts.data();
 
-        shape.descriptorSets.resize(renderer->length);
-        result = vkAllocateDescriptorSets(context->device, &allocInfo, shape.descriptorSets.data());
+        m.descriptorSets.resize(renderer->length);
+        result = vkAllocateDescriptorSets(context->device, &allocInfo, m.descriptorSets.data());
         VALIDATE(result == VK_SUCCESS, "Failed to allocate VkDescriptorSets %d", result);
 
         std::vector<VkWriteDescriptorSet> descriptorWrites(renderer->length * 2);
@@ -486,7 +496,7 @@ TexturedModel::TexturedModel(std::string filename, std::string location, Context
         imageInfo.sampler = Texture::sampler;
 
 
-        for (uint32_t i = 0; i < shape.descriptorSets.size(); i++)
+        for (uint32_t i = 0; i < m.descriptorSets.size(); i++)
         {
             VkDescriptorBufferInfo bufferInfo = {};
             bufferInfo.buffer = m.buffers[i].buffer;
@@ -494,7 +504,7 @@ TexturedModel::TexturedModel(std::string filename, std::string location, Context
             bufferInfo.range = sizeof(MaterialData);
 
             descriptorWrites[2*i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-            descriptorWrites[2*i].dstSet = shape.descriptorSets[i];
+            descriptorWrites[2*i].dstSet = m.descriptorSets[i];
             descriptorWrites[2*i].dstBinding = 0;
             descriptorWrites[2*i].dstArrayElement = 0;
             descriptorWrites[2*i].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
@@ -505,7 +515,7 @@ TexturedModel::TexturedModel(std::string filename, std::string location, Context
 
             	
             descriptorWrites[2*i+1].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-            descriptorWrites[2*i+1].dstSet = shape.descriptorSets[i];
+            descriptorWrites[2*i+1].dstSet = m.descriptorSets[i];
             descriptorWrites[2*i+1].dstBinding = 1;
             descriptorWrites[2*i+1].dstArrayElement = 0;
             descriptorWrites[2*i+1].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
@@ -518,163 +528,15 @@ TexturedModel::TexturedModel(std::string filename, std::string location, Context
         vkUpdateDescriptorSets(context->device, descriptorWrites.size(), descriptorWrites.data(), 0, nullptr);
     }
 
-    // ===== Create Pipeline (On First Instantiation) =====
+    // ===== Request Pipelines =====
 
-    if (TexturedModel::count == 0)
-	{
-        this->createVkPipeline();
-	}
-
-	TexturedModel::count++;
+    this->pipelineLayout = scene->pipelines.getPipelineLayout({scene->descriptorSetLayout, materialLayout});
+    requestPipelines(PipelineFeatureTextured);
 }
 
 TexturedModel::~TexturedModel()
 {
-    TexturedModel::count--;
-
 	for (auto & texture : textures)
 		delete texture;
-
-    if (TexturedModel::count == 0)
-    {
-        vkDestroyPipelineLayout(context->device, TexturedModel::pipelineLayout, nullptr);
-        vkDestroyPipeline(context->device, TexturedModel::pipeline, nullptr);
-    }
 }
 
-void TexturedModel::draw(VkCommandBuffer commandbuffer)
-{
-	for (auto& shape : shapes)
-	{
-		VkDescriptorSet descriptors[] = {scene->descriptorSets[renderer->currentImageIndex], shape.descriptorSets[renderer->currentImageIndex]};
-		VkBuffer vertexBuffers[] = {shape.vertexBuffer, instanceBuffer};
-		VkDeviceSize offsets[] = {0, 0};
-
-        vkCmdBindPipeline(commandbuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, TexturedModel::pipeline);
-		vkCmdBindDescriptorSets(commandbuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 2, descriptors, 0, nullptr);
-		vkCmdBindVertexBuffers(commandbuffer, 0, 2, vertexBuffers, offsets);
-		vkCmdBindIndexBuffer(commandbuffer, shape.indexBuffer, 0, VK_INDEX_TYPE_UINT32);
-		vkCmdDrawIndexed(commandbuffer, shape.indices.size(), instances.size(), 0, 0, 0);
-	}
-}
-
-void TexturedModel::createVkPipeline()
-{
-    // ===== Pipeline Layout =====
-
-    std::vector<VkDescriptorSetLayout> descriptorSetLayouts;
-
-    descriptorSetLayouts.push_back(scene->descriptorSetLayout);
-    descriptorSetLayouts.push_back(shapes[0].descriptorSetLayout);
-
-    VkPipelineLayoutCreateInfo createInfo = {};
-	createInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-	createInfo.pNext = nullptr;
-	createInfo.flags = 0;
-	createInfo.setLayoutCount = descriptorSetLayouts.size();
-	createInfo.pSetLayouts = descriptorSetLayouts.data();
-	createInfo.pushConstantRangeCount = 0;
-	createInfo.pPushConstantRanges = nullptr;
-
-	VkPipelineLayout layout;
-	int result = vkCreatePipelineLayout(context->device, &createInfo, nullptr, &TexturedModel::pipelineLayout);
-	VALIDATE(result == VK_SUCCESS, "Failed to create pipeline layout %d", result);
-
-	// ===== Pipeline Shaders =====
-
-	std::vector<VkPipelineShaderStageCreateInfo> shaderStages(2);
-
-	VkShaderModule vertexShader = loadShader(context, "bin/vert.spv");
-	shaderStages[0].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-	shaderStages[0].stage = VK_SHADER_STAGE_VERTEX_BIT;
-	shaderStages[0].module = vertexShader;
-	shaderStages[0].pName = "main";
-
-	VkShaderModule fragmentShader = loadShader(context, "bin/frag.spv");
-	shaderStages[1].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-	shaderStages[1].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
-	shaderStages[1].module = fragmentShader;
-	shaderStages[1].pName = "main";
-
-	// ===== Pipeline Vertex Input Attributes =====
-
-	std::vector<VkVertexInputBindingDescription> bindingDesc(2);
-	std::vector<VkVertexInputAttributeDescription> attribDesc;
-
-	Vertex::getAttributeDescriptions(0, attribDesc);
-	bindingDesc[0].binding = 0;
-	bindingDesc[0].stride = sizeof(VertexData);
-	bindingDesc[0].inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
-
-	Instance::getAttributeDescriptions(1, attribDesc);
-	bindingDesc[1].binding = 1;
-	bindingDesc[1].stride = sizeof(InstanceData);
-	bindingDesc[1].inputRate = VK_VERTEX_INPUT_RATE_INSTANCE;
-
-	VkPipelineVertexInputStateCreateInfo vertexInputInfo = {};
-	vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
-	vertexInputInfo.vertexBindingDescriptionCount = bindingDesc.size();
-	vertexInputInfo.pVertexBindingDescriptions = bindingDesc.data();
-	vertexInputInfo.vertexAttributeDescriptionCount = attribDesc.size();
-	vertexInputInfo.pVertexAttributeDescriptions = attribDesc.data();
-
-	VkPipelineInputAssemblyStateCreateInfo inputAssembly = {};
-	inputAssembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
-	inputAssembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
-	inputAssembly.primitiveRestartEnable = VK_FALSE;
-
-	// ===== Pipeline Viewport =====
-
-	VkViewport viewport = renderer->getDefaultVkViewport();
-	VkRect2D scissor = renderer->getDefaultScissor();
-
-	VkPipelineViewportStateCreateInfo viewportState = {};
-	viewportState.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
-	viewportState.viewportCount = 1;
-	viewportState.pViewports = &viewport;
-	viewportState.scissorCount = 1;
-	viewportState.pScissors = &scissor;
-
-	// ===== Pipeline Rasterizer =====
-
-	VkPipelineRasterizationStateCreateInfo rasterizer = renderer->getDefaultRasterizer();
-
-	// ===== Pipeline Multisampling =====
-
-	VkPipelineMultisampleStateCreateInfo multisampling = renderer->getDefaultMultisampling();
-
-	// ===== Pipeline Depth Stencil =====
-
-	VkPipelineDepthStencilStateCreateInfo depthStencil = renderer->getDefaultDepthStencil();
-
-	// ===== Pipeline Color Blend =====
-
-	std::vector<VkPipelineColorBlendAttachmentState> colorBlendAttachments;
-	renderer->getDefaultColorBlendAttachments(colorBlendAttachments);
-	VkPipelineColorBlendStateCreateInfo colorBlending = renderer->getDefaultColorBlend(colorBlendAttachments);
-
-	// ===== Create Pipeline! =====
-	VkGraphicsPipelineCreateInfo pipelineInfo = {};
-	pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
-	pipelineInfo.stageCount = shaderStages.size();
-	pipelineInfo.pStages = shaderStages.data();
-	pipelineInfo.pVertexInputState = &vertexInputInfo;
-	pipelineInfo.pInputAssemblyState = &inputAssembly;
-	pipelineInfo.pViewportState = &viewportState;
-	pipelineInfo.pRasterizationState = &rasterizer;
-	pipelineInfo.pMultisampleState = &multisampling;
-	pipelineInfo.pDepthStencilState = &depthStencil;
-	pipelineInfo.pColorBlendState = &colorBlending;
-	pipelineInfo.pDynamicState = nullptr;
-	pipelineInfo.layout = pipelineLayout;
-	pipelineInfo.renderPass = scene->renderPass;
-	pipelineInfo.subpass = 0;
-	pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
-	pipelineInfo.basePipelineIndex = -1;
-
-	result = vkCreateGraphicsPipelines(context->device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &TexturedModel::pipeline);
-	VALIDATE(result == VK_SUCCESS, "Failed to create graphics pipeline %d", result);
-
-	vkDestroyShaderModule(context->device, vertexShader, nullptr);
-	vkDestroyShaderModule(context->device, fragmentShader, nullptr);
-}
\ No newline at end of file
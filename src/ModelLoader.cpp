@@ -0,0 +1,285 @@
+#include <render/ModelLoader.h>
+
+#include <system/Log.h>
+#include <system/Profiler.h>
+
+#include <exception>
+
+void ModelLoader::create(Context * context, Renderer * renderer, Scene * scene, uint32_t threadCount)
+{
+    this->context = context;
+    this->renderer = renderer;
+    this->scene = scene;
+
+    stopping = false;
+
+    if (threadCount == 0)
+        threadCount = 1;
+
+    for (uint32_t i = 0; i < threadCount; i++)
+        threads.emplace_back(&ModelLoader::loadLoop, this, i);
+
+    DEBUG("MODEL_LOADER - Model Loader Created, %u threads", threadCount);
+}
+
+void ModelLoader::destroy()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+        queue.clear();
+    }
+
+    queued.notify_all();
+
+    for (auto & thread : threads)
+        thread.join();
+
+    threads.clear();
+
+    if (!loads.empty())
+        DEBUG("MODEL_LOADER - Dropped %zu loads still in flight", loads.size());
+
+    for (auto & load : loads)
+        delete load->model;
+
+    loads.clear();
+
+    context = nullptr;
+}
+
+// ===============================================================================================================
+//                                               Requests
+// ===============================================================================================================
+
+uint32_t ModelLoader::request(const std::string & filename, const std::string & location)
+{
+    std::unique_ptr<Load> load(new Load());
+    load->filename = filename;
+    load->location = location;
+    load->start = std::chrono::steady_clock::now();
+    load->model = new TexturedModel(context, renderer, scene);
+    load->model->name = filename;
+
+    uint32_t id;
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+
+        id = load->id = load->model->id = nextID++;
+
+        queue.push_back({load.get(), MODEL_LOADER_PARSE});
+        loads.push_back(std::move(load));
+    }
+
+    queued.notify_one();
+
+    return id;
+}
+
+bool ModelLoader::spawnWhenCollected(uint32_t id, const Mat4 & transform)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    for (auto & load : loads)
+    {
+        if (load->id != id)
+            continue;
+
+        load->spawns.push_back(transform);
+        return true;
+    }
+
+    return false;
+}
+
+void ModelLoader::collect(std::vector<ModelLoadResult> & resident)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    // Only from the front, a load that finished early waits for the ones requested before it
+    while (!loads.empty())
+    {
+        Load & load = *loads.front();
+        uint32_t state = load.state.load(std::memory_order_acquire);
+
+        if (state == ModelLoadParsing || state == ModelLoadDecoding)
+            break;
+
+        // Failed loads may have queued some uploads before failing, they're freed once those are done too
+        if (!context->uploads.isComplete(load.model->upload))
+            break;
+
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - load.start).count();
+
+        if (state == ModelLoadFailed)
+        {
+            if (!load.spawns.empty())
+                WARN("MODEL_LOADER - Dropped %zu spawns of %s", load.spawns.size(), load.filename.c_str());
+
+            delete load.model;
+        }
+        else
+        {
+            DEBUG("MODEL_LOADER - %s resident after %.2f s", load.filename.c_str(), seconds);
+
+            resident.push_back({load.model, std::move(load.spawns)});
+        }
+
+        loads.pop_front();
+    }
+}
+
+void ModelLoader::getProgress(std::vector<ModelLoadProgress> & progress)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    for (auto & load : loads)
+    {
+        ModelLoadProgress p;
+        p.id = load->id;
+        p.name = load->filename;
+        p.state = (ModelLoadState) load->state.load(std::memory_order_acquire);
+
+        // Published by the state leaving ModelLoadParsing
+        uint32_t textureCount = (p.state == ModelLoadParsing) ? 0 : load->textureCount;
+
+        float steps = 2.0f + 2.0f * textureCount;
+        float done = 0.0f;
+
+        if (p.state == ModelLoadDecoding)
+        {
+            done = 1.0f + (textureCount - load->texturesLeft.load(std::memory_order_acquire));
+        }
+        else if (p.state == ModelLoadUploading)
+        {
+            // Nothing touches the model anymore but the batcher
+            done = 1.0f + textureCount;
+
+            for (auto & texture : load->model->textures)
+                if (context->uploads.isComplete(texture->upload))
+                    done += 1.0f;
+        }
+        else if (p.state == ModelLoadFailed)
+        {
+            done = steps;
+        }
+
+        p.progress = done / steps;
+
+        progress.push_back(p);
+    }
+}
+
+// ===============================================================================================================
+//                                                Loading
+// ===============================================================================================================
+
+void ModelLoader::loadLoop(uint32_t index)
+{
+    Profiler::setThreadName("Model Loader " + std::to_string(index));
+
+    std::unique_lock<std::mutex> lock(mutex);
+
+    while (true)
+    {
+        queued.wait(lock, [&]() { return stopping || !queue.empty(); });
+
+        if (stopping)
+            return;
+
+        Job job = queue.front();
+        queue.pop_front();
+
+        lock.unlock();
+
+        if (job.texture == MODEL_LOADER_PARSE)
+            parse(*job.load);
+        else
+            decode(*job.load, job.texture);
+
+        lock.lock();
+    }
+}
+
+void ModelLoader::parse(Load & load)
+{
+    PROFILE_ZONE("Parse Model");
+
+    try
+    {
+        load.model->parse(load.filename, load.location);
+    }
+    catch (const std::exception & e)
+    {
+        WARN("MODEL_LOADER - Failed to parse %s: %s", load.filename.c_str(), e.what());
+        load.failed.store(true, std::memory_order_relaxed);
+    }
+
+    uint32_t textureCount = load.model->textures.size();
+
+    if (load.failed.load(std::memory_order_relaxed) || textureCount == 0)
+    {
+        finish(load);
+        return;
+    }
+
+    load.textureCount = textureCount;
+    load.texturesLeft.store(textureCount, std::memory_order_relaxed);
+    load.state.store(ModelLoadDecoding, std::memory_order_release);
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+
+        // Ahead of models that are still to be parsed, so loads finish about in the order they were requested
+        for (uint32_t i = textureCount; i-- > 0; )
+            queue.push_front({&load, i});
+    }
+
+    queued.notify_all();
+}
+
+void ModelLoader::decode(Load & load, uint32_t texture)
+{
+    PROFILE_ZONE("Decode Texture");
+
+    // Once one texture failed the model is dropped, the rest are skipped
+    if (!load.failed.load(std::memory_order_relaxed))
+    {
+        try
+        {
+            load.model->decodeTexture(texture);
+        }
+        catch (const std::exception & e)
+        {
+            WARN("MODEL_LOADER - Failed to decode texture %u of %s: %s", texture, load.filename.c_str(), e.what());
+            load.failed.store(true, std::memory_order_relaxed);
+        }
+    }
+
+    if (load.texturesLeft.fetch_sub(1, std::memory_order_acq_rel) == 1)
+        finish(load);
+}
+
+void ModelLoader::finish(Load & load)
+{
+    PROFILE_ZONE("Create Model Resources");
+
+    if (!load.failed.load(std::memory_order_relaxed))
+    {
+        try
+        {
+            load.model->createResources();
+        }
+        catch (const std::exception & e)
+        {
+            WARN("MODEL_LOADER - Failed to create resources of %s: %s", load.filename.c_str(), e.what());
+            load.failed.store(true, std::memory_order_relaxed);
+        }
+    }
+
+    if (load.failed.load(std::memory_order_relaxed))
+        WARN("MODEL_LOADER - Failed to load model %s", load.filename.c_str());
+
+    load.state.store(load.failed.load(std::memory_order_relaxed) ? ModelLoadFailed : ModelLoadUploading, std::memory_order_release);
+}
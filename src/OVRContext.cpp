@@ -52,10 +52,11 @@ void getOVRDeviceExtensions(std::vector<const char *> & deviceExtensions)
 
 void OVRContext::init()
 {
-
+	// The looper must be polled from the thread it was prepared on
+	setResourceAccess(ResourceNone, ResourceWindow | ResourceInput, true);
 }
 
-void OVRContext::update(long elapsedTime)
+void OVRContext::update(double elapsedTime)
 {
     while (true)
     {
@@ -171,6 +172,18 @@ OVRContext::OVRContext(struct android_app * android_context)
         vkCreateCommandPool(device, &poolInfo, nullptr, &queue.commandPool);
     }
 
+    // ===== Setup DeviceAllocator =====
+    allocator.create(physicalDevice, device);
+
+    // ===== Setup UploadBatcher =====
+    uploads.create(this);
+
+    // ===== Setup VkPipelineCache =====
+
+    // The working directory isn't writable on Android
+    pipelineCacheFilename = std::string(android_context->activity->internalDataPath) + "/" + PIPELINE_CACHE_FILENAME;
+    createPipelineCache();
+
     DEBUG("CONTEXT - Context Created");
 }
 
@@ -183,6 +196,10 @@ OVRContext::~OVRContext()
         vkDestroyCommandPool(device, queue.commandPool, nullptr);
     }
 
+    destroyPipelineCache();
+    uploads.destroy();
+    allocator.destroy();
+
     vkDestroyDevice(device, nullptr);
     this->destroyValidationDebugCallback();
     vkDestroyInstance(instance, nullptr);
@@ -2,27 +2,28 @@
 
 void OVRRenderer::init()
 {
-
+	setResourceAccess(ResourceNone, ResourceRenderer);
 }
 
-void OVRRenderer::update(long elapsedTime)
+void OVRRenderer::update(double elapsedTime)
 {
 
 }
 
 VkCommandBuffer OVRRenderer::getNextCommandBuffer()
 {
-    vkWaitForFences(context->device, 1, &fences[currentImageIndex], VK_TRUE, std::numeric_limits<uint64_t>::max());
-	vkResetFences(context->device, 1, &fences[currentImageIndex]);
+    FrameContext & frame = waitForFrame(context->device);
 
     VkCommandBufferBeginInfo beginInfo = {};
     beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
     beginInfo.flags = 0;
     beginInfo.pInheritanceInfo = nullptr;
 
-    int result = vkBeginCommandBuffer(commandbuffers[currentImageIndex], &beginInfo);
+    int result = vkBeginCommandBuffer(frame.commandBuffer, &beginInfo);
     VALIDATE(result == VK_SUCCESS, "RENDERER - Failed to begin recording command buffer! %d", result);
 
+    profiler.beginFrame(frame.commandBuffer, currentFrame);
+
     VkImageMemoryBarrier barrier;
     barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
     barrier.pNext = nullptr;
@@ -39,11 +40,11 @@ VkCommandBuffer OVRRenderer::getNextCommandBuffer()
     barrier.subresourceRange.baseArrayLayer = 0;
     barrier.subresourceRange.layerCount = 2;
 
-    vkCmdPipelineBarrier(commandbuffers[currentImageIndex], VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+    vkCmdPipelineBarrier(frame.commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
                          VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, 0, 0, nullptr, 0, nullptr,
                          1, &barrier);
 
-    return commandbuffers[currentImageIndex];
+    return frame.commandBuffer;
 }
 
 void OVRRenderer::render(VkCommandBuffer commandbuffer)
@@ -64,10 +65,11 @@ void OVRRenderer::render(VkCommandBuffer commandbuffer)
     barrier.subresourceRange.baseArrayLayer = 0;
     barrier.subresourceRange.layerCount = 2;
 
-    vkCmdPipelineBarrier(commandbuffers[currentImageIndex], VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+    vkCmdPipelineBarrier(commandbuffer, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
                          VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr, 0, nullptr,
                          1, &barrier);
 
+    profiler.endFrame(commandbuffer);
     vkEndCommandBuffer(commandbuffer);
 
 	VkSubmitInfo submitInfo = {};
@@ -80,7 +82,9 @@ void OVRRenderer::render(VkCommandBuffer commandbuffer)
 	submitInfo.signalSemaphoreCount = 0;
 	submitInfo.pSignalSemaphores = nullptr;
 
-	VkResult result = vkQueueSubmit(context->primaryGraphicsQueue->queue, 1, &submitInfo, fences[currentImageIndex]);
+	vkResetFences(context->device, 1, &frames[currentFrame].fence);
+
+	VkResult result = vkQueueSubmit(context->primaryGraphicsQueue->queue, 1, &submitInfo, frames[currentFrame].fence);
 	VALIDATE(result == VK_SUCCESS, "RENDERER - Failed to submit draw command buffer %d", result);
 }
 
@@ -120,6 +124,8 @@ void OVRRenderer::present()
 
     this->currentImageIndex++;
     this->currentImageIndex %= this->length;
+
+    advanceFrame();
 }
 
 OVRRenderer::OVRRenderer(OVRContext * context)
@@ -156,7 +162,7 @@ OVRRenderer::OVRRenderer(OVRContext * context)
     createVkImage(context, VK_IMAGE_TYPE_2D, colorFormat,
                     extent, 1, 2, sample_count, VK_IMAGE_TILING_OPTIMAL,
                     VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT | VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT,
-                    VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &colorImage, &colorImageMemory);
+                    VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &colorImage, &colorImageAllocation);
 
     transitionImageLayout(context->device, context->primaryGraphicsQueue->queue, context->primaryGraphicsQueue->commandPool, colorImage, colorFormat, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, 1);
 
@@ -169,65 +175,37 @@ OVRRenderer::OVRRenderer(OVRContext * context)
     createVkImage(context, VK_IMAGE_TYPE_2D, depthFormat,
                     extent, 1, 2, sample_count, VK_IMAGE_TILING_OPTIMAL,
                     VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT,
-                    VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &depthImage, &depthImageMemory);
+                    VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &depthImage, &depthImageAllocation);
 
     transitionImageLayout(context->device, context->primaryGraphicsQueue->queue, context->primaryGraphicsQueue->commandPool, depthImage, depthFormat, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL, 1);
 
     createVkImageView(context->physicalDevice, context->device, depthImage, VK_IMAGE_VIEW_TYPE_2D_ARRAY,
                         depthFormat, 1, 2, VK_IMAGE_ASPECT_DEPTH_BIT, &depthImageView);
 
-    // ===== Queue Synchronization Objects =====
-
-	fences.resize(length);
-	for (int i = 0; i < length; i++)
-	{
-        VkFenceCreateInfo fenceInfo = {};
-        fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
-        fenceInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
-
-		vkCreateFence(context->device, &fenceInfo, nullptr, &fences[i]);
-	}
-
-	VkSemaphoreCreateInfo semaphoreInfo = {};
-	semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
-
-	vkCreateSemaphore(context->device, &semaphoreInfo, nullptr, &imageAvailable);
-	vkCreateSemaphore(context->device, &semaphoreInfo, nullptr, &renderFinished);
-
-    // ===== Command Buffers =====
-
-    commandbuffers.resize(this->length);
+    // ===== Frames In Flight =====
 
-    VkCommandBufferAllocateInfo commandbufferInfo = {};
-    commandbufferInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-    commandbufferInfo.pNext = nullptr;
-    commandbufferInfo.commandPool = context->primaryGraphicsQueue->commandPool;
-    commandbufferInfo.commandBufferCount = commandbuffers.size();
-    commandbufferInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    createFrameContexts(context->device, context->primaryGraphicsQueue->index);
 
-    vkAllocateCommandBuffers(context->device, &commandbufferInfo, commandbuffers.data());
+    profiler.create(context->physicalDevice, context->device, context->primaryGraphicsQueue->index, framesInFlight);
 
     DEBUG("RENDERER - Renderer Created");
 }
 
 OVRRenderer::~OVRRenderer()
 {
-	vkDestroySemaphore(context->device, imageAvailable, nullptr);
-	vkDestroySemaphore(context->device, renderFinished, nullptr);
+	profiler.destroy();
+	destroyFrameContexts(context->device);
 
 	for (int i = 0; i < length; i++)
 	{
-		vkDestroyFence(context->device, fences[i], nullptr);
 		vkDestroyImageView(context->device, imageviews[i], nullptr);
 	}
 
     vkDestroyImageView(context->device, colorImageView, nullptr);
-    vkDestroyImage(context->device, colorImage, nullptr);
-    vkFreeMemory(context->device, colorImageMemory, nullptr);
+    destroyVkImage(context, colorImage, colorImageAllocation);
 
     vkDestroyImageView(context->device, depthImageView, nullptr);
-    vkDestroyImage(context->device, depthImage, nullptr);
-    vkFreeMemory(context->device, depthImageMemory, nullptr);
+    destroyVkImage(context, depthImage, depthImageAllocation);
 
     vrapi_DestroyTextureSwapChain(swapchain);
 
@@ -0,0 +1,460 @@
+#include <render/PipelineRegistry.h>
+#include <render/KoiVector.h>
+#include <render/Utilities.h>
+#include <render/Shaders.h>
+
+#include <system/Log.h>
+#include <system/Profiler.h>
+
+// ===============================================================================================================
+//                                              Pipeline State
+// ===============================================================================================================
+
+size_t PipelineState::hash() const
+{
+    size_t seed = 0;
+
+    std::hashy(seed, std::hash<std::string>()(vertexShader));
+    std::hashy(seed, std::hash<std::string>()(fragmentShader));
+    std::hashy(seed, shaderFeatures);
+    std::hashy(seed, vertexLayout);
+    std::hashy(seed, topology);
+    std::hashy(seed, polygonMode);
+    std::hashy(seed, cullMode);
+    std::hashy(seed, frontFace);
+    std::hashy(seed, depthTest);
+    std::hashy(seed, depthWrite);
+    std::hashy(seed, depthCompare);
+    std::hashy(seed, blendMode);
+    std::hashy(seed, samples);
+    std::hashy(seed, extent.width);
+    std::hashy(seed, extent.height);
+    std::hashy(seed, std::hash<uint64_t>()((uint64_t) renderPass));
+    std::hashy(seed, subpass);
+    std::hashy(seed, std::hash<uint64_t>()((uint64_t) layout));
+
+    return seed;
+}
+
+bool PipelineState::operator == (const PipelineState & other) const
+{
+    return vertexShader == other.vertexShader && fragmentShader == other.fragmentShader && shaderFeatures == other.shaderFeatures &&
+           vertexLayout == other.vertexLayout && topology == other.topology &&
+           polygonMode == other.polygonMode && cullMode == other.cullMode && frontFace == other.frontFace &&
+           depthTest == other.depthTest && depthWrite == other.depthWrite && depthCompare == other.depthCompare &&
+           blendMode == other.blendMode && samples == other.samples &&
+           extent.width == other.extent.width && extent.height == other.extent.height &&
+           renderPass == other.renderPass && subpass == other.subpass && layout == other.layout;
+}
+
+// ===============================================================================================================
+//                                             Pipeline Registry
+// ===============================================================================================================
+
+void PipelineRegistry::create(Context * context, uint32_t threadCount)
+{
+    this->context = context;
+
+    entries.reset(new PipelineEntry[PIPELINE_REGISTRY_MAX_PIPELINES]);
+    count.store(0, std::memory_order_relaxed);
+    stopping = false;
+
+    if (threadCount == 0)
+        threadCount = 1;
+
+    for (uint32_t i = 0; i < threadCount; i++)
+        threads.emplace_back(&PipelineRegistry::compileLoop, this, i);
+
+    DEBUG("PIPELINE_REGISTRY - Pipeline Registry Created, %u compile threads", threadCount);
+}
+
+void PipelineRegistry::destroy()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+        queue.clear();
+    }
+
+    queued.notify_all();
+
+    for (auto & thread : threads)
+        thread.join();
+
+    threads.clear();
+
+    if (context == nullptr)
+        return;
+
+    uint32_t stateCount = count.load(std::memory_order_acquire);
+    uint32_t pipelineCount = 0;
+
+    for (uint32_t i = 0; i < stateCount; i++)
+    {
+        if (entries[i].pipeline == VK_NULL_HANDLE)
+            continue;
+
+        vkDestroyPipeline(context->device, entries[i].pipeline, nullptr);
+        pipelineCount++;
+    }
+
+    for (auto & layout : pipelineLayouts)
+        vkDestroyPipelineLayout(context->device, layout.second, nullptr);
+
+    for (auto & layout : setLayouts)
+        vkDestroyDescriptorSetLayout(context->device, layout.second, nullptr);
+
+    for (auto & shader : shaders)
+        vkDestroyShaderModule(context->device, shader.second, nullptr);
+
+    INFO("PIPELINE_REGISTRY - %u pipelines created for %u states, %u requests shared an existing one", pipelineCount, stateCount, hits);
+
+    ids.clear();
+    pipelineLayouts.clear();
+    setLayouts.clear();
+    shaders.clear();
+    entries.reset();
+    count.store(0, std::memory_order_relaxed);
+    hits = 0;
+
+    context = nullptr;
+}
+
+VkDescriptorSetLayout PipelineRegistry::getDescriptorSetLayout(const std::vector<VkDescriptorSetLayoutBinding> & bindings)
+{
+    std::string key;
+    for (auto & binding : bindings)
+    {
+        uint64_t fields[] = {binding.binding, (uint64_t) binding.descriptorType, binding.descriptorCount, binding.stageFlags, (uint64_t) (uintptr_t) binding.pImmutableSamplers};
+        key.append((const char *) fields, sizeof(fields));
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+
+    auto found = setLayouts.find(key);
+    if (found != setLayouts.end())
+        return found->second;
+
+    VkDescriptorSetLayoutCreateInfo layoutInfo = {};
+    layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    layoutInfo.pNext = nullptr;
+    layoutInfo.flags = 0;
+    layoutInfo.bindingCount = bindings.size();
+    layoutInfo.pBindings = bindings.data();
+
+    VkDescriptorSetLayout layout;
+    int result = vkCreateDescriptorSetLayout(context->device, &layoutInfo, nullptr, &layout);
+    VALIDATE(result == VK_SUCCESS, "PIPELINE_REGISTRY - Failed to create VkDescriptorSetLayout %d", result);
+
+    setLayouts[key] = layout;
+    return layout;
+}
+
+VkPipelineLayout PipelineRegistry::getPipelineLayout(const std::vector<VkDescriptorSetLayout> & setLayouts)
+{
+    std::string key;
+    for (auto & setLayout : setLayouts)
+    {
+        uint64_t handle = (uint64_t) setLayout;
+        key.append((const char *) &handle, sizeof(handle));
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+
+    auto found = pipelineLayouts.find(key);
+    if (found != pipelineLayouts.end())
+        return found->second;
+
+    VkPipelineLayoutCreateInfo createInfo = {};
+    createInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    createInfo.pNext = nullptr;
+    createInfo.flags = 0;
+    createInfo.setLayoutCount = setLayouts.size();
+    createInfo.pSetLayouts = setLayouts.data();
+    createInfo.pushConstantRangeCount = 0;
+    createInfo.pPushConstantRanges = nullptr;
+
+    VkPipelineLayout layout;
+    int result = vkCreatePipelineLayout(context->device, &createInfo, nullptr, &layout);
+    VALIDATE(result == VK_SUCCESS, "PIPELINE_REGISTRY - Failed to create pipeline layout %d", result);
+
+    pipelineLayouts[key] = layout;
+    return layout;
+}
+
+uint32_t PipelineRegistry::request(const PipelineState & state)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    auto found = ids.find(state);
+    if (found != ids.end())
+    {
+        hits++;
+        return found->second;
+    }
+
+    uint32_t id = count.load(std::memory_order_relaxed);
+    VALIDATE(id < PIPELINE_REGISTRY_MAX_PIPELINES, "PIPELINE_REGISTRY - More than %u pipelines", PIPELINE_REGISTRY_MAX_PIPELINES);
+
+    // Shaders that aren't built in load on the requesting thread, where asset access is allowed
+    PipelineEntry & entry = entries[id];
+    entry.state = state;
+    entry.vertexModule = getShader(state.vertexShader);
+    entry.fragmentModule = getShader(state.fragmentShader);
+    entry.pipeline = VK_NULL_HANDLE;
+    entry.status.store(PipelineCompiling, std::memory_order_relaxed);
+
+    ids[state] = id;
+    count.store(id + 1, std::memory_order_release);
+
+    queue.push_back(id);
+    queued.notify_one();
+
+    return id;
+}
+
+void PipelineRegistry::wait(uint32_t id)
+{
+    if (id >= count.load(std::memory_order_acquire))
+        return;
+
+    std::unique_lock<std::mutex> lock(mutex);
+    compiled.wait(lock, [&]() { return stopping || entries[id].status.load(std::memory_order_acquire) != PipelineCompiling; });
+}
+
+void PipelineRegistry::waitIdle()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    compiled.wait(lock, [&]() { return stopping || (queue.empty() && compiling == 0); });
+}
+
+// Caller holds the mutex
+VkShaderModule PipelineRegistry::getShader(const std::string & filename)
+{
+    auto found = shaders.find(filename);
+    if (found != shaders.end())
+        return found->second;
+
+    const EmbeddedShader * embedded = findEmbeddedShader(filename);
+
+    VkShaderModule shader = (embedded != nullptr) ? createShaderModule(context, embedded->code, embedded->size) : loadShader(context, filename);
+    shaders[filename] = shader;
+
+    return shader;
+}
+
+void PipelineRegistry::compileLoop(uint32_t index)
+{
+    Profiler::setThreadName("Pipeline Compiler " + std::to_string(index));
+
+    std::unique_lock<std::mutex> lock(mutex);
+
+    while (true)
+    {
+        queued.wait(lock, [&]() { return stopping || !queue.empty(); });
+
+        if (stopping)
+            return;
+
+        uint32_t id = queue.front();
+        queue.pop_front();
+        compiling++;
+
+        lock.unlock();
+        compile(entries[id]);
+        lock.lock();
+
+        compiling--;
+        compiled.notify_all();
+    }
+}
+
+void PipelineRegistry::compile(PipelineEntry & entry)
+{
+    PROFILE_ZONE("Compile Pipeline");
+
+    const PipelineState & state = entry.state;
+
+    // ===== Pipeline Shaders =====
+
+    VkSpecializationMapEntry specializationEntries[PipelineFeatureCount];
+    VkBool32 specializationData[PipelineFeatureCount];
+
+    for (uint32_t i = 0; i < PipelineFeatureCount; i++)
+    {
+        specializationEntries[i].constantID = i;
+        specializationEntries[i].offset = i * sizeof(VkBool32);
+        specializationEntries[i].size = sizeof(VkBool32);
+
+        specializationData[i] = (state.shaderFeatures & (1u << i)) ? VK_TRUE : VK_FALSE;
+    }
+
+    VkSpecializationInfo specialization = {};
+    specialization.mapEntryCount = PipelineFeatureCount;
+    specialization.pMapEntries = specializationEntries;
+    specialization.dataSize = sizeof(specializationData);
+    specialization.pData = specializationData;
+
+    VkPipelineShaderStageCreateInfo shaderStages[2] = {};
+
+    shaderStages[0].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    shaderStages[0].stage = VK_SHADER_STAGE_VERTEX_BIT;
+    shaderStages[0].module = entry.vertexModule;
+    shaderStages[0].pName = "main";
+
+    shaderStages[1].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    shaderStages[1].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
+    shaderStages[1].module = entry.fragmentModule;
+    shaderStages[1].pName = "main";
+    shaderStages[1].pSpecializationInfo = &specialization;
+
+    // ===== Pipeline Vertex Input Attributes =====
+
+    std::vector<VkVertexInputBindingDescription> bindingDesc;
+    std::vector<VkVertexInputAttributeDescription> attribDesc;
+
+    switch (state.vertexLayout)
+    {
+        case PipelineVertexMeshInstanced:
+            bindingDesc.resize(2);
+
+            Vertex::getAttributeDescriptions(0, attribDesc);
+            bindingDesc[0].binding = 0;
+            bindingDesc[0].stride = sizeof(VertexData);
+            bindingDesc[0].inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+
+            Instance::getAttributeDescriptions(1, attribDesc);
+            bindingDesc[1].binding = 1;
+            bindingDesc[1].stride = sizeof(InstanceData);
+            bindingDesc[1].inputRate = VK_VERTEX_INPUT_RATE_INSTANCE;
+            break;
+    };
+
+    VkPipelineVertexInputStateCreateInfo vertexInputInfo = {};
+    vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+    vertexInputInfo.vertexBindingDescriptionCount = bindingDesc.size();
+    vertexInputInfo.pVertexBindingDescriptions = bindingDesc.data();
+    vertexInputInfo.vertexAttributeDescriptionCount = attribDesc.size();
+    vertexInputInfo.pVertexAttributeDescriptions = attribDesc.data();
+
+    VkPipelineInputAssemblyStateCreateInfo inputAssembly = {};
+    inputAssembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+    inputAssembly.topology = state.topology;
+    inputAssembly.primitiveRestartEnable = VK_FALSE;
+
+    // ===== Pipeline Viewport =====
+
+    VkViewport viewport = {};
+    viewport.x = 0.0f;
+    viewport.y = 0.0f;
+    viewport.width = state.extent.width;
+    viewport.height = state.extent.height;
+    viewport.minDepth = 0.0f;
+    viewport.maxDepth = 1.0f;
+
+    VkRect2D scissor = {};
+    scissor.offset = {0, 0};
+    scissor.extent = state.extent;
+
+    VkPipelineViewportStateCreateInfo viewportState = {};
+    viewportState.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+    viewportState.viewportCount = 1;
+    viewportState.pViewports = &viewport;
+    viewportState.scissorCount = 1;
+    viewportState.pScissors = &scissor;
+
+    // ===== Pipeline Rasterizer =====
+
+    VkPipelineRasterizationStateCreateInfo rasterizer = {};
+    rasterizer.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+    rasterizer.depthClampEnable = VK_FALSE;
+    rasterizer.rasterizerDiscardEnable = VK_FALSE;
+    rasterizer.polygonMode = state.polygonMode;
+    rasterizer.lineWidth = 1.0f;
+    rasterizer.cullMode = state.cullMode;
+    rasterizer.frontFace = state.frontFace;
+    rasterizer.depthBiasEnable = VK_FALSE;
+
+    // ===== Pipeline Multisampling =====
+
+    VkPipelineMultisampleStateCreateInfo multisampling = {};
+    multisampling.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+    multisampling.sampleShadingEnable = VK_FALSE;
+    multisampling.rasterizationSamples = state.samples;
+    multisampling.minSampleShading = 1.0f;
+    multisampling.pSampleMask = nullptr;
+    multisampling.alphaToCoverageEnable = VK_FALSE;
+    multisampling.alphaToOneEnable = VK_FALSE;
+
+    // ===== Pipeline Depth Stencil =====
+
+    VkPipelineDepthStencilStateCreateInfo depthStencil = {};
+    depthStencil.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+    depthStencil.depthTestEnable = state.depthTest;
+    depthStencil.depthWriteEnable = state.depthWrite;
+    depthStencil.depthCompareOp = state.depthCompare;
+    depthStencil.depthBoundsTestEnable = VK_FALSE;
+    depthStencil.minDepthBounds = 0.0f;
+    depthStencil.maxDepthBounds = 1.0f;
+    depthStencil.stencilTestEnable = VK_FALSE;
+
+    // ===== Pipeline Color Blend =====
+
+    VkPipelineColorBlendAttachmentState colorBlendAttachment = {};
+    colorBlendAttachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+
+    switch (state.blendMode)
+    {
+        case PipelineBlendOpaque:
+            colorBlendAttachment.blendEnable = VK_FALSE;
+            break;
+        case PipelineBlendAlpha:
+            colorBlendAttachment.blendEnable = VK_TRUE;
+            colorBlendAttachment.srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA;
+            colorBlendAttachment.dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+            colorBlendAttachment.colorBlendOp = VK_BLEND_OP_ADD;
+            colorBlendAttachment.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+            colorBlendAttachment.dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO;
+            colorBlendAttachment.alphaBlendOp = VK_BLEND_OP_ADD;
+            break;
+    };
+
+    VkPipelineColorBlendStateCreateInfo colorBlending = {};
+    colorBlending.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+    colorBlending.logicOpEnable = VK_FALSE;
+    colorBlending.logicOp = VK_LOGIC_OP_COPY;
+    colorBlending.attachmentCount = 1;
+    colorBlending.pAttachments = &colorBlendAttachment;
+
+    // ===== Create Pipeline! =====
+
+    VkGraphicsPipelineCreateInfo pipelineInfo = {};
+    pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+    pipelineInfo.stageCount = 2;
+    pipelineInfo.pStages = shaderStages;
+    pipelineInfo.pVertexInputState = &vertexInputInfo;
+    pipelineInfo.pInputAssemblyState = &inputAssembly;
+    pipelineInfo.pViewportState = &viewportState;
+    pipelineInfo.pRasterizationState = &rasterizer;
+    pipelineInfo.pMultisampleState = &multisampling;
+    pipelineInfo.pDepthStencilState = &depthStencil;
+    pipelineInfo.pColorBlendState = &colorBlending;
+    pipelineInfo.pDynamicState = nullptr;
+    pipelineInfo.layout = state.layout;
+    pipelineInfo.renderPass = state.renderPass;
+    pipelineInfo.subpass = state.subpass;
+    pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
+    pipelineInfo.basePipelineIndex = -1;
+
+    int result = context->createGraphicsPipeline(&pipelineInfo, &entry.pipeline);
+
+    if (result != VK_SUCCESS)
+    {
+        WARN("PIPELINE_REGISTRY - Failed to create graphics pipeline %d (%s, %s)", result, state.vertexShader.c_str(), state.fragmentShader.c_str());
+        entry.pipeline = VK_NULL_HANDLE;
+        entry.status.store(PipelineFailed, std::memory_order_release);
+        return;
+    }
+
+    entry.status.store(PipelineReady, std::memory_order_release);
+}
@@ -0,0 +1,168 @@
+#include <system/Profiler.h>
+#include <system/Log.h>
+
+#include <chrono>
+#include <fstream>
+
+#include <nlohmann/json.hpp>
+
+std::atomic<bool> Profiler::capturing(false);
+std::atomic<uint32_t> Profiler::capture(0);
+
+std::mutex Profiler::mutex;
+std::vector<std::unique_ptr<ProfileThreadBuffer>> Profiler::threads;
+
+uint32_t Profiler::framesRemaining = 0;
+uint64_t Profiler::captureStart = 0;
+std::string Profiler::filename;
+
+uint64_t Profiler::now()
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+ProfileThreadBuffer * Profiler::getThreadBuffer()
+{
+	thread_local ProfileThreadBuffer * buffer = nullptr;
+
+	if (buffer == nullptr)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+
+		threads.emplace_back(new ProfileThreadBuffer());
+		buffer = threads.back().get();
+		buffer->index = (uint32_t) threads.size() - 1;
+		buffer->name = "Thread " + std::to_string(buffer->index);
+	}
+
+	return buffer;
+}
+
+void Profiler::setThreadName(const std::string & name)
+{
+	ProfileThreadBuffer * buffer = getThreadBuffer();
+
+	std::lock_guard<std::mutex> lock(mutex);
+	buffer->name = name;
+}
+
+void Profiler::record(const char * name, uint64_t start, uint64_t end)
+{
+	ProfileThreadBuffer * buffer = getThreadBuffer();
+	uint32_t current = capture.load(std::memory_order_relaxed);
+
+	// First event of a new capture on this thread
+	if (buffer->capture.load(std::memory_order_relaxed) != current)
+	{
+		if (buffer->events.empty())
+			buffer->events.resize(PROFILER_THREAD_CAPACITY);
+
+		buffer->count.store(0, std::memory_order_relaxed);
+		buffer->dropped.store(0, std::memory_order_relaxed);
+		buffer->capture.store(current, std::memory_order_release);
+	}
+
+	uint32_t index = buffer->count.load(std::memory_order_relaxed);
+
+	if (index >= PROFILER_THREAD_CAPACITY)
+	{
+		buffer->dropped.fetch_add(1, std::memory_order_relaxed);
+		return;
+	}
+
+	buffer->events[index] = {name, start, end};
+	buffer->count.store(index + 1, std::memory_order_release);
+}
+
+void Profiler::startCapture(uint32_t frames, const std::string & filename)
+{
+	if (isCapturing())
+	{
+		WARN("PROFILER - A capture is already running");
+		return;
+	}
+
+#ifndef KOI_PROFILER
+	WARN("PROFILER - Built with KOI_DISABLE_PROFILER, the capture will be empty");
+#endif
+
+	Profiler::framesRemaining = (frames > 0) ? frames : 1;
+	Profiler::filename = filename;
+	Profiler::captureStart = now();
+
+	capture.fetch_add(1, std::memory_order_relaxed);
+	capturing.store(true, std::memory_order_release);
+
+	INFO("PROFILER - Capturing %u frames", Profiler::framesRemaining);
+}
+
+void Profiler::stopCapture()
+{
+	if (!isCapturing())
+		return;
+
+	capturing.store(false, std::memory_order_release);
+
+	writeTrace(filename, capture.load(std::memory_order_relaxed));
+}
+
+void Profiler::endFrame()
+{
+	if (!isCapturing())
+		return;
+
+	if (--framesRemaining == 0)
+		stopCapture();
+}
+
+bool Profiler::writeTrace(const std::string & filename, uint32_t capture)
+{
+	nlohmann::json events = nlohmann::json::array();
+
+	uint64_t eventCount = 0;
+	uint64_t droppedCount = 0;
+
+	std::lock_guard<std::mutex> lock(mutex);
+
+	for (auto & buffer : threads)
+	{
+		events.push_back({{"name", "thread_name"}, {"ph", "M"}, {"pid", 1}, {"tid", buffer->index}, {"args", {{"name", buffer->name}}}});
+
+		// Threads that recorded nothing this capture still hold the last one's events
+		if (buffer->capture.load(std::memory_order_acquire) != capture)
+			continue;
+
+		uint32_t count = buffer->count.load(std::memory_order_acquire);
+
+		for (uint32_t i = 0; i < count; i++)
+		{
+			const ProfileEvent & event = buffer->events[i];
+
+			// Zones still open when the capture ended have nothing to show
+			if (event.start < captureStart)
+				continue;
+
+			events.push_back({{"name", event.name}, {"cat", "cpu"}, {"ph", "X"}, {"pid", 1}, {"tid", buffer->index},
+			                  {"ts", (event.start - captureStart) / 1000.0}, {"dur", (event.end - event.start) / 1000.0}});
+		}
+
+		eventCount += count;
+		droppedCount += buffer->dropped.load(std::memory_order_relaxed);
+	}
+
+	std::ofstream file(filename);
+	if (!file.is_open())
+	{
+		WARN("PROFILER - Could not open %s", filename.c_str());
+		return false;
+	}
+
+	nlohmann::json trace = {{"traceEvents", std::move(events)}, {"displayTimeUnit", "ms"}};
+	file << trace.dump();
+
+	if (droppedCount > 0)
+		WARN("PROFILER - %llu events dropped, more than %u on a thread", (unsigned long long) droppedCount, PROFILER_THREAD_CAPACITY);
+
+	INFO("PROFILER - Wrote %llu events to %s", (unsigned long long) eventCount, filename.c_str());
+	return true;
+}
@@ -1,5 +1,8 @@
 #include <ProjectKoi.h>
 
+#include <cstring>
+#include <cstdlib>
+
 // TODO:
 //       Fix texture & model duplication
 //       Move Keybinds to Input System? Map (key -> function -> immediate message)
@@ -17,62 +20,242 @@ ProjectKoi::~ProjectKoi()
 
 void ProjectKoi::init()
 {
-    auto now = std::chrono::system_clock::now();
-    auto now_ms = std::chrono::time_point_cast<std::chrono::milliseconds>(now);
-    auto epoch = now_ms.time_since_epoch();
-    auto value = std::chrono::duration_cast<std::chrono::milliseconds>(epoch);
-    lastUpdateTime = value.count();
+    clock.tick();
+
+    Profiler::setThreadName("Main");
+
+#ifdef KOI_SERIAL_UPDATE
+    jobs.serial = true;
+#endif
 
-    setMessageCallback(Exit, (message_method_t) &ProjectKoi::exit);
+    // Subscribe to our own bus so queued and immediate messages reach us the same way
+    this->app = this;
+
+    setMessageCallback<Exit>(&ProjectKoi::exit);
+    setMessageCallback<SetFrameLimit>(&ProjectKoi::setFrameLimit);
 }
 
 void ProjectKoi::run()
 {
     while (!this->needsDestroying)
     {
-        auto now = std::chrono::system_clock::now();
-        auto now_ms = std::chrono::time_point_cast<std::chrono::milliseconds>(now);
-        auto epoch = now_ms.time_since_epoch();
-        auto value = std::chrono::duration_cast<std::chrono::milliseconds>(epoch);
-        long elapsedTime = value.count() - lastUpdateTime;
-        lastUpdateTime = value.count();
+        PROFILE_ZONE("Frame");
+
+        double elapsedTime = 0.0;
+        bool replayed = replay.isPlaying() && replay.nextFrame(elapsedTime);
+
+        if (replayed)
+        {
+            // The simulation always sees the recorded frame time, speed only changes the wait
+            if (replay.speed > 0.0)
+                clock.waitForFrameTime(elapsedTime / replay.speed);
+
+            clock.tick(elapsedTime);
+        }
+        else
+        {
+            if (exitAfterReplay && !replay.isPlaying())
+                break;
+
+            {
+                PROFILE_ZONE("Frame Limit Wait");
+                clock.waitForNextFrame();
+            }
+
+            elapsedTime = clock.tick();
+
+            replay.recordFrame(elapsedTime);
+        }
 
         this->update(elapsedTime);
         this->renderSystem->draw();
+
+        clock.markPresent();
+        frameArena.reset();
+
+        UploadStats::endFrame();
+
+#ifdef KOI_MESSAGE_STATS
+        messageStats.endFrame();
+#endif
+
+        Profiler::endFrame();
     }
+
+    Profiler::stopCapture();
 }
 
-void ProjectKoi::update(long elapsedTime)
+void ProjectKoi::update(double elapsedTime)
 {
-	while (!(msgQueue.empty()))
+    PROFILE_ZONE("ProjectKoi::update");
+
+    // Recorded messages of the previous frame, ahead of the input they were recorded before
+    replay.deliverMessages(this);
+
+#ifndef ANDROID
+    // Sampled as late as possible, fixed steps and updates all see the same input
+    inputSystem->poll();
+#endif
+
+    // Bounded so producers on other threads can't keep the main thread draining forever.
+    // Messages published while draining wait for the next frame
+    MessageHeader * msg;
+    uint32_t count = 0;
+    uint32_t newest[MessageTypeCount] = {};
+    for (; count < msgQueue.getCapacity() && (msg = msgQueue.peek(count)) != nullptr; count++)
+    {
+        if (isMessageCoalesced(msg->type))
+            newest[msg->type] = count;
+    }
+
+    // Coalesced types are delivered only where their newest message was queued, so
+    // everything still arrives in the order it was sent
+    coalescedMessageCount = 0;
+    for (uint32_t i = 0; i < count; i++)
     {
-        Message * msg = msgQueue.front();
-        this->handleMessage(msg);
-        sendMessageNow(msg);
+        msg = msgQueue.front();
+
+        if (isMessageCoalesced(msg->type) && newest[msg->type] != i)
+            coalescedMessageCount++;
+        else
+            sendMessageNow(msg);
+
         msgQueue.pop();
     }
 
-    for (auto& system : registeredSystems)
-        system->update(elapsedTime);
+    uint32_t dropped = msgQueue.takeDroppedCount();
+    if (dropped > 0)
+        WARN("PROJECT_KOI - Message queue full, dropped %u messages", dropped);
+
+    if (updateGraphSystemCount != registeredSystems.size())
+        buildUpdateGraph();
+
+    while (clock.stepFixed())
+    {
+        PROFILE_ZONE("Fixed Update");
+        jobs.run(fixedUpdateGraph);
+    }
+
+    frameElapsedTime = elapsedTime;
+
+    PROFILE_ZONE("Update Graph");
+    jobs.run(updateGraph);
+}
+
+void ProjectKoi::buildUpdateGraph()
+{
+    updateGraph.clear();
+    fixedUpdateGraph.clear();
+
+    std::vector<Task *> tasks;
+    std::vector<Task *> fixedTasks;
+    for (size_t i = 0; i < registeredSystems.size(); i++)
+    {
+        System * system = registeredSystems[i];
+        Task * task = updateGraph.addTask([this, system] { system->update(this->frameElapsedTime); }, system->mainThreadOnly);
+        Task * fixedTask = fixedUpdateGraph.addTask([this, system] { system->fixedUpdate(this->clock.fixedStep); }, system->mainThreadOnly);
+
+        // Conflicting systems keep their registration order
+        for (size_t j = 0; j < i; j++)
+        {
+            if (registeredSystems[j]->conflictsWith(system))
+            {
+                updateGraph.precede(tasks[j], task);
+                fixedUpdateGraph.precede(fixedTasks[j], fixedTask);
+            }
+        }
+
+        tasks.push_back(task);
+        fixedTasks.push_back(fixedTask);
+    }
+
+    updateGraphSystemCount = registeredSystems.size();
 }
 
-void ProjectKoi::exit(Message * msg)
+void ProjectKoi::exit()
 {
     this->needsDestroying = true;
 }
 
+void ProjectKoi::setFrameLimit(float framesPerSecond)
+{
+    clock.setFrameLimit(framesPerSecond);
+}
+
 #ifndef ANDROID
 
-int main()
+int main(int argc, char ** argv)
 {
     ProjectKoi app;
 
     app.init();
 
+    app.renderSystem = new RenderSystem();
+
+    // --record <file> | --replay <file> [--replay-speed <x>] [--replay-exit]
+    // --headless <frames> [--capture <file.ppm>], 0 frames runs until Exit
+    // --frames-in-flight <n>, 1 to RENDERER_MAX_FRAMES_IN_FLIGHT
+    // --upload-budget <MB>, staging copies submitted per frame
+    // --gpu-profile <file.csv>, per pass GPU times of every frame
+    // --bench-recording, logs recording time against thread and model count
+    // --profile <frames>, captures a Chrome trace to profile.json
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--record") == 0 && i + 1 < argc)
+        {
+            app.replay.startRecording(argv[++i], app.clock.fixedStep);
+        }
+        else if (strcmp(argv[i], "--replay") == 0 && i + 1 < argc)
+        {
+            if (app.replay.startPlayback(argv[++i]))
+                app.clock.setFixedStep(app.replay.getFixedStep());
+        }
+        else if (strcmp(argv[i], "--replay-speed") == 0 && i + 1 < argc)
+        {
+            app.replay.speed = std::strtod(argv[++i], nullptr);
+        }
+        else if (strcmp(argv[i], "--replay-exit") == 0)
+        {
+            app.exitAfterReplay = true;
+        }
+        else if (strcmp(argv[i], "--headless") == 0 && i + 1 < argc)
+        {
+            app.renderSystem->headless = true;
+            app.renderSystem->headlessFrames = std::strtoul(argv[++i], nullptr, 10);
+        }
+        else if (strcmp(argv[i], "--capture") == 0 && i + 1 < argc)
+        {
+            app.renderSystem->captureFilename = argv[++i];
+        }
+        else if (strcmp(argv[i], "--frames-in-flight") == 0 && i + 1 < argc)
+        {
+            app.renderSystem->framesInFlight = std::strtoul(argv[++i], nullptr, 10);
+        }
+        else if (strcmp(argv[i], "--upload-budget") == 0 && i + 1 < argc)
+        {
+            app.renderSystem->uploadBudget = (VkDeviceSize) (std::strtod(argv[++i], nullptr) * 1024 * 1024);
+        }
+        else if (strcmp(argv[i], "--gpu-profile") == 0 && i + 1 < argc)
+        {
+            app.renderSystem->gpuProfileFilename = argv[++i];
+        }
+        else if (strcmp(argv[i], "--profile") == 0 && i + 1 < argc)
+        {
+            Profiler::startCapture(std::strtoul(argv[++i], nullptr, 10));
+        }
+        else if (strcmp(argv[i], "--bench-recording") == 0)
+        {
+            app.renderSystem->benchmarkRecording = true;
+        }
+        else
+        {
+            WARN("PROJECT_KOI - Unknown argument %s", argv[i]);
+        }
+    }
+
     app.inputSystem = new InputSystem();
     app.registerSystem(app.inputSystem);
 
-    app.renderSystem = new RenderSystem();
     app.registerSystem(app.renderSystem);
 
     app.run();
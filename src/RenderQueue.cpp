@@ -0,0 +1,184 @@
+#include <render/RenderQueue.h>
+#include <render/PipelineRegistry.h>
+
+#include <system/Profiler.h>
+
+#include <cstring>
+#include <algorithm>
+
+static_assert(RENDER_QUEUE_PASS_BITS + RENDER_QUEUE_PIPELINE_BITS + RENDER_QUEUE_MATERIAL_BITS + RENDER_QUEUE_MESH_BITS + RENDER_QUEUE_DEPTH_BITS == 64, "Render queue key fields must fill 64 bits");
+static_assert(PIPELINE_REGISTRY_MAX_PIPELINES <= (1 << RENDER_QUEUE_PIPELINE_BITS), "Pipeline ids don't fit the render queue key");
+
+RenderQueueStats RenderQueue::lastFrame;
+
+void RenderQueueStats::add(const RenderQueueStats & other)
+{
+    draws += other.draws;
+    pipelineBinds += other.pipelineBinds;
+    descriptorBinds += other.descriptorBinds;
+    vertexBinds += other.vertexBinds;
+    indexBinds += other.indexBinds;
+}
+
+// ===============================================================================================================
+//                                               Sort Keys
+// ===============================================================================================================
+
+uint64_t RenderQueue::makeKey(RenderQueuePass pass, uint32_t pipeline, uint32_t material, uint32_t mesh, float depth)
+{
+    // Non-negative floats order the same as their bits, the sign bit is dropped and the top
+    // RENDER_QUEUE_DEPTH_BITS of the rest are kept
+    depth = std::max(depth, 0.0f);
+
+    uint32_t depthBits;
+    memcpy(&depthBits, &depth, sizeof(depthBits));
+
+    uint64_t depthMask = (1ull << RENDER_QUEUE_DEPTH_BITS) - 1;
+    uint64_t depthKey = (depthBits >> (31 - RENDER_QUEUE_DEPTH_BITS)) & depthMask;
+
+    uint64_t state = ((uint64_t) (pipeline & ((1u << RENDER_QUEUE_PIPELINE_BITS) - 1)) << (RENDER_QUEUE_MATERIAL_BITS + RENDER_QUEUE_MESH_BITS)) |
+                     ((uint64_t) (material & ((1u << RENDER_QUEUE_MATERIAL_BITS) - 1)) << RENDER_QUEUE_MESH_BITS) |
+                     (uint64_t) (mesh & ((1u << RENDER_QUEUE_MESH_BITS) - 1));
+
+    uint64_t passKey = (uint64_t) pass << (64 - RENDER_QUEUE_PASS_BITS);
+
+    if (pass == RenderQueueBlended)
+        return passKey | ((depthMask - depthKey) << (64 - RENDER_QUEUE_PASS_BITS - RENDER_QUEUE_DEPTH_BITS)) | state;
+
+    return passKey | (state << RENDER_QUEUE_DEPTH_BITS) | depthKey;
+}
+
+// ===============================================================================================================
+//                                              Render Queue
+// ===============================================================================================================
+
+void RenderQueue::clear()
+{
+    packets.clear();
+    items.clear();
+}
+
+void RenderQueue::push(uint64_t key, const DrawPacket & packet)
+{
+    items.push_back({key, (uint32_t) packets.size()});
+    packets.push_back(packet);
+}
+
+void RenderQueue::sort()
+{
+    PROFILE_ZONE("Sort Render Queue");
+
+    uint32_t count = (uint32_t) items.size();
+
+    if (count < 2)
+        return;
+
+    // LSD radix sort a byte at a time, all histograms are built in one read of the keys
+    uint32_t histograms[8][256] = {};
+
+    for (uint32_t i = 0; i < count; i++)
+        for (uint32_t digit = 0; digit < 8; digit++)
+            histograms[digit][(items[i].key >> (digit * 8)) & 0xFF]++;
+
+    scratch.resize(count);
+
+    SortItem * source = items.data();
+    SortItem * destination = scratch.data();
+
+    for (uint32_t digit = 0; digit < 8; digit++)
+    {
+        uint32_t shift = digit * 8;
+        uint32_t * histogram = histograms[digit];
+
+        // Every key has the same byte here, the pass wouldn't move anything
+        if (histogram[(source[0].key >> shift) & 0xFF] == count)
+            continue;
+
+        uint32_t offset = 0;
+        for (uint32_t bucket = 0; bucket < 256; bucket++)
+        {
+            uint32_t bucketSize = histogram[bucket];
+            histogram[bucket] = offset;
+            offset += bucketSize;
+        }
+
+        for (uint32_t i = 0; i < count; i++)
+            destination[histogram[(source[i].key >> shift) & 0xFF]++] = source[i];
+
+        std::swap(source, destination);
+    }
+
+    if (source != items.data())
+        items.swap(scratch);
+}
+
+RenderQueueStats RenderQueue::record(VkCommandBuffer commandbuffer, VkDescriptorSet sceneDescriptorSet, VkBuffer instanceBuffer, uint32_t first, uint32_t last) const
+{
+    RenderQueueStats stats;
+
+    VkPipeline boundPipeline = VK_NULL_HANDLE;
+    VkPipelineLayout boundLayout = VK_NULL_HANDLE;
+    VkDescriptorSet boundMaterial = VK_NULL_HANDLE;
+    VkBuffer boundVertexBuffer = VK_NULL_HANDLE;
+    VkBuffer boundIndexBuffer = VK_NULL_HANDLE;
+
+    last = std::min(last, (uint32_t) items.size());
+
+    for (uint32_t i = first; i < last; i++)
+    {
+        const DrawPacket & packet = packets[items[i].packet];
+
+        if (packet.pipeline != boundPipeline)
+        {
+            vkCmdBindPipeline(commandbuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, packet.pipeline);
+            boundPipeline = packet.pipeline;
+            stats.pipelineBinds++;
+        }
+
+        // Layouts all start with the scene's set, so it stays bound when only the material's
+        // set layout differs
+        if (boundLayout == VK_NULL_HANDLE)
+        {
+            VkDescriptorSet descriptors[] = {sceneDescriptorSet, packet.material};
+            vkCmdBindDescriptorSets(commandbuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, packet.layout, 0, 2, descriptors, 0, nullptr);
+            stats.descriptorBinds++;
+
+            VkDeviceSize offsets[] = {0, 0};
+            VkBuffer vertexBuffers[] = {packet.vertexBuffer, instanceBuffer};
+            vkCmdBindVertexBuffers(commandbuffer, 0, 2, vertexBuffers, offsets);
+            stats.vertexBinds++;
+
+            boundLayout = packet.layout;
+            boundMaterial = packet.material;
+            boundVertexBuffer = packet.vertexBuffer;
+        }
+
+        if (packet.material != boundMaterial || packet.layout != boundLayout)
+        {
+            vkCmdBindDescriptorSets(commandbuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, packet.layout, 1, 1, &packet.material, 0, nullptr);
+            boundLayout = packet.layout;
+            boundMaterial = packet.material;
+            stats.descriptorBinds++;
+        }
+
+        if (packet.vertexBuffer != boundVertexBuffer)
+        {
+            VkDeviceSize offset = 0;
+            vkCmdBindVertexBuffers(commandbuffer, 0, 1, &packet.vertexBuffer, &offset);
+            boundVertexBuffer = packet.vertexBuffer;
+            stats.vertexBinds++;
+        }
+
+        if (packet.indexBuffer != boundIndexBuffer)
+        {
+            vkCmdBindIndexBuffer(commandbuffer, packet.indexBuffer, 0, VK_INDEX_TYPE_UINT32);
+            boundIndexBuffer = packet.indexBuffer;
+            stats.indexBinds++;
+        }
+
+        vkCmdDrawIndexed(commandbuffer, packet.indexCount, packet.instanceCount, packet.firstIndex, packet.vertexOffset, packet.firstInstance);
+        stats.draws++;
+    }
+
+    return stats;
+}
@@ -8,20 +8,42 @@
 
 void RenderSystem::init()
 {
-	context = new DesktopContext();
-	app->registerSystem(context);
+	setResourceAccess(ResourceInput, ResourceNone);
 
-	renderer = new DesktopRenderer((dynamic_cast<DesktopContext *> (context)));
-	app->registerSystem(renderer);
+	if (headless)
+	{
+		context = new HeadlessContext();
+		app->registerSystem(context);
 
-	scene = new Scene3D(context, renderer);
+		renderer = new HeadlessRenderer(dynamic_cast<HeadlessContext *> (context), headlessFrames, captureFilename, framesInFlight);
+		app->registerSystem(renderer);
+	}
+	else
+	{
+		context = new DesktopContext();
+		app->registerSystem(context);
+
+		renderer = new DesktopRenderer((dynamic_cast<DesktopContext *> (context)), framesInFlight);
+		app->registerSystem(renderer);
+	}
+
+	context->uploads.frameBudget = uploadBudget;
+
+	if (!gpuProfileFilename.empty())
+		renderer->profiler.startCSV(gpuProfileFilename);
+
+	Scene3D * scene3D = new Scene3D(context, renderer);
+	scene3D->benchmarkRecording = benchmarkRecording;
+
+	scene = scene3D;
 	app->registerSystem(scene);
 
-	gui = new GUI(dynamic_cast<DesktopContext *> (context), dynamic_cast<DesktopRenderer *> (renderer), app);
+	if (!headless)
+		gui = new GUI(dynamic_cast<DesktopContext *> (context), dynamic_cast<DesktopRenderer *> (renderer), app);
 
 	// Register Message Actions
-	setMessageCallback(SetWindowFocus, (message_method_t) &RenderSystem::onWindowFocus);
-	setMessageCallback(KeyPress, (message_method_t) &RenderSystem::onKeyPress);
+	setMessageCallback<SetWindowFocus>(&RenderSystem::onWindowFocus);
+	setMessageCallback<KeyPress>(&RenderSystem::onKeyPress);
 
 	DEBUG("RENDER_SYSTEM - RenderSystem Created");
 }
@@ -30,12 +52,16 @@ void RenderSystem::init()
 
 void RenderSystem::init()
 {
+	setResourceAccess(ResourceInput, ResourceNone);
+
 	context = new OVRContext(this->android_context);
 	app->registerSystem(context);
 
 	renderer = new OVRRenderer((dynamic_cast<OVRContext *> (context)));
 	app->registerSystem(renderer);
 
+	context->uploads.frameBudget = uploadBudget;
+
 	scene = new Scene3D(context, renderer);
 	app->registerSystem(scene);
 
@@ -44,27 +70,51 @@ void RenderSystem::init()
 
 #endif
 
-void RenderSystem::update(long elapsedTime)
+void RenderSystem::update(double elapsedTime)
 {
 
 }
 
 void RenderSystem::draw()
 {
-	VkCommandBuffer drawBuffer = renderer->getNextCommandBuffer();
+	PROFILE_ZONE("RenderSystem::draw");
+
+	{
+		PROFILE_ZONE("Uploads");
+		context->uploads.flush();
+	}
+
+	VkCommandBuffer drawBuffer;
+	{
+		PROFILE_ZONE("Acquire");
+		drawBuffer = renderer->getNextCommandBuffer();
+	}
+
 	scene->draw(drawBuffer);
 
 #ifndef ANDROID
-	gui->draw(drawBuffer);
+	if (gui != nullptr)
+	{
+		PROFILE_ZONE("GUI::draw");
+		gui->draw(drawBuffer);
+	}
 #endif
 
-	renderer->render(drawBuffer);
-	renderer->present();
+	{
+		PROFILE_ZONE("Submit");
+		renderer->render(drawBuffer);
+	}
+
+	{
+		PROFILE_ZONE("Present");
+		renderer->present();
+	}
 }
 
 RenderSystem::~RenderSystem()
 {
-	vkQueueWaitIdle(context->primaryGraphicsQueue->queue);
+	// Uploads on the transfer queue may still be writing to the scene's buffers and images
+	vkDeviceWaitIdle(context->device);
 #ifndef ANDROID
 	if (this->gui != nullptr) delete this->gui;
 #endif
@@ -75,13 +125,12 @@ RenderSystem::~RenderSystem()
 	DEBUG("RENDER_SYSTEM - RenderSystem Destroyed");
 }
 
-void RenderSystem::onKeyPress(Message * msg)
+void RenderSystem::onKeyPress(int keyCode)
 {
 
 }
 
-void RenderSystem::onWindowFocus(Message * msg)
+void RenderSystem::onWindowFocus(int focused)
 {
-	IntegerMessage * intmsg = dynamic_cast<IntegerMessage *> (msg);
-	paused = intmsg->data == 0;
+	paused = focused == 0;
 }
\ No newline at end of file
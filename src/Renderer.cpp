@@ -1,3 +1,6 @@
+#include <chrono>
+#include <limits>
+
 #include <render/Renderer.h>
 
 VkFormat chooseColorFormat(VkPhysicalDevice physicalDevice)
@@ -45,109 +48,89 @@ VkFormat chooseDepthFormat(VkPhysicalDevice physicalDevice)
     return depthFormat;
 }
 
-VkViewport Renderer::getDefaultVkViewport()
-{
-	VkViewport viewport = {};
-	viewport.x = 0.0f;
-	viewport.y = 0.0f;
-	viewport.width = this->extent.width;
-	viewport.height = this->extent.height;
-	viewport.minDepth = 0.0f;
-	viewport.maxDepth = 1.0f;
-
-    return viewport;
-}
+// ===============================================================================================================
+//                                             Frame Contexts
+// ===============================================================================================================
 
-VkRect2D Renderer::getDefaultScissor()
+void Renderer::createFrameContexts(VkDevice device, uint32_t queueFamilyIndex)
 {
-	VkRect2D scissor = {};
-	scissor.offset.x = 0;
-	scissor.offset.y = 0;
-	scissor.extent.width = this->extent.width;
-	scissor.extent.height = this->extent.height;
+    VALIDATE(framesInFlight > 0 && framesInFlight <= RENDERER_MAX_FRAMES_IN_FLIGHT, "RENDERER - Unsupported frames in flight %u", framesInFlight);
 
-    return scissor;
-}
+    frames.resize(framesInFlight);
 
-VkPipelineRasterizationStateCreateInfo Renderer::getDefaultRasterizer()
-{
-    VkPipelineRasterizationStateCreateInfo rasterizer = {};
-	rasterizer.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
-	rasterizer.depthClampEnable = VK_FALSE; // Enable for VR
-	rasterizer.rasterizerDiscardEnable = VK_FALSE;
-	rasterizer.polygonMode = VK_POLYGON_MODE_FILL;
-	rasterizer.lineWidth = 1.0f;
-	rasterizer.cullMode = VK_CULL_MODE_NONE;
-	rasterizer.frontFace = VK_FRONT_FACE_CLOCKWISE;
-	rasterizer.depthBiasEnable = VK_FALSE;
-	rasterizer.depthBiasConstantFactor = 0.0f;
-	rasterizer.depthBiasClamp = 0.0f;
-	rasterizer.depthBiasSlopeFactor = 0.0f;
-
-    return rasterizer;
-}
+    for (auto & frame : frames)
+    {
+        // Reset as a whole each frame, cheaper than resetting buffers one by one
+        VkCommandPoolCreateInfo poolInfo = {};
+        poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+        poolInfo.pNext = nullptr;
+        poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+        poolInfo.queueFamilyIndex = queueFamilyIndex;
 
-VkPipelineMultisampleStateCreateInfo Renderer::getDefaultMultisampling()
-{
-	VkPipelineMultisampleStateCreateInfo multisampling = {};
-	multisampling.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
-	multisampling.sampleShadingEnable = VK_FALSE;
-	multisampling.rasterizationSamples = this->sample_count;
-	multisampling.minSampleShading = 1.0f;
-	multisampling.pSampleMask = nullptr;
-	multisampling.alphaToCoverageEnable = VK_FALSE;
-	multisampling.alphaToOneEnable = VK_FALSE;
-
-    return multisampling;
+        int result = vkCreateCommandPool(device, &poolInfo, nullptr, &frame.commandPool);
+        VALIDATE(result == VK_SUCCESS, "RENDERER - Failed to create frame VkCommandPool %d", result);
+
+        VkCommandBufferAllocateInfo commandbufferInfo = {};
+        commandbufferInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        commandbufferInfo.pNext = nullptr;
+        commandbufferInfo.commandPool = frame.commandPool;
+        commandbufferInfo.commandBufferCount = 1;
+        commandbufferInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+
+        vkAllocateCommandBuffers(device, &commandbufferInfo, &frame.commandBuffer);
+
+        VkFenceCreateInfo fenceInfo = {};
+        fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+        fenceInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
+
+        vkCreateFence(device, &fenceInfo, nullptr, &frame.fence);
+
+        VkSemaphoreCreateInfo semaphoreInfo = {};
+        semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+
+        vkCreateSemaphore(device, &semaphoreInfo, nullptr, &frame.imageAvailable);
+        vkCreateSemaphore(device, &semaphoreInfo, nullptr, &frame.renderFinished);
+    }
+
+    currentFrame = 0;
+
+    DEBUG("RENDERER - %u Frames In Flight", framesInFlight);
 }
 
-VkPipelineDepthStencilStateCreateInfo Renderer::getDefaultDepthStencil()
+void Renderer::destroyFrameContexts(VkDevice device)
 {
-	VkPipelineDepthStencilStateCreateInfo depthStencil = {};
-	depthStencil.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
-	depthStencil.depthTestEnable = VK_TRUE;
-	depthStencil.depthWriteEnable = VK_TRUE;
-	depthStencil.depthCompareOp = VK_COMPARE_OP_LESS;
-	depthStencil.depthBoundsTestEnable = VK_FALSE;
-	depthStencil.minDepthBounds = 0.0f;
-	depthStencil.maxDepthBounds = 1.0f;
-	depthStencil.stencilTestEnable = VK_FALSE;
-	depthStencil.front = {};
-	depthStencil.back = {};
-
-    return depthStencil;
+    for (auto & frame : frames)
+    {
+        vkDestroySemaphore(device, frame.imageAvailable, nullptr);
+        vkDestroySemaphore(device, frame.renderFinished, nullptr);
+        vkDestroyFence(device, frame.fence, nullptr);
+        vkDestroyCommandPool(device, frame.commandPool, nullptr);
+    }
+
+    frames.clear();
 }
 
-void Renderer::getDefaultColorBlendAttachments(std::vector<VkPipelineColorBlendAttachmentState> & colorBlendAttachments)
+FrameContext & Renderer::waitForFrame(VkDevice device)
 {
+    PROFILE_ZONE("Fence Wait");
+
+    FrameContext & frame = frames[currentFrame];
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    vkWaitForFences(device, 1, &frame.fence, VK_TRUE, std::numeric_limits<uint64_t>::max());
+
+    fenceWaitTime = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    averageFenceWaitTime = (frameCount == 0) ? fenceWaitTime : averageFenceWaitTime * 0.9 + fenceWaitTime * 0.1;
+
+    // The fence stays signaled until the frame is submitted again, so a frame dropped
+    // between here and the submit can't leave the next wait hanging
+    vkResetCommandPool(device, frame.commandPool, 0);
 
-	VkPipelineColorBlendAttachmentState colorBlendAttachment = {};
-	colorBlendAttachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
-	colorBlendAttachment.blendEnable = VK_TRUE;
-	colorBlendAttachment.srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA;
-	colorBlendAttachment.dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
-	colorBlendAttachment.colorBlendOp = VK_BLEND_OP_ADD;
-	colorBlendAttachment.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
-	colorBlendAttachment.dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO;
-	colorBlendAttachment.alphaBlendOp = VK_BLEND_OP_ADD;
-
-	colorBlendAttachments.push_back(colorBlendAttachment);
+    return frame;
 }
 
-VkPipelineColorBlendStateCreateInfo Renderer::getDefaultColorBlend(std::vector<VkPipelineColorBlendAttachmentState> & colorBlendAttachments)
+void Renderer::advanceFrame()
 {
-	VkPipelineColorBlendStateCreateInfo colorBlending = {};
-	colorBlending.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
-	colorBlending.pNext = nullptr;
-	colorBlending.flags = 0;
-	colorBlending.logicOpEnable = VK_FALSE;
-	colorBlending.logicOp = VK_LOGIC_OP_COPY;
-	colorBlending.attachmentCount = colorBlendAttachments.size();
-	colorBlending.pAttachments = colorBlendAttachments.data();
-	colorBlending.blendConstants[0] = 0.0f;
-	colorBlending.blendConstants[1] = 0.0f;
-	colorBlending.blendConstants[2] = 0.0f;
-	colorBlending.blendConstants[3] = 0.0f;
-
-    return colorBlending;
+    currentFrame = (currentFrame + 1) % framesInFlight;
+    frameCount++;
 }
\ No newline at end of file
@@ -0,0 +1,329 @@
+#include <system/Replay.h>
+#include <system/System.h>
+
+// Complete payload types for the dispatchers
+#include <system/Payloads.h>
+
+#include <array>
+#include <utility>
+
+typedef void (*replay_dispatch_t)(MessageBus * bus, const unsigned char * data, uint32_t size);
+
+// Only recorded MessageTypes get a dispatcher, the rest may carry payloads with no codec
+template <MessageType T, bool Recorded = MessageRecorded<T>::value>
+struct ReplayDispatcher
+{
+	static constexpr replay_dispatch_t get() { return nullptr; }
+};
+
+template <MessageType T>
+struct ReplayDispatcher<T, true>
+{
+	static void dispatch(MessageBus * bus, const unsigned char * data, uint32_t size)
+	{
+		typedef ReplayCodec<message_payload_t<T>> codec_t;
+
+		typename codec_t::storage_t storage;
+		if (!codec_t::decode(data, size, storage))
+		{
+			WARN("REPLAY - Could not decode a recorded %u message", (uint32_t) T);
+			return;
+		}
+
+		// Straight to the untyped sendMessageNow, the typed one would drop it as live input
+		Message<T> msg(codec_t::getPayload(storage));
+		bus->sendMessageNow(&msg);
+	}
+
+	static constexpr replay_dispatch_t get() { return &dispatch; }
+};
+
+template <size_t... Types>
+constexpr std::array<replay_dispatch_t, MessageTypeCount> makeReplayDispatchTable(std::index_sequence<Types...>)
+{
+	return {{ReplayDispatcher<(MessageType) Types>::get()...}};
+}
+
+static const std::array<replay_dispatch_t, MessageTypeCount> replayDispatchTable = makeReplayDispatchTable(std::make_index_sequence<MessageTypeCount>());
+
+// ===============================================================================================================
+//                                             Payload Codecs
+// ===============================================================================================================
+
+void ReplayCodec<std::vector<std::string> *>::encode(replay_buffer_t & out, std::vector<std::string> * const & payload)
+{
+	uint32_t count = (uint32_t) payload->size();
+	const unsigned char * bytes = reinterpret_cast<const unsigned char *>(&count);
+	out.insert(out.end(), bytes, bytes + sizeof(count));
+
+	for (auto& string : *payload)
+	{
+		uint32_t length = (uint32_t) string.size();
+		bytes = reinterpret_cast<const unsigned char *>(&length);
+		out.insert(out.end(), bytes, bytes + sizeof(length));
+		out.insert(out.end(), string.begin(), string.end());
+	}
+}
+
+bool ReplayCodec<std::vector<std::string> *>::decode(const unsigned char * data, uint32_t size, storage_t & storage)
+{
+	uint32_t offset = 0;
+	uint32_t count;
+
+	if (size < sizeof(count))
+		return false;
+
+	memcpy(&count, data, sizeof(count));
+	offset += sizeof(count);
+
+	for (uint32_t i = 0; i < count; i++)
+	{
+		uint32_t length;
+
+		if (size - offset < sizeof(length))
+			return false;
+
+		memcpy(&length, data + offset, sizeof(length));
+		offset += sizeof(length);
+
+		if (size - offset < length)
+			return false;
+
+		storage.emplace_back(reinterpret_cast<const char *>(data + offset), length);
+		offset += length;
+	}
+
+	return true;
+}
+
+// ===============================================================================================================
+//                                                 Replay
+// ===============================================================================================================
+
+Replay::Replay()
+{
+	mode.store(ReplayIdle);
+}
+
+Replay::~Replay()
+{
+	stop();
+}
+
+bool Replay::startRecording(const std::string & filename, double fixedStep)
+{
+	stop();
+
+	file.open(filename, std::ios::binary | std::ios::trunc);
+	if (!file.is_open())
+	{
+		WARN("REPLAY - Could not open %s for recording", filename.c_str());
+		return false;
+	}
+
+	ReplayHeader header = {REPLAY_MAGIC, REPLAY_VERSION, fixedStep};
+	file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+
+	this->fixedStep = fixedStep;
+	this->frameCount = 0;
+	this->pending.clear();
+	this->mode.store(ReplayRecording);
+
+	INFO("REPLAY - Recording to %s", filename.c_str());
+
+	return true;
+}
+
+bool Replay::startPlayback(const std::string & filename)
+{
+	stop();
+
+	std::ifstream input(filename, std::ios::binary | std::ios::ate);
+	if (!input.is_open())
+	{
+		WARN("REPLAY - Could not open %s for playback", filename.c_str());
+		return false;
+	}
+
+	data.resize((size_t) input.tellg());
+	input.seekg(0);
+	input.read(reinterpret_cast<char *>(data.data()), data.size());
+
+	ReplayHeader header;
+	position = 0;
+
+	if (!read(&header, sizeof(header)) || header.magic != REPLAY_MAGIC || header.version != REPLAY_VERSION)
+	{
+		WARN("REPLAY - %s is not a version %u recording", filename.c_str(), REPLAY_VERSION);
+		data.clear();
+		return false;
+	}
+
+	this->fixedStep = header.fixedStep;
+	this->frameCount = 0;
+	this->recordedTime = 0.0;
+	this->startTime = std::chrono::steady_clock::now();
+	this->mode.store(ReplayPlaying);
+
+	INFO("REPLAY - Playing %s", filename.c_str());
+
+	return true;
+}
+
+void Replay::stop()
+{
+	if (mode == ReplayRecording)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+
+		file.write(reinterpret_cast<const char *>(pending.data()), pending.size());
+		file.close();
+		pending.clear();
+
+		INFO("REPLAY - Recorded %llu frames", (unsigned long long) frameCount);
+	}
+	else if (mode == ReplayPlaying)
+	{
+		double wallTime = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startTime).count();
+
+		INFO("REPLAY - Played %llu frames in %.1f ms, %.3f ms/frame (recorded %.1f ms)",
+		     (unsigned long long) frameCount, wallTime, (frameCount > 0) ? wallTime / frameCount : 0.0, recordedTime);
+
+		data.clear();
+	}
+
+	mode.store(ReplayIdle);
+}
+
+void Replay::append(replay_buffer_t & out, const void * data, size_t size)
+{
+	const unsigned char * bytes = static_cast<const unsigned char *>(data);
+	out.insert(out.end(), bytes, bytes + size);
+}
+
+void Replay::recordFrame(double elapsed)
+{
+	if (mode != ReplayRecording)
+		return;
+
+	ReplayRecordKind kind = ReplayRecordFrame;
+	file.write(reinterpret_cast<const char *>(&kind), sizeof(kind));
+	file.write(reinterpret_cast<const char *>(&elapsed), sizeof(elapsed));
+
+	std::lock_guard<std::mutex> lock(mutex);
+
+	file.write(reinterpret_cast<const char *>(pending.data()), pending.size());
+	pending.clear();
+
+	frameCount++;
+}
+
+void Replay::recordInput(const InputEvent & event)
+{
+	if (mode != ReplayRecording)
+		return;
+
+	ReplayRecordKind kind = ReplayRecordInput;
+	file.write(reinterpret_cast<const char *>(&kind), sizeof(kind));
+	file.write(reinterpret_cast<const char *>(&event), sizeof(event));
+}
+
+bool Replay::read(void * out, size_t size)
+{
+	if (data.size() - position < size)
+		return false;
+
+	memcpy(out, data.data() + position, size);
+	position += size;
+
+	return true;
+}
+
+bool Replay::peekKind(ReplayRecordKind kind)
+{
+	return position < data.size() && data[position] == kind;
+}
+
+bool Replay::nextFrame(double & elapsed)
+{
+	if (mode != ReplayPlaying)
+		return false;
+
+	// Skip whatever the previous frame left unread
+	while (position < data.size() && !peekKind(ReplayRecordFrame))
+	{
+		if (peekKind(ReplayRecordInput))
+		{
+			InputEvent event;
+			nextInput(event);
+		}
+		else if (peekKind(ReplayRecordMessage))
+		{
+			deliverMessages(nullptr);
+		}
+		else
+		{
+			WARN("REPLAY - Unknown record kind %u", (uint32_t) data[position]);
+			position = data.size();
+		}
+	}
+
+	if (!peekKind(ReplayRecordFrame))
+	{
+		stop();
+		return false;
+	}
+
+	position++;
+
+	if (!read(&elapsed, sizeof(elapsed)))
+	{
+		stop();
+		return false;
+	}
+
+	frameCount++;
+	recordedTime += elapsed;
+
+	return true;
+}
+
+void Replay::deliverMessages(MessageBus * bus)
+{
+	while (mode == ReplayPlaying && peekKind(ReplayRecordMessage))
+	{
+		uint16_t type;
+		uint32_t size;
+
+		position++;
+
+		if (!read(&type, sizeof(type)) || !read(&size, sizeof(size)) || data.size() - position < size || type >= MessageTypeCount)
+		{
+			WARN("REPLAY - Recording is truncated or corrupt");
+			position = data.size();
+			return;
+		}
+
+		const unsigned char * payload = data.data() + position;
+		position += size;
+
+		if (bus != nullptr && replayDispatchTable[type] != nullptr)
+			replayDispatchTable[type](bus, payload, size);
+	}
+}
+
+bool Replay::nextInput(InputEvent & event)
+{
+	if (mode != ReplayPlaying || !peekKind(ReplayRecordInput))
+		return false;
+
+	position++;
+
+	if (!read(&event, sizeof(event)))
+	{
+		position = data.size();
+		return false;
+	}
+
+	return true;
+}
\ No newline at end of file
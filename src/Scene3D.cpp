@@ -1,24 +1,195 @@
 #include <render/Scene3D.h>
 #include <render/Utilities.h>
 
+#include <chrono>
+#include <cstdio>
+#include <limits>
 #include <cstring>
+#include <algorithm>
+#include <unordered_map>
 
 void Scene3D::init()
 {
+    setResourceAccess(ResourceNone, ResourceScene);
+
     app->registerSystem(&camera);
 
-    setMessageCallback(SetLighting, (message_method_t) &Scene3D::updateLighting);
-    setMessageCallback(GetModelData, (message_method_t) &Scene3D::getModelData);
-    setMessageCallback(AddModel, (message_method_t) &Scene3D::addModel);
+    setMessageCallback<SetLighting>(&Scene3D::updateLighting);
+    setMessageCallback<GetModelData>(&Scene3D::getModelData);
+    setMessageCallback<AddModel>(&Scene3D::addModel);
+    setMessageCallback<SpawnInstance>(&Scene3D::spawnInstance);
+
+    createRecordSlots();
+}
+
+void Scene3D::update(double elapsedTime)
+{
+    collectModels();
+    updateBounds();
+}
+
+Entity Scene3D::spawn(ModelBase * model, const Mat4 & transform)
+{
+    Entity entity = entities.create();
+
+    entities.add<Transform>(entity, {transform});
+    entities.add<MeshRef>(entity, {model});
+    entities.add<Bounds>(entity);
+
+    return entity;
+}
+
+void Scene3D::collectModels()
+{
+    loaded.clear();
+    loader.collect(loaded);
+
+    for (auto & result : loaded)
+    {
+        this->models.push_back(result.model);
+        spawn(result.model, Mat4(1.0f));
+
+        for (auto & transform : result.spawns)
+            spawn(result.model, transform);
+    }
+}
+
+void Scene3D::updateBounds()
+{
+    ComponentPool<Transform> & transforms = entities.getPool<Transform>();
+
+    if (transforms.version == boundsVersion)
+        return;
+
+    // Transforms the model's box by center and extent instead of transforming all 8 corners
+    entities.each<Transform, MeshRef, Bounds>([](Entity entity, Transform & transform, MeshRef & mesh, Bounds & bounds)
+    {
+        Vec3 center = (mesh.model->boundsMax + mesh.model->boundsMin) * 0.5f;
+        Vec3 extent = (mesh.model->boundsMax - mesh.model->boundsMin) * 0.5f;
+
+        Vec3 worldCenter = Vec3(transform.matrix * Vec4(center, 1.0f));
+        Vec3 worldExtent = glm::abs(Vec3(transform.matrix[0])) * extent.x +
+                           glm::abs(Vec3(transform.matrix[1])) * extent.y +
+                           glm::abs(Vec3(transform.matrix[2])) * extent.z;
+
+        bounds.min = worldCenter - worldExtent;
+        bounds.max = worldCenter + worldExtent;
+    });
+
+    boundsVersion = transforms.version;
+}
+
+void Scene3D::prepareInstances()
+{
+    ComponentPool<Transform> & transforms = entities.getPool<Transform>();
+    ComponentPool<MeshRef> & meshes = entities.getPool<MeshRef>();
+
+    // ===== Group Transforms By Model =====
+
+    // Only when entities come and go, afterwards each model's transforms are one contiguous
+    // range of the dense array and of the instance buffer
+    if (transforms.structureVersion + meshes.version != drawRangesVersion)
+    {
+        auto getModel = [&](Entity entity) { MeshRef * mesh = meshes.find(entity); return (mesh != nullptr) ? mesh->model : nullptr; };
+
+        transforms.sort([&](Entity a, Entity b) { return getModel(a) < getModel(b); });
+
+        drawRanges.clear();
+
+        const Entity * owners = transforms.getEntities();
+        for (uint32_t i = 0; i < transforms.size(); i++)
+        {
+            ModelBase * model = getModel(owners[i]);
+
+            if (model == nullptr)
+                continue;
+
+            if (drawRanges.empty() || drawRanges.back().model != model)
+                drawRanges.push_back({model, i, 0});
+
+            drawRanges.back().instanceCount++;
+        }
+
+        drawRangesVersion = transforms.structureVersion + meshes.version;
+    }
+
+    // ===== Upload Transforms =====
+
+    uint32_t frame = renderer->currentFrame;
+    uint32_t count = transforms.size();
+
+    if (count == 0)
+        return;
+
+    UniformBuffer & buffer = instanceBuffers[frame];
+
+    if (count > instanceCapacities[frame])
+    {
+        // This frame's fence has been waited on, nothing is reading the old buffer
+        if (buffer.buffer != VK_NULL_HANDLE)
+            destroyBuffer(context, buffer.buffer, buffer.allocation);
+
+        instanceCapacities[frame] = std::max(count, instanceCapacities[frame] * 2);
+        VkDeviceSize size = instanceCapacities[frame] * sizeof(Transform);
+
+        createBuffer(context, size, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+                     VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                     &buffer.buffer, &buffer.allocation);
+
+        buffer.data = buffer.allocation.mapped;
+        instanceState.invalidate(frame);
+    }
+
+    instanceState.setVersion(transforms.version);
+
+    if (instanceState.needsUpload(frame))
+        memcpy(buffer.data, transforms.data(), count * sizeof(Transform));
+}
+
+void Scene3D::prepareUniforms()
+{
+    // Only after the renderer waited on this frame's fence, the GPU may be reading the others
+    uint32_t frame = renderer->currentFrame;
+
+    if (camera.bufferState.needsUpload(frame))
+        memcpy(camera.buffers[frame].data, &camera.data, sizeof(CameraData));
+
+    if (light.bufferState.needsUpload(frame))
+        memcpy(light.buffers[frame].data, &light.data, sizeof(DirectionalLightData));
 }
 
-void Scene3D::update(long elapsedTime)
+void Scene3D::buildRenderQueue()
 {
+    PROFILE_ZONE("Build Render Queue");
+
+    renderQueue.clear();
+
+    if (drawRanges.empty())
+        return;
+
+    const Transform * instances = entities.getPool<Transform>().data();
+
+    for (auto & range : drawRanges)
+    {
+        // A range is one instanced draw per shape, keyed by its nearest instance
+        float depth = std::numeric_limits<float>::max();
+
+        for (uint32_t i = range.firstInstance; i < range.firstInstance + range.instanceCount; i++)
+        {
+            Vec3 offset = Vec3(instances[i].matrix[3]) - camera.position;
+            depth = std::min(depth, glm::dot(offset, offset));
+        }
 
+        range.model->enqueue(renderQueue, range.firstInstance, range.instanceCount, depth);
+    }
+
+    renderQueue.sort();
 }
 
 void Scene3D::draw(VkCommandBuffer commandbuffer)
 {
+    PROFILE_ZONE("Scene3D::draw");
+
     VkClearValue clearColors[3];
     clearColors[0].color = {0.0f, 0.0f, 0.0f, 1.0f};
     clearColors[1].depthStencil = {1.0f, 0};
@@ -34,14 +205,191 @@ void Scene3D::draw(VkCommandBuffer commandbuffer)
     beginInfo.clearValueCount = 3;
     beginInfo.pClearValues = clearColors;
 
-    vkCmdBeginRenderPass(commandbuffer, &beginInfo, VK_SUBPASS_CONTENTS_INLINE);
+    prepareUniforms();
+    prepareInstances();
 
-    for (auto& model : models)
+    if (benchmarkRecording && !drawRanges.empty())
+        runRecordingBenchmark();
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    buildRenderQueue();
+
+    bool parallel = parallelRecording && recordChunkCount > 1 && renderQueue.size() >= SCENE3D_PARALLEL_RECORD_MIN_PACKETS;
+
+    RenderQueueStats stats;
+
+    uint32_t gpuScope = renderer->profiler.beginScope(commandbuffer, "Scene");
+
+    if (parallel)
+    {
+        vkCmdBeginRenderPass(commandbuffer, &beginInfo, VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+
+        resetRecordSlots();
+
+        recordQueue = &renderQueue;
+        app->jobs.run(recordGraph);
+
+        VkCommandBuffer secondaries[SCENE3D_MAX_RECORD_CHUNKS];
+        for (uint32_t i = 0; i < recordChunkCount; i++)
+        {
+            secondaries[i] = recordSlots[renderer->currentFrame][i].commandBuffer;
+            stats.add(recordStats[i]);
+        }
+
+        vkCmdExecuteCommands(commandbuffer, recordChunkCount, secondaries);
+    }
+    else
     {
-        model->draw(commandbuffer);
+        vkCmdBeginRenderPass(commandbuffer, &beginInfo, VK_SUBPASS_CONTENTS_INLINE);
+
+        stats = renderQueue.record(commandbuffer, descriptorSets[renderer->currentFrame], instanceBuffers[renderer->currentFrame].buffer, 0, renderQueue.size());
     }
 
+    RenderQueue::setLastFrame(stats);
+
     vkCmdEndRenderPass(commandbuffer);
+
+    renderer->profiler.endScope(commandbuffer, gpuScope);
+
+    recordTime = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    averageRecordTime = (renderer->frameCount == 0) ? recordTime : averageRecordTime * 0.9 + recordTime * 0.1;
+}
+
+// ===============================================================================================================
+//                                           Parallel Recording
+// ===============================================================================================================
+
+void Scene3D::createRecordSlots()
+{
+    // The thread calling run() records too
+    recordChunkCount = std::min(app->jobs.getWorkerCount() + 1, (uint32_t) SCENE3D_MAX_RECORD_CHUNKS);
+
+    recordSlots.resize(renderer->framesInFlight);
+
+    for (auto & slots : recordSlots)
+    {
+        slots.resize(recordChunkCount);
+
+        for (auto & slot : slots)
+        {
+            VkCommandPoolCreateInfo poolInfo = {};
+            poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+            poolInfo.pNext = nullptr;
+            poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+            poolInfo.queueFamilyIndex = context->primaryGraphicsQueue->index;
+
+            int result = vkCreateCommandPool(context->device, &poolInfo, nullptr, &slot.commandPool);
+            VALIDATE(result == VK_SUCCESS, "SCENE3D - Failed to create record VkCommandPool %d", result);
+
+            VkCommandBufferAllocateInfo commandbufferInfo = {};
+            commandbufferInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+            commandbufferInfo.pNext = nullptr;
+            commandbufferInfo.commandPool = slot.commandPool;
+            commandbufferInfo.commandBufferCount = 1;
+            commandbufferInfo.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+
+            result = vkAllocateCommandBuffers(context->device, &commandbufferInfo, &slot.commandBuffer);
+            VALIDATE(result == VK_SUCCESS, "SCENE3D - Failed to allocate secondary VkCommandBuffer %d", result);
+        }
+    }
+
+    recordGraph.clear();
+    for (uint32_t i = 0; i < recordChunkCount; i++)
+        recordGraph.addTask([this, i] { recordChunk(i, recordChunkCount); });
+
+    DEBUG("SCENE3D - Recording Draw Lists In Up To %u Chunks", recordChunkCount);
+}
+
+void Scene3D::resetRecordSlots()
+{
+    // Only after the renderer waited on this frame's fence, nothing pending uses the buffers
+    for (auto & slot : recordSlots[renderer->currentFrame])
+        vkResetCommandPool(context->device, slot.commandPool, 0);
+}
+
+void Scene3D::recordChunk(uint32_t chunk, uint32_t chunkCount)
+{
+    PROFILE_ZONE("Record Chunk");
+
+    // Packets cost about the same to record, an even split is even enough. Each chunk binds
+    // its first packet's state again
+    uint32_t count = recordQueue->size();
+    uint32_t first = (uint32_t) ((uint64_t) count * chunk / chunkCount);
+    uint32_t last = (uint32_t) ((uint64_t) count * (chunk + 1) / chunkCount);
+
+    VkCommandBuffer commandbuffer = recordSlots[renderer->currentFrame][chunk].commandBuffer;
+
+    VkCommandBufferInheritanceInfo inheritanceInfo = {};
+    inheritanceInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+    inheritanceInfo.pNext = nullptr;
+    inheritanceInfo.renderPass = this->renderPass;
+    inheritanceInfo.subpass = 0;
+    inheritanceInfo.framebuffer = this->framebuffers[renderer->currentImageIndex];
+
+    VkCommandBufferBeginInfo beginInfo = {};
+    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    beginInfo.pNext = nullptr;
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT | VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    beginInfo.pInheritanceInfo = &inheritanceInfo;
+
+    vkBeginCommandBuffer(commandbuffer, &beginInfo);
+
+    recordStats[chunk] = recordQueue->record(commandbuffer, descriptorSets[renderer->currentFrame], instanceBuffers[renderer->currentFrame].buffer, first, last);
+
+    vkEndCommandBuffer(commandbuffer);
+}
+
+void Scene3D::runRecordingBenchmark()
+{
+    benchmarkRecording = false;
+
+    // Larger scenes are stood in for by repeating the draw list, the buffers are never submitted
+    const uint32_t repeats[] = {1, 4, 16, 64, 256};
+    const uint32_t iterations = 20;
+
+    INFO("SCENE3D - Recording benchmark, %zu models, ms per frame", drawRanges.size());
+
+    RenderQueue queue;
+
+    for (uint32_t repeat : repeats)
+    {
+        queue.clear();
+        for (uint32_t i = 0; i < repeat; i++)
+            for (auto & range : drawRanges)
+                range.model->enqueue(queue, range.firstInstance, range.instanceCount, 0.0f);
+
+        queue.sort();
+        recordQueue = &queue;
+
+        char line[256];
+        int length = snprintf(line, sizeof(line), "%7u draws:", queue.size());
+
+        for (uint32_t threads = 1; threads <= recordChunkCount; threads = (threads < recordChunkCount) ? std::min(threads * 2, recordChunkCount) : threads + 1)
+        {
+            TaskGraph graph;
+            for (uint32_t i = 0; i < threads; i++)
+                graph.addTask([this, i, threads] { recordChunk(i, threads); });
+
+            double best = std::numeric_limits<double>::max();
+
+            for (uint32_t i = 0; i < iterations; i++)
+            {
+                resetRecordSlots();
+
+                std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+                app->jobs.run(graph);
+                best = std::min(best, std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+            }
+
+            if (length > 0 && length < (int) sizeof(line))
+                length += snprintf(line + length, sizeof(line) - length, "  %2u threads %8.3f", threads, best);
+        }
+
+        INFO("SCENE3D - %s", line);
+    }
+
+    resetRecordSlots();
 }
 
 Scene3D::Scene3D(Context * context, Renderer * renderer)
@@ -53,39 +401,46 @@ Scene3D::Scene3D(Context * context, Renderer * renderer)
 
     camera.extent = renderer->extent;
 
-    camera.buffers.resize(2);
+    camera.buffers.resize(renderer->framesInFlight);
+    camera.bufferState.resize(camera.buffers.size());
 	for (int i = 0; i < camera.buffers.size(); i++)
 	{
 		createBuffer(context, sizeof(CameraData), VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
                      VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-                     &camera.buffers[i].buffer, &camera.buffers[i].memory);
+                     &camera.buffers[i].buffer, &camera.buffers[i].allocation);
 
-        vkMapMemory(context->device, camera.buffers[i].memory, 0, sizeof(CameraData), 0, &camera.buffers[i].data);
+        camera.buffers[i].data = camera.buffers[i].allocation.mapped;
         memcpy(camera.buffers[i].data, &camera.data, sizeof(CameraData));
 	}
 
-    light.buffers.resize(2);
+    light.buffers.resize(renderer->framesInFlight);
+    light.bufferState.resize(light.buffers.size());
 	for (int i = 0; i < light.buffers.size(); i++)
 	{
 		createBuffer(context, sizeof(DirectionalLightData), VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
                      VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-                     &light.buffers[i].buffer, &light.buffers[i].memory);
+                     &light.buffers[i].buffer, &light.buffers[i].allocation);
 
-        vkMapMemory(context->device, light.buffers[i].memory, 0, sizeof(DirectionalLightData), 0, &light.buffers[i].data);
+        light.buffers[i].data = light.buffers[i].allocation.mapped;
         memcpy(light.buffers[i].data, &light.data, sizeof(DirectionalLightData));
 	}   
 
+    // Instance buffers are created on first use and grown as entities are added
+    instanceBuffers.resize(renderer->framesInFlight);
+    instanceCapacities.resize(renderer->framesInFlight, 0);
+    instanceState.resize(renderer->framesInFlight);
+
     // ===== Create VkDescriptorPool =====
 
     VkDescriptorPoolSize poolSize = {};
     poolSize.type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-    poolSize.descriptorCount = renderer->length * 2;
+    poolSize.descriptorCount = renderer->framesInFlight * 2;
 
     VkDescriptorPoolCreateInfo poolInfo = {};
     poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
     poolInfo.pNext = nullptr;
     poolInfo.flags = 0;
-    poolInfo.maxSets = renderer->length;
+    poolInfo.maxSets = renderer->framesInFlight;
     poolInfo.poolSizeCount = 1;
     poolInfo.pPoolSizes = &poolSize;
 
@@ -108,7 +463,7 @@ Scene3D::Scene3D(Context * context, Renderer * renderer)
     result = vkCreateDescriptorSetLayout(context->device, &layoutInfo, nullptr, &this->descriptorSetLayout);
     VALIDATE(result == VK_SUCCESS, "Failed to create VkDescriptorSetLayout %d", result);
 
-    std::vector<VkDescriptorSetLayout> layouts(renderer->length, this->descriptorSetLayout);
+    std::vector<VkDescriptorSetLayout> layouts(renderer->framesInFlight, this->descriptorSetLayout);
 
     VkDescriptorSetAllocateInfo allocInfo = {};
     allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
@@ -117,21 +472,21 @@ Scene3D::Scene3D(Context * context, Renderer * renderer)
     allocInfo.descriptorSetCount = layouts.size();
     allocInfo.pSetLayouts = layouts.data();
 
-    this->descriptorSets.resize(renderer->length);
+    this->descriptorSets.resize(renderer->framesInFlight);
     result = vkAllocateDescriptorSets(context->device, &allocInfo, this->descriptorSets.data());
     VALIDATE(result == VK_SUCCESS, "Failed to allocate VkDescriptorSets %d", result);
 
-    std::vector<VkWriteDescriptorSet> descriptorWrites(renderer->length * 2);
+    std::vector<VkWriteDescriptorSet> descriptorWrites(renderer->framesInFlight * 2);
 
     for (uint32_t i = 0; i < this->descriptorSets.size(); i++)
     {
         VkDescriptorBufferInfo bufferInfo1 = {};
-        bufferInfo1.buffer = camera.buffers[i % camera.buffers.size()].buffer;
+        bufferInfo1.buffer = camera.buffers[i].buffer;
         bufferInfo1.offset = 0;
         bufferInfo1.range = sizeof(CameraData);
 
         VkDescriptorBufferInfo bufferInfo2 = {};
-        bufferInfo2.buffer = light.buffers[i % light.buffers.size()].buffer;
+        bufferInfo2.buffer = light.buffers[i].buffer;
         bufferInfo2.offset = 0;
         bufferInfo2.range = sizeof(DirectionalLightData);
 
@@ -172,6 +527,18 @@ Scene3D::Scene3D(Context * context, Renderer * renderer)
         framebuffers[i] = createVkFramebuffer(context->device, nullptr, 0, this->renderPass, renderer->colorImageView, renderer->depthImageView, renderer->imageviews[i], renderer->extent.width, renderer->extent.height, 1);
     }
 
+    // ===== Create Pipeline Registry =====
+
+    pipelines.create(context);
+
+    // ===== Create Geometry Arena =====
+
+    geometry.create(context);
+
+    // ===== Create Model Loader =====
+
+    loader.create(context, renderer, this);
+
     DEBUG("SCENE3D - Scene Created");
 }
 
@@ -179,20 +546,25 @@ Scene3D::~Scene3D()
 {
     // TODO: Cleanup
 
+    // Before the arena and registry its threads upload to
+    loader.destroy();
+
     for (int i = 0; i < camera.buffers.size(); i++)
-    {
-        vkUnmapMemory(context->device, camera.buffers[i].memory);
-        vkDestroyBuffer(context->device, camera.buffers[i].buffer, nullptr);
-        vkFreeMemory(context->device, camera.buffers[i].memory, nullptr);
-    }
+        destroyBuffer(context, camera.buffers[i].buffer, camera.buffers[i].allocation);
 
     for (int i = 0; i < light.buffers.size(); i++)
+        destroyBuffer(context, light.buffers[i].buffer, light.buffers[i].allocation);
+
+    for (auto& buffer : instanceBuffers)
     {
-        vkUnmapMemory(context->device, light.buffers[i].memory);
-        vkDestroyBuffer(context->device, light.buffers[i].buffer, nullptr);
-        vkFreeMemory(context->device, light.buffers[i].memory, nullptr);
+        if (buffer.buffer != VK_NULL_HANDLE)
+            destroyBuffer(context, buffer.buffer, buffer.allocation);
     }
 
+    for (auto & slots : recordSlots)
+        for (auto & slot : slots)
+            vkDestroyCommandPool(context->device, slot.commandPool, nullptr);
+
     for (auto & framebuffer : this->framebuffers)
         vkDestroyFramebuffer(context->device, framebuffer, nullptr);
 
@@ -204,6 +576,9 @@ Scene3D::~Scene3D()
     for (auto& model : models)
         delete model;
 
+    pipelines.destroy();
+    geometry.destroy();
+
     DEBUG("SCENE3D - Scene Destroyed");
 }
 
@@ -231,37 +606,62 @@ VkDescriptorSetLayoutBinding DirectionalLight::getVkDescriptorSetLayoutBinding(u
     return layoutBinding;
 }
 
-void Scene3D::updateLighting(Message * msg)
+void Scene3D::updateLighting(const DirectionalLightData & data)
 {
-    DirectionalLightData * data = (DirectionalLightData *) (dynamic_cast<PointerMessage *> (msg))->data;
+    if (memcmp(&data, &this->light.data, sizeof(DirectionalLightData)) == 0)
+        return;
 
-    this->light.data = *data;
+    this->light.data = data;
+    this->light.bufferState.markDirty();
+}
 
-    memcpy(this->light.buffers[renderer->currentImageIndex % this->light.buffers.size()].data, &this->light.data, sizeof(DirectionalLightData));
+void Scene3D::addModel(std::vector<std::string> * args)
+{
+    // Parsed, decoded and uploaded off the frame, collectModels adds it once it's resident
+    loader.request((*args)[1], (*args)[2]);
 }
 
-void Scene3D::addModel(Message * msg)
+void Scene3D::spawnInstance(const SpawnData & data)
 {
-    std::vector<std::string> * args = (std::vector<std::string> *) (dynamic_cast<PointerMessage *> (msg))->data;
+    Mat4 transform = glm::translate(Mat4(1.0f), Vec3(data.position.x, data.position.y, data.position.z));
 
-    try
-    {
-        this->models.push_back(new TexturedModel((*args)[1], (*args)[2], context, renderer, this));
-    }
-    catch(const std::exception& e)
+    // Collected in the order they were requested, so sorted by id
+    auto model = std::lower_bound(this->models.begin(), this->models.end(), data.model, [](ModelBase * model, uint32_t id) { return model->id < id; });
+
+    if (model != this->models.end() && (*model)->id == data.model)
     {
-        WARN("Failed to load model %s", (*args)[1].c_str());
+        spawn(*model, transform);
+        return;
     }
-    
+
+    // Still loading, spawned once it's resident
+    if (!loader.spawnWhenCollected(data.model, transform))
+        WARN("SCENE3D - No model with id %u", data.model);
 }
 
-void Scene3D::getModelData(Message * msg)
+void Scene3D::getModelData(std::vector<ModelData> * models)
 {
-    std::vector<ModelData> * models = (std::vector<ModelData> *) (dynamic_cast<PointerMessage *> (msg))->data;
+    // One pass over the entities, polled every frame while something is loading
+    std::unordered_map<ModelBase *, uint32_t> instanceCounts;
+    instanceCounts.reserve(this->models.size());
+
+    entities.each<MeshRef>([&](Entity entity, MeshRef & mesh)
+    {
+        instanceCounts[mesh.model]++;
+    });
 
     for (int i = 0; i < this->models.size(); i++)
     {
-        ModelData m = {(uint32_t) i, this->models[i]->name, (uint32_t) this->models[i]->instances.size()};
+        ModelData m = {this->models[i]->id, this->models[i]->name, instanceCounts[this->models[i]]};
+        models->push_back(m);
+    }
+
+    std::vector<ModelLoadProgress> loads;
+    loader.getProgress(loads);
+
+    for (uint32_t i = 0; i < loads.size(); i++)
+    {
+        ModelData m = {loads[i].id, loads[i].name, 0, true, loads[i].progress};
         models->push_back(m);
     }
 }
\ No newline at end of file
@@ -0,0 +1,28 @@
+#include <render/Shaders.h>
+
+// The build writes each shader's SPIR-V words as a comma separated list (glslc -mfmt=num)
+
+static const uint32_t vertexShaderCode[] =
+{
+#include <shaders/vert.inc>
+};
+
+static const uint32_t fragmentShaderCode[] =
+{
+#include <shaders/frag.inc>
+};
+
+static const EmbeddedShader embeddedShaders[] =
+{
+    {"shader.vert", vertexShaderCode, sizeof(vertexShaderCode)},
+    {"shader.frag", fragmentShaderCode, sizeof(fragmentShaderCode)}
+};
+
+const EmbeddedShader * findEmbeddedShader(const std::string & name)
+{
+    for (auto & shader : embeddedShaders)
+        if (name == shader.name)
+            return &shader;
+
+    return nullptr;
+}
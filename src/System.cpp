@@ -1,22 +1,52 @@
 #include <system/System.h>
 
-void System::handleMessage(Message * msg)
+void System::handleMessage(const MessageHeader * msg)
 {
 	auto action = messageActions.find(msg->type);
 
-	if (action != messageActions.end())
-		(this->*(action->second))(msg);
+	if (action == messageActions.end())
+		return;
+
+#ifdef KOI_MESSAGE_STATS
+	frame_clock_t::time_point start = frame_clock_t::now();
+#endif
+
+	action->second.invoke(this, action->second.method, msg);
+
+#ifdef KOI_MESSAGE_STATS
+	if (app != nullptr)
+		app->messageStats.recordHandler(this, msg->type, std::chrono::duration_cast<std::chrono::nanoseconds>(frame_clock_t::now() - start).count());
+#endif
+}
+
+void System::setMessageCallback(MessageType type, message_method_t method, message_invoker_t invoke)
+{
+	messageActions[type] = {this, method, invoke};
+
+	if (app != nullptr)
+		app->subscribe(this, type, method, invoke);
+}
+
+void System::setResourceAccess(uint32_t reads, uint32_t writes, bool mainThreadOnly)
+{
+	this->reads = reads;
+	this->writes = writes;
+	this->mainThreadOnly = mainThreadOnly;
 }
 
-void System::setMessageCallback(MessageType type, message_method_t methodName)
+bool System::conflictsWith(const System * other) const
 {
-	messageActions[type] = methodName;
+	return (this->writes & (other->reads | other->writes)) != 0 || (this->reads & other->writes) != 0;
 }
 
 void MessageBus::registerSystem(System * s)
 {
     s->app = this;
 
+    // Callbacks set before registration (e.g. in constructors) are indexed now
+    for (auto& action : s->messageActions)
+        subscribe(s, action.first, action.second.method, action.second.invoke);
+
     registeredSystems.push_back(s);
 
     s->init();
@@ -28,67 +58,57 @@ void MessageBus::destroySystems()
         delete system;
 
     registeredSystems.clear();
-}
 
-void MessageBus::sendMessage(MessageType type)
-{
-    sendMessage(new EmptyMessage(type));
+    for (auto& list : subscribers)
+        list.clear();
 }
 
-void MessageBus::sendMessage(MessageType type, void * data)
+void MessageBus::subscribe(System * s, MessageType type, message_method_t method, message_invoker_t invoke)
 {
-    sendMessage(new PointerMessage(type, data));
-}
+    std::vector<MessageSubscriber> & list = subscribers[type];
 
-void MessageBus::sendMessage(MessageType type, int data)
-{
-    sendMessage(new IntegerMessage(type, data));
-}
+    for (auto& subscriber : list)
+    {
+        if (subscriber.system == s)
+        {
+            subscriber.method = method;
+            subscriber.invoke = invoke;
+            return;
+        }
+    }
 
-void MessageBus::sendMessage(MessageType type, std::string str)
-{
-    sendMessage(new StringMessage(type, str));
-}
+    MessageSubscriber subscriber = {s, method, invoke};
+#ifdef KOI_MESSAGE_STATS
+    subscriber.statsIndex = messageStats.registerHandler(s, type);
+#endif
 
-void MessageBus::sendMessage(MessageType type, float * data, int length)
-{
-    sendMessage(new VectorMessage(type, data, length));
+    list.push_back(subscriber);
 }
 
-void MessageBus::sendMessage(Message * msg)
+// Messages passed here are owned by the caller (stack or MessageQueue slot)
+void MessageBus::sendMessageNow(const MessageHeader * msg)
 {
-    msgQueue.push(msg);
-}
+    std::vector<MessageSubscriber> & list = subscribers[msg->type];
 
-void MessageBus::sendMessageNow(MessageType type)
-{
-    sendMessageNow(new EmptyMessage(type));
-}
+#ifdef KOI_MESSAGE_STATS
+    // One clock read per handler, each handler ends where the next one starts
+    frame_clock_t::time_point dispatchStart = frame_clock_t::now();
+    frame_clock_t::time_point start = dispatchStart;
+#endif
 
-void MessageBus::sendMessageNow(MessageType type, void * data)
-{
-    sendMessageNow(new PointerMessage(type, data));
-}
-
-void MessageBus::sendMessageNow(MessageType type, int data)
-{
-    sendMessageNow(new IntegerMessage(type, data));
-}
+    // Indexed loop, handlers may subscribe new systems while we dispatch
+    for (size_t i = 0; i < list.size(); i++)
+    {
+        list[i].invoke(list[i].system, list[i].method, msg);
 
-void MessageBus::sendMessageNow(MessageType type, std::string str)
-{
-    sendMessageNow(new StringMessage(type, str));
-}
-
-void MessageBus::sendMessageNow(MessageType type, float * data, int length)
-{
-    sendMessageNow(new VectorMessage(type, data, length));
-}
-
-void MessageBus::sendMessageNow(Message * msg)
-{
-    for (auto& system : registeredSystems)
-        system->handleMessage(msg);
+#ifdef KOI_MESSAGE_STATS
+        frame_clock_t::time_point end = frame_clock_t::now();
+        messageStats.recordHandler(list[i].statsIndex, std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count());
+        start = end;
+#endif
+    }
 
-    delete msg;
+#ifdef KOI_MESSAGE_STATS
+    messageStats.recordDispatch(msg->type, std::chrono::duration_cast<std::chrono::nanoseconds>(start - dispatchStart).count());
+#endif
 }
\ No newline at end of file
@@ -0,0 +1,379 @@
+#include <render/UploadBatcher.h>
+#include <render/Context.h>
+#include <render/Utilities.h>
+
+#include <system/Log.h>
+
+#include <cstring>
+#include <limits>
+
+void UploadBatcher::create(Context * context)
+{
+    this->context = context;
+
+    createBuffer(context, UPLOAD_RING_SIZE, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                 VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                 &ringBuffer, &ringAllocation);
+
+    VkCommandPoolCreateInfo poolInfo = context->primaryTransferQueue->getVkCommandPoolCreateInfo();
+
+    int result = vkCreateCommandPool(context->device, &poolInfo, nullptr, &commandPool);
+    VALIDATE(result == VK_SUCCESS, "UPLOAD_BATCHER - Failed to create VkCommandPool %d", result);
+
+    for (auto & batch : batches)
+    {
+        VkCommandBufferAllocateInfo allocInfo = {};
+        allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        allocInfo.pNext = nullptr;
+        allocInfo.commandPool = commandPool;
+        allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+        allocInfo.commandBufferCount = 1;
+
+        vkAllocateCommandBuffers(context->device, &allocInfo, &batch.commandBuffer);
+
+        VkFenceCreateInfo fenceInfo = {};
+        fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+
+        vkCreateFence(context->device, &fenceInfo, nullptr, &batch.fence);
+    }
+
+    DEBUG("UPLOAD_BATCHER - Upload Batcher Created, %llu byte staging ring", (unsigned long long) UPLOAD_RING_SIZE);
+}
+
+void UploadBatcher::destroy()
+{
+    if (context == nullptr)
+        return;
+
+    retire(true);
+
+    if (!pending.empty())
+        DEBUG("UPLOAD_BATCHER - Dropped %zu pending uploads, %llu bytes", pending.size(), (unsigned long long) pendingBytes);
+
+    for (auto & upload : pending)
+    {
+        if (upload.stagingBuffer != ringBuffer)
+            destroyBuffer(context, upload.stagingBuffer, upload.stagingAllocation);
+    }
+
+    pending.clear();
+    pendingBytes = 0;
+
+    for (auto & batch : batches)
+        vkDestroyFence(context->device, batch.fence, nullptr);
+
+    vkDestroyCommandPool(context->device, commandPool, nullptr);
+    destroyBuffer(context, ringBuffer, ringAllocation);
+
+    context = nullptr;
+}
+
+// ===============================================================================================================
+//                                               Requests
+// ===============================================================================================================
+
+UploadTicket UploadBatcher::uploadBuffer(VkBuffer buffer, VkDeviceSize offset, const void * data, VkDeviceSize size)
+{
+    Upload upload;
+    upload.buffer = buffer;
+    upload.offset = offset;
+    upload.size = size;
+
+    return request(upload, data);
+}
+
+UploadTicket UploadBatcher::uploadImage(VkImage image, VkExtent3D extent, uint32_t layers, const void * data, VkDeviceSize size)
+{
+    Upload upload;
+    upload.image = image;
+    upload.extent = extent;
+    upload.layers = layers;
+    upload.size = size;
+
+    return request(upload, data);
+}
+
+bool UploadBatcher::reserveRing(VkDeviceSize size, VkDeviceSize * offset, VkDeviceSize * bytes)
+{
+    size = (size + UPLOAD_RING_ALIGNMENT - 1) / UPLOAD_RING_ALIGNMENT * UPLOAD_RING_ALIGNMENT;
+
+    if (ringUsed == 0)
+        ringHead = ringTail = 0;
+
+    if (ringUsed + size > UPLOAD_RING_SIZE)
+        return false;
+
+    if (ringHead >= ringTail)
+    {
+        // Free space is past the head and before the tail. Wrapping around gives up what's left
+        // at the end until this upload retires
+        if (ringHead + size <= UPLOAD_RING_SIZE)
+        {
+            *offset = ringHead;
+            *bytes = size;
+        }
+        else if (size <= ringTail)
+        {
+            *offset = 0;
+            *bytes = UPLOAD_RING_SIZE - ringHead + size;
+        }
+        else
+        {
+            return false;
+        }
+    }
+    else if (ringHead + size <= ringTail)
+    {
+        *offset = ringHead;
+        *bytes = size;
+    }
+    else
+    {
+        return false;
+    }
+
+    ringHead = *offset + size;
+    ringUsed += *bytes;
+
+    return true;
+}
+
+UploadTicket UploadBatcher::request(Upload & upload, const void * data)
+{
+    if (upload.size == 0)
+        return UPLOAD_TICKET_NONE;
+
+    uint8_t * staging;
+    Upload * queued;
+    UploadTicket ticket;
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+
+        if (reserveRing(upload.size, &upload.stagingOffset, &upload.ringBytes))
+        {
+            upload.stagingBuffer = ringBuffer;
+            upload.ringEnd = ringHead;
+            staging = (uint8_t *) ringAllocation.mapped + upload.stagingOffset;
+        }
+        else
+        {
+            // Larger than the ring, or the ring is taken by uploads the GPU hasn't finished
+            createStagingBuffer(context, upload.size, &upload.stagingBuffer, &upload.stagingAllocation);
+            staging = (uint8_t *) upload.stagingAllocation.mapped;
+        }
+
+        upload.ticket = ticket = ++lastTicket;
+
+        // References to the deque's elements survive pushes and pops at the ends
+        pending.push_back(upload);
+        pendingBytes += upload.size;
+        queued = &pending.back();
+    }
+
+    memcpy(staging, data, (size_t) upload.size);
+
+    std::lock_guard<std::mutex> lock(mutex);
+    queued->written = true;
+
+    return ticket;
+}
+
+// ===============================================================================================================
+//                                               Batches
+// ===============================================================================================================
+
+void UploadBatcher::retire(bool wait)
+{
+    while (batchesInFlight > 0)
+    {
+        Batch & batch = batches[oldestBatch];
+
+        if (wait)
+            vkWaitForFences(context->device, 1, &batch.fence, VK_TRUE, std::numeric_limits<uint64_t>::max());
+        else if (vkGetFenceStatus(context->device, batch.fence) != VK_SUCCESS)
+            break;
+
+        for (uint32_t i = 0; i < batch.stagingBuffers.size(); i++)
+            destroyBuffer(context, batch.stagingBuffers[i], batch.stagingAllocations[i]);
+
+        batch.stagingBuffers.clear();
+        batch.stagingAllocations.clear();
+
+        // Batches retire in the order their ring space was reserved
+        if (batch.ringBytes > 0)
+        {
+            ringUsed -= batch.ringBytes;
+            ringTail = batch.ringEnd;
+        }
+
+        completed.store(batch.lastTicket, std::memory_order_release);
+
+        oldestBatch = (oldestBatch + 1) % UPLOAD_MAX_BATCHES;
+        batchesInFlight--;
+    }
+}
+
+void UploadBatcher::record(Batch & batch)
+{
+    batch.lastTicket = submitting.back().ticket;
+    batch.ringBytes = 0;
+
+    VkCommandBufferBeginInfo beginInfo = {};
+    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+    vkBeginCommandBuffer(batch.commandBuffer, &beginInfo);
+
+    // ===== Images To Transfer Destination =====
+
+    imageBarriers.clear();
+
+    for (auto & upload : submitting)
+    {
+        if (upload.image == VK_NULL_HANDLE)
+            continue;
+
+        VkImageMemoryBarrier barrier = {};
+        barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+        barrier.srcAccessMask = 0;
+        barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.image = upload.image;
+        barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        barrier.subresourceRange.baseMipLevel = 0;
+        barrier.subresourceRange.levelCount = 1;
+        barrier.subresourceRange.baseArrayLayer = 0;
+        barrier.subresourceRange.layerCount = upload.layers;
+
+        imageBarriers.push_back(barrier);
+    }
+
+    if (!imageBarriers.empty())
+        vkCmdPipelineBarrier(batch.commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                             0, 0, nullptr, 0, nullptr, imageBarriers.size(), imageBarriers.data());
+
+    // ===== Copies =====
+
+    regions.clear();
+
+    for (uint32_t i = 0; i < submitting.size(); i++)
+    {
+        Upload & upload = submitting[i];
+
+        if (upload.stagingBuffer == ringBuffer)
+        {
+            batch.ringBytes += upload.ringBytes;
+            batch.ringEnd = upload.ringEnd;
+        }
+        else
+        {
+            batch.stagingBuffers.push_back(upload.stagingBuffer);
+            batch.stagingAllocations.push_back(upload.stagingAllocation);
+        }
+
+        if (upload.image != VK_NULL_HANDLE)
+        {
+            VkBufferImageCopy region = {};
+            region.bufferOffset = upload.stagingOffset;
+            region.bufferRowLength = 0;
+            region.bufferImageHeight = 0;
+            region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+            region.imageSubresource.mipLevel = 0;
+            region.imageSubresource.baseArrayLayer = 0;
+            region.imageSubresource.layerCount = upload.layers;
+            region.imageOffset = {0, 0, 0};
+            region.imageExtent = upload.extent;
+
+            vkCmdCopyBufferToImage(batch.commandBuffer, upload.stagingBuffer, upload.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+            continue;
+        }
+
+        VkBufferCopy region = {};
+        region.srcOffset = upload.stagingOffset;
+        region.dstOffset = upload.offset;
+        region.size = upload.size;
+
+        regions.push_back(region);
+
+        // Runs of copies between the same two buffers, e.g. a model's shapes into one arena block, go in one command
+        bool last = (i + 1 == submitting.size()) || submitting[i + 1].image != VK_NULL_HANDLE ||
+                    submitting[i + 1].stagingBuffer != upload.stagingBuffer || submitting[i + 1].buffer != upload.buffer;
+
+        if (last)
+        {
+            vkCmdCopyBuffer(batch.commandBuffer, upload.stagingBuffer, upload.buffer, regions.size(), regions.data());
+            regions.clear();
+        }
+    }
+
+    // ===== Images To Shader Read =====
+
+    // The transfer queue has no shader stages. Draws only sample an image after the batch's
+    // fence has signaled, which orders them after the transition
+    for (auto & barrier : imageBarriers)
+    {
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask = 0;
+        barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    }
+
+    if (!imageBarriers.empty())
+        vkCmdPipelineBarrier(batch.commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+                             0, 0, nullptr, 0, nullptr, imageBarriers.size(), imageBarriers.data());
+
+    vkEndCommandBuffer(batch.commandBuffer);
+}
+
+void UploadBatcher::flush()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    retire(false);
+
+    lastFrame = UploadBatcherStats();
+
+    if (batchesInFlight < UPLOAD_MAX_BATCHES)
+    {
+        submitting.clear();
+
+        // At least one upload a frame however large, nothing waits on the budget forever
+        while (!pending.empty() && pending.front().written &&
+               (lastFrame.bytes == 0 || lastFrame.bytes + pending.front().size <= frameBudget))
+        {
+            lastFrame.bytes += pending.front().size;
+            pendingBytes -= pending.front().size;
+
+            submitting.push_back(pending.front());
+            pending.pop_front();
+        }
+
+        if (!submitting.empty())
+        {
+            Batch & batch = batches[(oldestBatch + batchesInFlight) % UPLOAD_MAX_BATCHES];
+
+            record(batch);
+
+            VkSubmitInfo submitInfo = {};
+            submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+            submitInfo.commandBufferCount = 1;
+            submitInfo.pCommandBuffers = &batch.commandBuffer;
+
+            vkResetFences(context->device, 1, &batch.fence);
+
+            VkResult result = vkQueueSubmit(context->primaryTransferQueue->queue, 1, &submitInfo, batch.fence);
+            VALIDATE(result == VK_SUCCESS, "UPLOAD_BATCHER - Failed to submit uploads %d", result);
+
+            batchesInFlight++;
+            lastFrame.copies = submitting.size();
+        }
+    }
+
+    lastFrame.batchesInFlight = batchesInFlight;
+    lastFrame.pending = pending.size();
+    lastFrame.pendingBytes = pendingBytes;
+}
@@ -23,7 +23,7 @@ void createVkImage(Context * context,
                    VkImageUsageFlags usage,
                    VkMemoryPropertyFlags properties,
                    VkImage * image,
-                   VkDeviceMemory * imageMemory)
+                   DeviceAllocation * imageAllocation)
 {
 	VkExtent3D e = {};
 	e.width = extent.width;
@@ -31,7 +31,7 @@ void createVkImage(Context * context,
 	e.depth = 1;
 
 	createVkImage(context, imageType, format, e, miplevels, arrayLayers, samples,
-	              tiling, usage, properties, image, imageMemory);
+	              tiling, usage, properties, image, imageAllocation);
 }
 
 void createVkImage(Context * context,
@@ -45,97 +45,12 @@ void createVkImage(Context * context,
                    VkImageUsageFlags usage,
                    VkMemoryPropertyFlags properties,
                    VkImage * image,
-                   VkDeviceMemory * imageMemory)
-{
-	const void * pNext = nullptr;
-	uint32_t flags = (arrayLayers == 6) ? VK_IMAGE_CREATE_CUBE_COMPATIBLE_BIT : 0;
-	VkSharingMode sharingMode = (context->queueIndices.size() > 1) ? VK_SHARING_MODE_CONCURRENT : VK_SHARING_MODE_EXCLUSIVE;
-	uint32_t queueFamilyIndexCount = context->queueIndices.size();
-	const uint32_t * pQueueFamilyIndices = context->queueIndices.data();
-	VkImageLayout initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-
-	createVkImage(context->physicalDevice, context->device, pNext, flags, imageType, format, extent,
-	              miplevels, arrayLayers, samples, tiling, usage, sharingMode, queueFamilyIndexCount,
-	              pQueueFamilyIndices, initialLayout, properties, image, imageMemory);
-}
-
-void createVkImage(VkPhysicalDevice physicalDevice,
-                   VkDevice device,
-                   VkImageType imageType,
-                   VkFormat format,
-                   VkExtent2D extent,
-                   uint32_t miplevels,
-                   uint32_t arrayLayers,
-                   VkSampleCountFlagBits samples,
-                   VkImageTiling tiling,
-                   VkImageUsageFlags usage,
-                   VkSharingMode sharingMode,
-                   uint32_t queueFamilyIndexCount,
-                   const uint32_t * pQueueFamilyIndices,
-                   VkMemoryPropertyFlags properties,
-                   VkImage * image,
-                   VkDeviceMemory * imageMemory)
-{
-	VkExtent3D e = {};
-	e.width = extent.width;
-	e.height = extent.height;
-	e.depth = 1;
-
-	createVkImage(physicalDevice, device, imageType, format, e, miplevels,
-	              arrayLayers, samples, tiling, usage, sharingMode, queueFamilyIndexCount,
-	              pQueueFamilyIndices, properties, image, imageMemory);
-}
-
-void createVkImage(VkPhysicalDevice physicalDevice,
-                   VkDevice device,
-                   VkImageType imageType,
-                   VkFormat format,
-                   VkExtent3D extent,
-                   uint32_t miplevels,
-                   uint32_t arrayLayers,
-                   VkSampleCountFlagBits samples,
-                   VkImageTiling tiling,
-                   VkImageUsageFlags usage,
-                   VkSharingMode sharingMode,
-                   uint32_t queueFamilyIndexCount,
-                   const uint32_t * pQueueFamilyIndices,
-                   VkMemoryPropertyFlags properties,
-                   VkImage * image,
-                   VkDeviceMemory * imageMemory)
-{
-	const void * pNext = nullptr;
-	uint32_t flags = (arrayLayers == 6) ? VK_IMAGE_CREATE_CUBE_COMPATIBLE_BIT : 0;
-	VkImageLayout initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-
-	createVkImage(physicalDevice, device, pNext, flags, imageType, format, extent, miplevels,
-	              arrayLayers, samples, tiling, usage, sharingMode, queueFamilyIndexCount,
-	              pQueueFamilyIndices, initialLayout, properties, image, imageMemory);
-}
-
-void createVkImage(VkPhysicalDevice physicalDevice,
-                   VkDevice device,
-                   const void * pNext,
-                   VkImageCreateFlags flags,
-                   VkImageType imageType,
-                   VkFormat format,
-                   VkExtent3D extent,
-                   uint32_t miplevels,
-                   uint32_t arrayLayers,
-                   VkSampleCountFlagBits samples,
-                   VkImageTiling tiling,
-                   VkImageUsageFlags usage,
-                   VkSharingMode sharingMode,
-                   uint32_t queueFamilyIndexCount,
-                   const uint32_t * pQueueFamilyIndices,
-                   VkImageLayout initialLayout,
-                   VkMemoryPropertyFlags properties,
-                   VkImage * image,
-                   VkDeviceMemory * imageMemory)
+                   DeviceAllocation * imageAllocation)
 {
 	VkImageCreateInfo createInfo = {};
 	createInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
-	createInfo.pNext = pNext;
-	createInfo.flags = flags;
+	createInfo.pNext = nullptr;
+	createInfo.flags = (arrayLayers == 6) ? VK_IMAGE_CREATE_CUBE_COMPATIBLE_BIT : 0;
 	createInfo.imageType = imageType;
 	createInfo.format = format;
 	createInfo.extent = extent;
@@ -144,12 +59,12 @@ void createVkImage(VkPhysicalDevice physicalDevice,
 	createInfo.samples = samples;
 	createInfo.tiling = tiling;
 	createInfo.usage = usage;
-	createInfo.sharingMode = sharingMode;
-	createInfo.queueFamilyIndexCount = queueFamilyIndexCount;
-	createInfo.pQueueFamilyIndices = pQueueFamilyIndices;
-	createInfo.initialLayout = initialLayout;
+	createInfo.sharingMode = (context->queueIndices.size() > 1) ? VK_SHARING_MODE_CONCURRENT : VK_SHARING_MODE_EXCLUSIVE;
+	createInfo.queueFamilyIndexCount = context->queueIndices.size();
+	createInfo.pQueueFamilyIndices = context->queueIndices.data();
+	createInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
 
-	int result = vkCreateImage(device, &createInfo, nullptr, image);
+	int result = vkCreateImage(context->device, &createInfo, nullptr, image);
 	if (result != VK_SUCCESS)
 	{
 		PANIC("RENDER_FRAMEWORK - Failed to create VkImage %d", result);
@@ -157,40 +72,25 @@ void createVkImage(VkPhysicalDevice physicalDevice,
 	}
 
 	VkMemoryRequirements memReqs;
-	vkGetImageMemoryRequirements(device, *image, &memReqs);
-
-	VkPhysicalDeviceMemoryProperties memProps;
-	vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memProps);
-
-	uint32_t typeIndex = -1;
-	for (uint32_t i = 0; i < memProps.memoryTypeCount; i++)
-	{
-		if (memReqs.memoryTypeBits & (1 << i) && (memProps.memoryTypes[i].propertyFlags & properties) == properties)
-		{
-			typeIndex = i;
-		}
-	}
+	vkGetImageMemoryRequirements(context->device, *image, &memReqs);
 
-	if (typeIndex == -1)
-	{
-		PANIC("RENDER_FRAMEWORK - Failed to allocate VkImage memory");
-		vkDestroyImage(device, *image, nullptr);
-		return;
-	}
-
-	VkMemoryAllocateInfo allocInfo = {};
-	allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-	allocInfo.pNext = nullptr;
-	allocInfo.allocationSize = memReqs.size;
-	allocInfo.memoryTypeIndex = typeIndex;
+	DeviceResourceKind kind = (tiling == VK_IMAGE_TILING_OPTIMAL) ? DeviceResourceOptimal : DeviceResourceLinear;
 
-	result = vkAllocateMemory(device, &allocInfo, nullptr, imageMemory);
+	result = context->allocator.allocate(memReqs, properties, kind, false, imageAllocation);
 	if (result != VK_SUCCESS)
 	{
 		PANIC("RENDER_FRAMEWORK - Failed to allocate image memory! %d", result);
+		vkDestroyImage(context->device, *image, nullptr);
+		return;
 	}
 
-	vkBindImageMemory(device, *image, *imageMemory, 0);
+	vkBindImageMemory(context->device, *image, imageAllocation->memory, imageAllocation->offset);
+}
+
+void destroyVkImage(Context * context, VkImage image, DeviceAllocation & imageAllocation)
+{
+	vkDestroyImage(context->device, image, nullptr);
+	context->allocator.free(imageAllocation);
 }
 
 void createVkImageView(Context * context,
@@ -479,7 +379,7 @@ void transitionImageLayout(VkDevice device, VkQueue queue, VkCommandPool command
 }
 
 void createBuffer(Context * context, VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties,
-                  VkBuffer * buffer, VkDeviceMemory * bufferMemory)
+                  VkBuffer * buffer, DeviceAllocation * bufferAllocation, bool transient)
 {
 	VkBufferCreateInfo bufferInfo = {};
 	bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
@@ -496,140 +396,22 @@ void createBuffer(Context * context, VkDeviceSize size, VkBufferUsageFlags usage
 	VkMemoryRequirements memReqs;
 	vkGetBufferMemoryRequirements(context->device, *buffer, &memReqs);
 
-	VkPhysicalDeviceMemoryProperties memProps;
-	vkGetPhysicalDeviceMemoryProperties(context->physicalDevice, &memProps);
-
-	uint32_t typeIndex = -1;
-	for (uint32_t i = 0; i < memProps.memoryTypeCount; i++)
-	{
-		if (memReqs.memoryTypeBits & (1 << i) && (memProps.memoryTypes[i].propertyFlags & properties) == properties)
-		{
-			typeIndex = i;
-		}
-	}
-
-	VkMemoryAllocateInfo allocInfo = {};
-	allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-	allocInfo.allocationSize = memReqs.size;
-	allocInfo.memoryTypeIndex = typeIndex;
-
-	result = vkAllocateMemory(context->device, &allocInfo, nullptr, bufferMemory);
+	result = context->allocator.allocate(memReqs, properties, DeviceResourceLinear, transient, bufferAllocation);
 	VALIDATE(result == VK_SUCCESS, "Failed to allocate memory for buffer! %d", result)
 
-	vkBindBufferMemory(context->device, *buffer, *bufferMemory, 0);
-}
-
-void copyBuffer(Context * context, VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size)
-{
-	VkCommandBuffer commandBuffer = beginSingleTimeCommands(context->device, context->primaryTransferQueue->commandPool);
-
-	VkBufferCopy copyRegion = {};
-	copyRegion.srcOffset = 0;
-	copyRegion.dstOffset = 0;
-	copyRegion.size = size;
-	vkCmdCopyBuffer(commandBuffer, srcBuffer, dstBuffer, 1, &copyRegion);
-
-	endSingleTimeCommands(context->device, context->primaryTransferQueue->queue, context->primaryTransferQueue->commandPool, commandBuffer);
-}
-
-void copyBufferToImage(Context * context, VkBuffer buffer, VkImage image, uint32_t width, uint32_t height, uint32_t layerCount)
-{
-	VkCommandBuffer commandBuffer = beginSingleTimeCommands(context->device, context->primaryTransferQueue->commandPool);
-
-	VkBufferImageCopy region = {};
-	region.bufferOffset = 0;
-	region.bufferRowLength = 0;
-	region.bufferImageHeight = 0;
-
-	region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-	region.imageSubresource.mipLevel = 0;
-	region.imageSubresource.baseArrayLayer = 0;
-	region.imageSubresource.layerCount = layerCount;
-
-	region.imageOffset = {0, 0, 0};
-	region.imageExtent = {width, height, 1};
-
-	vkCmdCopyBufferToImage(commandBuffer, buffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
-
-	endSingleTimeCommands(context->device, context->primaryTransferQueue->queue, context->primaryTransferQueue->commandPool, commandBuffer);
-}
-
-void createVertexBuffer(Context * context, std::vector<Vertex>& vertices, VkBuffer * vertexBuffer,
-                        VkDeviceMemory * vertexMemory, VkDeviceSize * vertexBufferSize)
-{
-	*vertexBufferSize = sizeof(Vertex) * vertices.size();
-
-	VkBuffer stagingBuffer;
-	VkDeviceMemory stagingBufferMemory;
-	VkBufferUsageFlags usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
-	VkMemoryPropertyFlags properties = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
-	createBuffer(context, *vertexBufferSize, usage, properties, &stagingBuffer, &stagingBufferMemory);
-
-	void * data;
-	vkMapMemory(context->device, stagingBufferMemory, 0, *vertexBufferSize, 0, &data);
-	memcpy(data, vertices.data(), (size_t) *vertexBufferSize);
-	vkUnmapMemory(context->device, stagingBufferMemory);
-
-	usage = VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
-	properties = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
-	createBuffer(context, *vertexBufferSize, usage, properties, vertexBuffer, vertexMemory);
-
-	copyBuffer(context, stagingBuffer, *vertexBuffer, *vertexBufferSize);
-
-	vkDestroyBuffer(context->device, stagingBuffer, nullptr);
-	vkFreeMemory(context->device, stagingBufferMemory, nullptr);
+	vkBindBufferMemory(context->device, *buffer, bufferAllocation->memory, bufferAllocation->offset);
 }
 
-void createIndexBuffer(Context * context, std::vector<uint32_t>& indices, VkBuffer * indexBuffer,
-                       VkDeviceMemory * indexMemory, VkDeviceSize * indexBufferSize)
+void createStagingBuffer(Context * context, VkDeviceSize size, VkBuffer * buffer, DeviceAllocation * bufferAllocation)
 {
-	*indexBufferSize = sizeof(uint32_t) * indices.size();
-
-	VkBuffer stagingBuffer;
-	VkDeviceMemory stagingBufferMemory;
-	VkBufferUsageFlags usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
-	VkMemoryPropertyFlags properties = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
-	createBuffer(context, *indexBufferSize, usage, properties, &stagingBuffer, &stagingBufferMemory);
-
-	void * data;
-	vkMapMemory(context->device, stagingBufferMemory, 0, *indexBufferSize, 0, &data);
-	memcpy(data, indices.data(), (size_t) *indexBufferSize);
-	vkUnmapMemory(context->device, stagingBufferMemory);
-
-	usage = VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
-	properties = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
-	createBuffer(context, *indexBufferSize, usage, properties, indexBuffer, indexMemory);
-
-	copyBuffer(context, stagingBuffer, *indexBuffer, *indexBufferSize);
-
-	vkDestroyBuffer(context->device, stagingBuffer, nullptr);
-	vkFreeMemory(context->device, stagingBufferMemory, nullptr);
+	createBuffer(context, size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+	             buffer, bufferAllocation, true);
 }
 
-void createInstanceBuffer(Context * context, std::vector<Instance>& instances, VkBuffer * instanceBuffer,
-                          VkDeviceMemory * instanceMemory, VkDeviceSize * instanceBufferSize)
+void destroyBuffer(Context * context, VkBuffer buffer, DeviceAllocation & bufferAllocation)
 {
-	*instanceBufferSize = sizeof(Instance) * instances.size();
-
-	VkBuffer stagingBuffer;
-	VkDeviceMemory stagingBufferMemory;
-	VkBufferUsageFlags usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
-	VkMemoryPropertyFlags properties = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
-	createBuffer(context, *instanceBufferSize, usage, properties, &stagingBuffer, &stagingBufferMemory);
-
-	void * data;
-	vkMapMemory(context->device, stagingBufferMemory, 0, *instanceBufferSize, 0, &data);
-	memcpy(data, instances.data(), (size_t) *instanceBufferSize);
-	vkUnmapMemory(context->device, stagingBufferMemory);
-
-	usage = VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
-	properties = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
-	createBuffer(context, *instanceBufferSize, usage, properties, instanceBuffer, instanceMemory);
-
-	copyBuffer(context, stagingBuffer, *instanceBuffer, *instanceBufferSize);
-
-	vkDestroyBuffer(context->device, stagingBuffer, nullptr);
-	vkFreeMemory(context->device, stagingBufferMemory, nullptr);
+	vkDestroyBuffer(context->device, buffer, nullptr);
+	context->allocator.free(bufferAllocation);
 }
 
 VkRenderPass createVkRenderPass(VkDevice device, VkFormat colorFormat, VkFormat depthFormat, VkSampleCountFlagBits sampleCount)
@@ -792,10 +574,26 @@ void createMeshTextureSampler(VkDevice device, VkSampler * textureSampler)
 	}
 }
 
+VkShaderModule createShaderModule(Context * context, const uint32_t * code, size_t size)
+{
+	VkShaderModule shaderModule;
+
+	VkShaderModuleCreateInfo createInfo = {};
+	createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+	createInfo.codeSize = size;
+	createInfo.pCode = code;
+	int result = vkCreateShaderModule(context->device, &createInfo, nullptr, &shaderModule);
+	VALIDATE(result == VK_SUCCESS, "RENDER_FRAMEWORK - Failed to create shader module %d", result);
+
+	return shaderModule;
+}
+
 #ifndef ANDROID
 
 void loadOBJ(std::string filename, std::string location, Context * context, Renderer * renderer, ModelBase * m, std::vector<std::string> * textures)
 {
+	PROFILE_ZONE("loadOBJ");
+
 	std::string err, warn;
 
 	tinyobj::attrib_t attrib;
@@ -804,11 +602,18 @@ void loadOBJ(std::string filename, std::string location, Context * context, Rend
 
 	tinyobj::LoadObj(&attrib, &shapes, &materials, &warn, &err, (location + filename).c_str(), location.c_str(), true, true);
 
+	m->shapes.reserve(m->shapes.size() + shapes.size());
+	m->materials.reserve(m->materials.size() + materials.size());
+
 	for (auto& shape : shapes)
 	{
 		Shape mesh = {};
 		size_t index_offset = 0;
 		std::unordered_map<Vertex, uint32_t> uniqueVertices;
+
+		// One index per face vertex, and at most that many unique vertices
+		uniqueVertices.reserve(shape.mesh.indices.size());
+		mesh.indices.reserve(shape.mesh.indices.size());
 		for (size_t f = 0; f < shape.mesh.num_face_vertices.size(); f++)
 		{
 			int fv = shape.mesh.num_face_vertices[f];
@@ -852,7 +657,7 @@ void loadOBJ(std::string filename, std::string location, Context * context, Rend
 			mesh.materialID = shape.mesh.material_ids[f];
 			index_offset += fv;
 		}
-		m->shapes.push_back(mesh);
+		m->shapes.push_back(std::move(mesh));
 	}
 
 	for (auto& material : materials)
@@ -860,7 +665,10 @@ void loadOBJ(std::string filename, std::string location, Context * context, Rend
 		Material mat;
 
 		if (textures != nullptr && material.diffuse_texname != "")
+		{
+			mat.textureID = textures->size();
 			textures->push_back(material.diffuse_texname);
+		}
 
 		mat.data.ambient = {material.ambient[0], material.ambient[1], material.ambient[2]};
 		mat.data.diffuse = {material.diffuse[0], material.diffuse[1], material.diffuse[2]};
@@ -872,7 +680,7 @@ void loadOBJ(std::string filename, std::string location, Context * context, Rend
 		m->materials.push_back(mat);
 	}
 
-	std::sort(m->shapes.begin(), m->shapes.end(), [m](Shape shape1, Shape shape2)->bool { return m->materials[shape1.materialID].data.opacity > m->materials[shape2.materialID].data.opacity; });
+	std::sort(m->shapes.begin(), m->shapes.end(), [m](const Shape & shape1, const Shape & shape2)->bool { return m->materials[shape1.materialID].data.opacity > m->materials[shape2.materialID].data.opacity; });
 
 	VALIDATE(err.length() == 0, "%s", err.c_str());
 
@@ -920,16 +728,19 @@ int getFileExtension(const char * filename)
 	return other;
 }
 
-bool loadMeshTexture(std::string name, Context * context, Renderer * renderer, Texture * texture)
+bool decodeMeshTexture(std::string name, TexturePixels * pixels)
 {
-	VALIDATE(texture != nullptr && name != "", "Failed to load texture \"%s\"", name.c_str());
+	PROFILE_ZONE("decodeMeshTexture");
+
+	VALIDATE(pixels != nullptr && name != "", "Failed to load texture \"%s\"", name.c_str());
 
-	unsigned char * pixels = nullptr;
 	dds_info imageInfo;
 	int width, height, channels;
 	VkDeviceSize imageSize;
 	VkFormat format = VK_FORMAT_R8G8B8A8_UNORM;
 
+	unsigned char * data = nullptr;
+
 	if (getFileExtension(name.c_str()) == 0)
 	{
 		static const dds_u32 supfmt[] = { DDS_FMT_R8G8B8A8, DDS_FMT_B8G8R8A8, DDS_FMT_B8G8R8X8, DDS_FMT_DXT1, DDS_FMT_DXT3, DDS_FMT_DXT5, 0 };
@@ -941,83 +752,71 @@ bool loadMeshTexture(std::string name, Context * context, Renderer * renderer, T
 		height = imageInfo.image.height;
 		imageSize = imageInfo.image.size;
 
-		pixels = (unsigned char *) malloc(imageSize);
+		data = (unsigned char *) malloc(imageSize);
 
 		if (imageInfo.image.format == DDS_FMT_DXT5)
 			format = VK_FORMAT_BC3_UNORM_BLOCK;
 		if (imageInfo.image.format == DDS_FMT_B8G8R8A8)
 			format = VK_FORMAT_B8G8R8A8_UNORM;
 
-		dds_read(&imageInfo, pixels);
+		dds_read(&imageInfo, data);
 
 		dds_close(&imageInfo);
 	}
 	else
 	{
-		pixels = stbi_load(name.c_str(), &width, &height, &channels, STBI_rgb_alpha);
+		data = stbi_load(name.c_str(), &width, &height, &channels, STBI_rgb_alpha);
 		imageSize = width * height * 4;
 	}
 
-	VALIDATE(pixels, "RENDER_FRAMEWORK - Failed to load texture %s", name.c_str());
-
-	VkBuffer stagingBuffer;
-	VkDeviceMemory stagingBufferMemory;
-	createBuffer(context, imageSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-	             VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-	             &stagingBuffer, &stagingBufferMemory);
+	VALIDATE(data, "RENDER_FRAMEWORK - Failed to load texture %s", name.c_str());
 
-	void * data;
-	vkMapMemory(context->device, stagingBufferMemory, 0, imageSize, 0, &data);
-	memcpy(((unsigned char *) data), pixels, imageSize);
-	vkUnmapMemory(context->device, stagingBufferMemory);
+	pixels->data = data;
+	pixels->extent = {(uint32_t) width, (uint32_t) height};
+	pixels->size = imageSize;
+	pixels->format = format;
 
-	free(pixels);
+	return true;
+}
 
-	VkExtent2D e = {};
-	e.width = width;
-	e.height = height;
+bool createMeshTexture(Context * context, Texture * texture)
+{
+	PROFILE_ZONE("createMeshTexture");
 
-	createVkImage(context, VK_IMAGE_TYPE_2D, format, e, 1, 1, VK_SAMPLE_COUNT_1_BIT,
-	            VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
-	            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &texture->image, &texture->memory);
+	TexturePixels & pixels = texture->pixels;
 
-	transitionImageLayout(context->device, context->primaryGraphicsQueue->queue, context->primaryGraphicsQueue->commandPool, texture->image, format, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1);
+	VALIDATE(pixels.data != nullptr, "RENDER_FRAMEWORK - Texture created before it was decoded");
 
-	copyBufferToImage(context, stagingBuffer, texture->image, static_cast<uint32_t>(width), static_cast<uint32_t>(height), 1);
+	createVkImage(context, VK_IMAGE_TYPE_2D, pixels.format, pixels.extent, 1, 1, VK_SAMPLE_COUNT_1_BIT,
+	            VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+	            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &texture->image, &texture->allocation);
 
-	transitionImageLayout(context->device, context->primaryGraphicsQueue->queue, context->primaryGraphicsQueue->commandPool, texture->image, format, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, 1);
+	// The pixels are copied to staging memory here, the transfer and both layout transitions
+	// happen in a later frame's upload batch
+	texture->upload = context->uploads.uploadImage(texture->image, {pixels.extent.width, pixels.extent.height, 1}, 1, pixels.data, pixels.size);
 
-	createVkImageView(context, texture->image, format, 1, 1, VK_IMAGE_ASPECT_COLOR_BIT, &texture->imageView);
+	free(pixels.data);
+	pixels.data = nullptr;
 
-	vkDestroyBuffer(context->device, stagingBuffer, nullptr);
-	vkFreeMemory(context->device, stagingBufferMemory, nullptr);
+	createVkImageView(context, texture->image, pixels.format, 1, 1, VK_IMAGE_ASPECT_COLOR_BIT, &texture->imageView);
 
-	texture->format = format;
+	texture->format = pixels.format;
 
 	return true;
 }
 
 VkShaderModule loadShader(Context * context, std::string filename)
 {
-	VkShaderModule shaderModule;
-
 	std::ifstream file(filename, std::ios::binary | std::ios::ate);
 	std::streamsize size = file.tellg();
 	file.seekg(0, std::ios::beg);
 
-	std::vector<char> buffer(size);
-	VALIDATE(file.read(buffer.data(), size), "RENDER_FRAMEWORK - Failed to read shader file %s", filename.c_str());
+	std::vector<uint32_t> buffer((size + 3) / 4);
+	VALIDATE(size > 0 && file.read((char *) buffer.data(), size), "RENDER_FRAMEWORK - Failed to read shader file %s", filename.c_str());
 
-	VkShaderModuleCreateInfo createInfo = {};
-	createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
-	createInfo.codeSize = size;
-	createInfo.pCode = reinterpret_cast<const uint32_t*>(buffer.data());
-	int result = vkCreateShaderModule(context->device, &createInfo, nullptr, &shaderModule); 
-	VALIDATE(result == VK_SUCCESS, "RENDER_FRAMEWORK - Failed to create shader module %d", result);
+	DEBUG("RENDER_FRAMEWORK - VkShaderModule Loaded %s", filename.c_str());
 
-	DEBUG("RENDER_FRAMEWORK - VkShaderModule Created %s", filename.c_str());
-
-	return shaderModule;
+	return createShaderModule(context, buffer.data(), size);
 }
 
 std::string findFile(std::string filename, std::string root)
@@ -1040,7 +839,12 @@ void loadOBJ(std::string filename, std::string location, Context * context, Rend
 	
 }
 
-bool loadMeshTexture(std::string name, Context * context, Renderer * renderer, Texture * texture)
+bool decodeMeshTexture(std::string name, TexturePixels * pixels)
+{
+	return false;
+}
+
+bool createMeshTexture(Context * context, Texture * texture)
 {
 	return false;
 }